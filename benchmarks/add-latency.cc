@@ -0,0 +1,95 @@
+// This benchmark reports the latency distribution of single Add() calls while a filter
+// fills up, for CuckooFilter, whose Add runs kick chains of up to 500 kicks, and for
+// BoundedCuckooFilter, whose Add parks the tag for a background thread when both buckets
+// are full. It is invoked as:
+//
+//     ./add-latency.exe [add count] [adds per second]
+//
+// Each filter is sized for add count keys, and adds are timed one by one until 95% of
+// its slots are used. Adds arrive at the given rate, as on a request path, with the
+// adding thread asleep in between; with a rate of 0 they run back to back, and the
+// background thread of BoundedCuckooFilter cannot keep up once its queue fills. The rows
+// show percentiles in nanoseconds over all adds and over the adds past 90% load, where
+// kick chains get long. The timer itself adds a few tens of nanoseconds to each sample.
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "boundedcuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// Nanoseconds of each Add() of to_add[i], with adds_per_second adds a second or, if 0,
+// as fast as possible
+template <typename Filter>
+vector<uint64_t> AddLatencies(Filter &filter, const vector<uint64_t> &to_add,
+                              double adds_per_second) {
+  vector<uint64_t> result(to_add.size());
+  const auto begin = chrono::steady_clock::now();
+  for (size_t i = 0; i < to_add.size(); i++) {
+    if (adds_per_second > 0) {
+      this_thread::sleep_until(begin + chrono::nanoseconds(static_cast<uint64_t>(
+                                           i * 1e9 / adds_per_second)));
+    }
+    const auto start_time = NowNanos();
+    if (Ok != filter.Add(to_add[i])) {
+      cerr << "Filter is full after " << i << " items" << endl;
+      exit(1);
+    }
+    result[i] = NowNanos() - start_time;
+  }
+  return result;
+}
+
+void Report(const string &name, vector<uint64_t> latencies) {
+  static const double kPercentiles[] = {50, 90, 99, 99.9, 99.99, 100};
+  sort(latencies.begin(), latencies.end());
+  cout << setw(28) << left << name << right;
+  for (const double p : kPercentiles) {
+    const size_t rank = min(latencies.size() - 1, static_cast<size_t>(p / 100 *
+                                                                      latencies.size()));
+    cout << setw(10) << latencies[rank];
+  }
+  cout << endl;
+}
+
+// Reports the latencies of all adds and of those from high_load on
+void ReportAll(const string &name, const vector<uint64_t> &latencies, size_t high_load) {
+  Report(name + " all", latencies);
+  Report(name + " >90% load",
+         vector<uint64_t>(latencies.begin() + high_load, latencies.end()));
+}
+
+int main(int argc, char *argv[]) {
+  const size_t capacity = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 0.95 * (1 << 18);
+  const double adds_per_second = (argc > 2) ? strtod(argv[2], nullptr) : 20 * 1000;
+  // CuckooFilter(capacity) has this many slots, see its constructor:
+  size_t num_slots = SingleTable<12>::kTagsPerBucket *
+                     upperpower2(max<uint64_t>(1, capacity / SingleTable<12>::kTagsPerBucket));
+  if (capacity > 0.96 * num_slots) num_slots *= 2;
+  const vector<uint64_t> to_add = GenerateRandom64(0.95 * num_slots);
+  const size_t high_load = 0.90 * num_slots;
+
+  cout << setw(28) << left << "Add latency (ns)" << right << setw(10) << "p50"
+       << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10)
+       << "p99.99" << setw(10) << "max" << endl;
+  {
+    CuckooFilter<uint64_t, 12> filter(capacity);
+    ReportAll("CuckooFilter", AddLatencies(filter, to_add, adds_per_second), high_load);
+  }
+  {
+    BoundedCuckooFilter<uint64_t, 12> filter(capacity);
+    const auto latencies = AddLatencies(filter, to_add, adds_per_second);
+    filter.Flush();
+    ReportAll("BoundedCuckooFilter", latencies, high_load);
+  }
+}
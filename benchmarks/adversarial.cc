@@ -0,0 +1,147 @@
+// This benchmark compares the default hash family of CuckooFilter<uint64_t, 12> with the
+// keyed SipHash13 family and KeyedAltIndex policy, first in speed and then under an
+// adversarial workload. It is invoked as:
+//
+//     ./adversarial.exe [add count]
+//
+// The speed rows time hashing, Add() and Contain() of add count random keys.
+//
+// In the attack, a client who can compute the filter's hash function searches for keys
+// with the same bucket and tag. Nine such keys fill both candidate buckets of that tag,
+// push the ninth into the victim slot, and from then on every Add() fails. Multiply-shift
+// is seeded at random, but it is linear, so its seed can be recovered from a few observed
+// hash values; the attack models this by letting the client use the filter's own
+// multiply-shift parameters. The keyed filter gets the same crafted keys, since a client
+// without the SipHash key has nothing better to try.
+
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// A hash family whose parameters are known to the attacker: every instance hashes with
+// the one instance returned by Shared()
+template <typename HashFamily>
+class KnownHash {
+ public:
+  static const HashFamily &Shared() {
+    static const HashFamily hash;
+    return hash;
+  }
+
+  uint64_t operator()(const uint64_t key) const { return Shared()(key); }
+};
+
+typedef CuckooFilter<uint64_t, 12> DefaultFilter;
+typedef CuckooFilter<uint64_t, 12, SingleTable, KnownHash<TwoIndependentMultiplyShift>>
+    KnownFilter;
+typedef CuckooFilter<uint64_t, 12, SingleTable, SipHash13, KeyedAltIndex> KeyedFilter;
+
+// Million keys per second of hash(key)
+template <typename Hash>
+double HashBenchmark(const vector<uint64_t> &keys) {
+  const Hash hash;
+  uint64_t sum = 0;
+  auto start_time = NowNanos();
+  for (const auto key : keys) sum += hash(key);
+  auto time = NowNanos() - start_time;
+  // Keep the compiler from optimizing out the hashing:
+  if (sum == 42) cerr << "";
+  return keys.size() * 1000.0 / time;
+}
+
+// Million keys per second of Add() and of Contain() of all keys
+template <typename Filter>
+pair<double, double> FilterBenchmark(const vector<uint64_t> &keys) {
+  Filter filter(keys.size());
+  auto start_time = NowNanos();
+  for (const auto key : keys) {
+    if (Ok != filter.Add(key)) {
+      cerr << "Filter is full after " << filter.Size() << " items" << endl;
+      exit(1);
+    }
+  }
+  auto add_time = NowNanos() - start_time;
+  size_t found = 0;
+  start_time = NowNanos();
+  for (const auto key : keys) found += (Ok == filter.Contain(key));
+  auto find_time = NowNanos() - start_time;
+  if (found != keys.size()) {
+    cerr << "False negatives" << endl;
+    exit(1);
+  }
+  return make_pair(keys.size() * 1000.0 / add_time, keys.size() * 1000.0 / find_time);
+}
+
+// count keys that hash to the same bucket and tag of a filter with num_buckets buckets,
+// found by trying consecutive keys as CuckooFilter::IndexTagFromHash does
+template <typename Hash>
+vector<uint64_t> CraftCollidingKeys(size_t count, size_t num_buckets) {
+  const Hash hash;
+  const auto bucket_and_tag = [&hash, num_buckets](uint64_t key) {
+    const uint64_t h = hash(key);
+    uint64_t tag = h & ((1ULL << 12) - 1);
+    tag += (tag == 0);
+    return (((h >> 32) & (num_buckets - 1)) << 12) | tag;
+  };
+  vector<uint64_t> result(1, 0x9e3779b97f4a7c15ULL);
+  const uint64_t target = bucket_and_tag(result[0]);
+  for (uint64_t key = result[0] + 1; result.size() < count; key++) {
+    if (bucket_and_tag(key) == target) result.push_back(key);
+  }
+  return result;
+}
+
+// Adds half as many random keys as the filter has slots, then the crafted keys, then
+// random keys up to 90% of the slots, and prints how many of each Add() accepted
+template <typename Filter>
+void AttackReport(const string &name, size_t num_slots, const vector<uint64_t> &crafted) {
+  // a filter for 90% of num_slots keys has exactly num_slots slots
+  Filter filter(0.9 * num_slots);
+  const vector<uint64_t> random_keys = GenerateRandom64(0.9 * num_slots);
+  const size_t half = num_slots / 2;
+  for (size_t i = 0; i < half; i++) filter.Add(random_keys[i]);
+  size_t crafted_added = 0;
+  for (const auto key : crafted) crafted_added += (Ok == filter.Add(key));
+  size_t random_added = 0;
+  for (size_t i = half; i < random_keys.size(); i++) {
+    random_added += (Ok == filter.Add(random_keys[i]));
+  }
+  cout << setw(24) << left << name << setw(10) << right << crafted_added << " / "
+       << crafted.size() << setw(14) << random_added << " / " << random_keys.size() - half
+       << endl;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t add_count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 8 * 1000 * 1000;
+  const vector<uint64_t> keys = GenerateRandom64(add_count);
+
+  const auto row = [](const string &name, double hash, pair<double, double> filter) {
+    cout << setw(24) << left << name << fixed << setprecision(2) << setw(10) << right
+         << hash << setw(10) << filter.first << setw(10) << filter.second << endl;
+  };
+  cout << setw(24) << left << "Mkeys/sec" << setw(10) << right << "hash" << setw(10)
+       << "Add" << setw(10) << "Contain" << endl;
+  row("multiply-shift", HashBenchmark<TwoIndependentMultiplyShift>(keys),
+      FilterBenchmark<DefaultFilter>(keys));
+  row("SipHash13 + KeyedAlt", HashBenchmark<SipHash13>(keys),
+      FilterBenchmark<KeyedFilter>(keys));
+  cout << endl;
+
+  // 4096 buckets of 4 slots, small enough to find colliding keys in a second
+  const size_t num_slots = 4096 * SingleTable<12>::kTagsPerBucket;
+  const vector<uint64_t> crafted =
+      CraftCollidingKeys<KnownHash<TwoIndependentMultiplyShift>>(16, 4096);
+  cout << setw(24) << left << "attack" << setw(16) << right << "crafted added" << setw(20)
+       << "random added" << endl;
+  AttackReport<KnownFilter>("multiply-shift, known", num_slots, crafted);
+  AttackReport<KeyedFilter>("SipHash13 + KeyedAlt", num_slots, crafted);
+}
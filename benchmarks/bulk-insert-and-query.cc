@@ -53,7 +53,9 @@
 #include <stdexcept>
 #include <vector>
 
+#include "binaryfusefilter.h"
 #include "cuckoofilter.h"
+#include "prefixfilter.h"
 #include "random.h"
 #include "simd-block.h"
 #include "timing.h"
@@ -122,15 +124,59 @@ basic_ostream<CharT, Traits>& operator<<(
 template<typename Table>
 struct FilterAPI {};
 
-template <typename ItemType, size_t bits_per_item, template <size_t> class TableType>
-struct FilterAPI<CuckooFilter<ItemType, bits_per_item, TableType>> {
-  using Table = CuckooFilter<ItemType, bits_per_item, TableType>;
+template <typename ItemType, size_t bits_per_item, template <size_t> class TableType,
+          typename HashFamily, typename AltIndexPolicy>
+struct FilterAPI<
+    CuckooFilter<ItemType, bits_per_item, TableType, HashFamily, AltIndexPolicy>> {
+  using Table =
+      CuckooFilter<ItemType, bits_per_item, TableType, HashFamily, AltIndexPolicy>;
   static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
   static void Add(uint64_t key, Table * table) {
     if (0 != table->Add(key)) {
       throw logic_error("The filter is too small to hold all of the elements");
     }
   }
+  static void AddAll(const vector<uint64_t>& keys, size_t start, size_t end,
+                     Table* table) {
+    for (size_t i = start; i < end; i++) {
+      Add(keys[i], table);
+    }
+  }
+  static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+template <typename ItemType, typename HashFamily>
+struct FilterAPI<PrefixFilter<ItemType, HashFamily>> {
+  using Table = PrefixFilter<ItemType, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table * table) {
+    if (0 != table->Add(key)) {
+      throw logic_error("The filter is too small to hold all of the elements");
+    }
+  }
+  static void AddAll(const vector<uint64_t>& keys, size_t start, size_t end,
+                     Table* table) {
+    for (size_t i = start; i < end; i++) {
+      Add(keys[i], table);
+    }
+  }
+  static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+struct FilterAPI<BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>> {
+  using Table = BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void AddAll(const vector<uint64_t>& keys, size_t start, size_t end,
+                     Table* table) {
+    if (0 != table->AddAll(keys, start, end)) {
+      throw logic_error("The filter is too small to hold all of the elements");
+    }
+  }
   static bool Contain(uint64_t key, const Table * table) {
     return (0 == table->Contain(key));
   }
@@ -146,6 +192,12 @@ struct FilterAPI<SimdBlockFilter<>> {
   static void Add(uint64_t key, Table* table) {
     table->Add(key);
   }
+  static void AddAll(const vector<uint64_t>& keys, size_t start, size_t end,
+                     Table* table) {
+    for (size_t i = start; i < end; i++) {
+      Add(keys[i], table);
+    }
+  }
   static bool Contain(uint64_t key, const Table * table) {
     return table->Find(key);
   }
@@ -167,9 +219,7 @@ Statistics FilterBenchmark(
 
   // Add values until failure or until we run out of values to add:
   auto start_time = NowNanos();
-  for (size_t added = 0; added < add_count; ++added) {
-    FilterAPI<Table>::Add(to_add[added], &filter);
-  }
+  FilterAPI<Table>::AddAll(to_add, 0, add_count, &filter);
   result.adds_per_nano = add_count / static_cast<double>(NowNanos() - start_time);
   result.bits_per_item = static_cast<double>(CHAR_BIT * filter.SizeInBytes()) / add_count;
 
@@ -218,6 +268,12 @@ int main(int argc, char * argv[]) {
 
   cout << setw(NAME_WIDTH) << "Cuckoo12" << cf << endl;
 
+  cf = FilterBenchmark<
+      CuckooFilter<uint64_t, 12 /* bits per item */, SplitTable /* byte and nibble planes*/>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "Split12" << cf << endl;
+
   cf = FilterBenchmark<
       CuckooFilter<uint64_t, 13 /* bits per item */, PackedTable /* semi-sorted*/>>(
       add_count, to_add, to_lookup);
@@ -248,6 +304,38 @@ int main(int argc, char * argv[]) {
 
   cout << setw(NAME_WIDTH) << "SemiSort17" << cf << endl;
 
+  cf = FilterBenchmark<CuckooFilter<uint64_t, 12 /* bits per item */, SingleTable,
+      TwoIndependentMultiplyShift, VacuumAltIndex<> /* alternates in the same page */>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "Vacuum12" << cf << endl;
+
+  cf = FilterBenchmark<
+      CuckooFilter<uint64_t, 8 /* bits per item */, MortonTable /* compressed blocks*/>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "Morton8" << cf << endl;
+
+  cf = FilterBenchmark<
+      CuckooFilter<uint64_t, 12 /* bits per item */, MortonTable /* compressed blocks*/>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "Morton12" << cf << endl;
+
+  cf = FilterBenchmark<PrefixFilter<uint64_t>>(add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "Prefix8" << cf << endl;
+
+  cf = FilterBenchmark<BinaryFuseFilter<uint64_t, 8 /* bits per fingerprint */>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "BinaryFuse8" << cf << endl;
+
+  cf = FilterBenchmark<BinaryFuseFilter<uint64_t, 16 /* bits per fingerprint */>>(
+      add_count, to_add, to_lookup);
+
+  cout << setw(NAME_WIDTH) << "BinaryFuse16" << cf << endl;
+
   cf = FilterBenchmark<SimdBlockFilter<>>(add_count, to_add, to_lookup);
 
   cout << setw(NAME_WIDTH) << "SimdBlock8" << cf << endl;
@@ -0,0 +1,116 @@
+// This benchmark checkpoints a filter that keeps changing, with a Checkpointer, which
+// writes a whole copy of the table once and then only the 4 KB regions that changed. It
+// is invoked as:
+//
+//     ./checkpoint.exe [key count] [file]
+//
+// The file, checkpoint.bin in the working directory by default, is removed at the end.
+// Each row replaces a number of keys (a Delete and an Add each) between checkpoints and
+// reports the regions that changed, the bytes a checkpoint wrote compared with the
+// whole table, and how long it held the writers' mutex. The background row checkpoints
+// from the Checkpointer's thread while this thread replaces keys as fast as it can.
+// Finally the file is restored into a new filter, which must answer like the old one.
+
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "checkpointer.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+typedef CuckooFilter<uint64_t, 12> Filter;
+
+// Replaces keys, a Delete and an Add each: the filter holds the live keys of keys from
+// step on, round robin.
+struct Churn {
+  const vector<uint64_t> &keys;
+  size_t live;
+  size_t step;
+
+  void Run(Filter &filter, mutex &writers, const size_t count) {
+    for (size_t i = 0; i < count; i++, step++) {
+      lock_guard<mutex> lock(writers);
+      filter.Delete(keys[step % keys.size()]);
+      filter.Add(keys[(step + live) % keys.size()]);
+    }
+  }
+};
+
+int main(int argc, char *argv[]) {
+  const size_t num_keys = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 16 * 1000 * 1000;
+  const string path = (argc > 2) ? argv[2] : "checkpoint.bin";
+  const vector<uint64_t> keys = GenerateRandom64(2 * num_keys);
+  const size_t live = num_keys * 9 / 10;
+
+  Filter filter(num_keys);
+  for (size_t i = 0; i < live; i++) filter.Add(keys[i]);
+  mutex writers;
+  Churn churn{keys, live, 0};
+
+  Checkpointer<Filter> checkpointer(filter, path, writers);
+  auto start_time = NowNanos();
+  checkpointer.Checkpoint();
+  const size_t table_bytes = checkpointer.BaseBytes();
+  const size_t num_regions = table_bytes / kDirtyRegionBytes;
+  cout << "full checkpoint: " << table_bytes << " bytes, " << num_regions
+       << " regions, " << fixed << setprecision(1) << (NowNanos() - start_time) / 1e6
+       << " ms" << endl;
+
+  cout << setw(14) << "replaced keys" << setw(16) << "dirty regions" << setw(18)
+       << "bytes written" << setw(14) << "of table" << setw(12) << "pause ms"
+       << setw(12) << "write ms" << endl;
+  for (const size_t replaced : {num_regions / 1000, num_regions / 100, num_regions / 10,
+                                num_regions}) {
+    churn.Run(filter, writers, replaced);
+    const size_t written = checkpointer.BytesWritten();
+    start_time = NowNanos();
+    checkpointer.Checkpoint();
+    const double ms = (NowNanos() - start_time) / 1e6;
+    const size_t bytes = checkpointer.BytesWritten() - written;
+    const size_t dirty = checkpointer.LastRegions();
+    cout << setw(14) << replaced << setw(15) << setprecision(2) << 100.0 * dirty / num_regions
+         << "%" << setw(18) << bytes << setw(13) << setprecision(2)
+         << 100.0 * bytes / table_bytes << "%" << setw(12) << setprecision(3)
+         << checkpointer.LastPauseNanos() / 1e6 << setw(12) << setprecision(1) << ms
+         << endl;
+  }
+  cout << "compactions so far: " << checkpointer.NumCompactions() << endl;
+
+  // as fast as possible, without and with checkpoints every 100 ms
+  const size_t replaced = 2 * 1000 * 1000;
+  start_time = NowNanos();
+  churn.Run(filter, writers, replaced);
+  const double alone = (NowNanos() - start_time) / 1e9;
+  const size_t checkpoints = checkpointer.NumCheckpoints();
+  checkpointer.Start(chrono::milliseconds(100));
+  start_time = NowNanos();
+  churn.Run(filter, writers, replaced);
+  const double together = (NowNanos() - start_time) / 1e9;
+  checkpointer.Stop();
+  cout << "background: " << setprecision(2) << replaced / alone / 1e6
+       << " M replaced keys/s alone, " << replaced / together / 1e6 << " M/s with "
+       << checkpointer.NumCheckpoints() - checkpoints << " checkpoints, longest pause "
+       << setprecision(3) << checkpointer.MaxPauseNanos() / 1e6 << " ms" << endl;
+
+  checkpointer.Checkpoint();
+  Filter restored(num_keys);
+  start_time = NowNanos();
+  Checkpointer<Filter>::Restore(path, &restored);
+  const double restore_ms = (NowNanos() - start_time) / 1e6;
+  size_t differ = 0;
+  for (const uint64_t key : keys) {
+    differ += (filter.Contain(key) == Ok) != (restored.Contain(key) == Ok);
+  }
+  cout << "restore: " << setprecision(1) << restore_ms << " ms, " << restored.Size()
+       << " of " << filter.Size() << " keys, " << differ << " answers differ" << endl;
+  unlink(path.c_str());
+}
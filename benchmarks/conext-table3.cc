@@ -9,6 +9,9 @@
 // bits per item                           12.60     12.59
 // false positive rate                     0.18%     0.09%
 // constr. speed (million keys/sec)         5.86      4.10
+//
+// The "offline" column builds a CF of the same size from a known key set at
+// once (see CuckooFilter(keys, start, end)), filling it to kMaxOfflineLoad.
 
 #include <climits>
 #include <iomanip>
@@ -60,6 +63,31 @@ Metrics CuckooBenchmark(size_t add_count, const vector<uint64_t>& input) {
   return result;
 }
 
+// Build a filter from input[0, add_count) at once, instead of inserting until
+// failure
+template<typename Table>
+Metrics OfflineBenchmark(size_t add_count, const vector<uint64_t>& input) {
+  auto start_time = NowNanos();
+  Table cuckoo(input, 0, add_count);
+  auto constr_time = NowNanos() - start_time;
+
+  // Count false positives:
+  size_t false_positive_count = 0;
+  size_t absent = 0;
+  for (; add_count + absent < input.size() && absent < FPR_SAMPLE_SIZE; ++absent) {
+    false_positive_count += (0 == cuckoo.Contain(input[add_count + absent]));
+  }
+
+  // Calculate metrics:
+  const auto time = constr_time / static_cast<double>(1000 * 1000 * 1000);
+  Metrics result;
+  result.add_count = static_cast<double>(add_count) / (1000 * 1000);
+  result.space = static_cast<double>(CHAR_BIT * cuckoo.SizeInBytes()) / add_count;
+  result.fpr = (100.0 * false_positive_count) / absent;
+  result.speed = (add_count / time) / (1000 * 1000);
+  return result;
+}
+
 int main() {
   // Number of distinct values, used only for the constructor of CuckooFilter, which does
   // not allow the caller to specify the space usage directly. The actual number of
@@ -77,15 +105,22 @@ int main() {
   const auto sscf = CuckooBenchmark<
       CuckooFilter<uint64_t, 13 /* bits per item */, PackedTable /* semi-sorted*/>>(
       add_count, input);
+  // As many keys as fit in the table of cf at kMaxOfflineLoad:
+  const size_t offline_count = kMaxOfflineLoad * SingleTable<12>::kTagsPerBucket *
+                               upperpower2(add_count / SingleTable<12>::kTagsPerBucket);
+  const auto offline = OfflineBenchmark<
+      CuckooFilter<uint64_t, 12 /* bits per item */, SingleTable /* not semi-sorted*/>>(
+      offline_count, input);
 
   cout << setw(35) << left << "metrics " << setw(10) << right << "CF" << setw(10)
-       << "ss-CF" << endl
+       << "ss-CF" << setw(10) << "offline" << endl
        << fixed << setprecision(2) << setw(35) << left << "# of items (million) "
-       << setw(10) << right << cf.add_count << setw(10) << sscf.add_count << endl
+       << setw(10) << right << cf.add_count << setw(10) << sscf.add_count
+       << setw(10) << offline.add_count << endl
        << setw(35) << left << "bits per item " << setw(10) << right << cf.space
-       << setw(10) << sscf.space << endl
+       << setw(10) << sscf.space << setw(10) << offline.space << endl
        << setw(35) << left << "false positive rate " << setw(9) << right << cf.fpr << "%"
-       << setw(9) << sscf.fpr << "%" << endl
+       << setw(9) << sscf.fpr << "%" << setw(9) << offline.fpr << "%" << endl
        << setw(35) << left << "constr. speed (million keys/sec) " << setw(10) << right
-       << cf.speed << setw(10) << sscf.speed << endl;
+       << cf.speed << setw(10) << sscf.speed << setw(10) << offline.speed << endl;
 }
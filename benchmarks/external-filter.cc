@@ -0,0 +1,96 @@
+// This benchmark builds an ExternalCuckooFilter in a file and looks keys up in it. It is
+// invoked as:
+//
+//     ./external-filter.exe [key count] [file] [buffered keys]
+//
+// The file, external-filter.bin in the working directory by default, must not exist, and
+// is removed at the end; put it on the SSD to measure. The insert row adds all keys,
+// flushing the buffer of added keys each time it fills, and Syncs at the end. The lookup
+// rows look up as many present keys as absent ones, with ContainBatch, which keeps
+// pages in flight through an io_uring, and with Contain, which reads one page at a time.
+
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "externalcuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+typedef ExternalCuckooFilter<uint64_t, 12> Filter;
+
+void Row(const string &name, size_t count, double seconds, const string &extra) {
+  cout << setw(24) << left << name << right << fixed << setprecision(3) << setw(16)
+       << count / seconds / 1e6 << "   " << extra << endl;
+}
+
+// Looks up keys[0, n) with ContainBatch, or Contain one at a time, and prints a row.
+void Lookups(const string &name, const Filter &filter, const vector<uint64_t> &keys,
+             const size_t n, const size_t num_present, const bool batch) {
+  vector<Status> results(n);
+  const auto start_time = NowNanos();
+  if (batch) {
+    filter.ContainBatch(keys.data(), n, results.data());
+  } else {
+    for (size_t i = 0; i < n; i++) results[i] = filter.Contain(keys[i]);
+  }
+  const double seconds = (NowNanos() - start_time) / 1e9;
+  size_t false_negatives = 0, false_positives = 0;
+  for (size_t i = 0; i < n; i++) {
+    // even keys are present, odd ones absent
+    if (i % 2 == 0) {
+      false_negatives += (results[i] != Ok) && (i / 2 < num_present);
+    } else {
+      false_positives += (results[i] == Ok);
+    }
+  }
+  Row(name, n, seconds,
+      to_string(false_negatives) + " false negatives, fpr " +
+          to_string(100.0 * false_positives / (n / 2)) + "%");
+}
+
+int main(int argc, char *argv[]) {
+  const size_t num_keys = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 20 * 1000 * 1000;
+  const string path = (argc > 2) ? argv[2] : "external-filter.bin";
+  const size_t buffer_items = (argc > 3) ? strtoull(argv[3], nullptr, 10) : num_keys / 8;
+
+  const vector<uint64_t> keys = GenerateRandom64(num_keys);
+  const vector<uint64_t> absent = GenerateRandom64(num_keys);
+  // present and absent keys in turn
+  vector<uint64_t> lookups(2 * num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    lookups[2 * i] = keys[i];
+    lookups[2 * i + 1] = absent[i];
+  }
+
+  auto filter = Filter::Create(path, num_keys, buffer_items);
+  cout << filter->Info();
+  cout << setw(24) << left << "operation" << right << setw(16) << "M per second" << endl;
+  const auto start_time = NowNanos();
+  size_t added = 0;
+  for (; added < num_keys; added++) {
+    if (filter->Add(keys[added]) != Ok) break;
+  }
+  filter->Sync();
+  Row("insert", added, (NowNanos() - start_time) / 1e9,
+      to_string(added) + " keys, " + to_string(filter->Spilled()) +
+          " spilled, buffer of " + to_string(buffer_items));
+
+  // each lookup reads a page, so only a part of the keys are looked up
+  Lookups("ContainBatch", *filter, lookups, min<size_t>(lookups.size(), 2000 * 1000),
+          added, true);
+  Lookups("Contain", *filter, lookups, min<size_t>(lookups.size(), 200 * 1000), added,
+          false);
+
+  cout << filter->SizeInBytes() << "-byte file, " << 8.0 * filter->SizeInBytes() / added
+       << " bits per key" << endl;
+  filter.reset();
+  unlink(path.c_str());
+}
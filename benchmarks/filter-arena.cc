@@ -0,0 +1,139 @@
+// This benchmark builds many small filters, as a service holding one filter per customer
+// would, each on the heap and each in a FilterArena with hash functions shared by all
+// filters of the arena. It is invoked as:
+//
+//     ./filter-arena.exe [filter count] [capacity]
+//
+// Each row runs in a process of its own, so that memory freed by one does not make the
+// next look smaller. The construct column times creating one filter, the RSS column is
+// the growth of the resident set per filter once all are built and filled to capacity,
+// with the table bytes of each filter for comparison, and the scan column times one
+// Contain() of a missing key in each filter, in the order they were built.
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// resident set size of this process in bytes
+size_t ResidentBytes() {
+  size_t pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != nullptr) {
+    if (fscanf(f, "%zu %zu", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+void Row(const string &name, size_t count, double construct_ns, size_t rss,
+         size_t table_bytes, double scan_ns) {
+  cout << setw(30) << left << name << right << fixed << setprecision(1) << setw(14)
+       << construct_ns << setw(14) << 1.0 * rss / count << setw(14) << table_bytes
+       << setw(12) << scan_ns << endl;
+}
+
+// Fills and scans filters[0, count), made by make(f) for each f, and prints a row.
+template <typename Filter, typename Make>
+void Measure(const string &name, size_t count, size_t capacity,
+             const vector<uint64_t> &keys, Make make) {
+  vector<Filter *> filters(count);
+  const size_t rss_before = ResidentBytes();
+  const auto start_time = NowNanos();
+  for (size_t f = 0; f < count; f++) filters[f] = make(f);
+  const double construct_ns = 1.0 * (NowNanos() - start_time) / count;
+  for (size_t f = 0; f < count; f++) {
+    for (size_t k = 0; k < capacity; k++) {
+      filters[f]->Add(keys[(f * capacity + k) % keys.size()]);
+    }
+  }
+  const size_t rss = ResidentBytes() - rss_before;
+  size_t found = 0;
+  const auto scan_time = NowNanos();
+  for (size_t f = 0; f < count; f++) found += (Ok == filters[f]->Contain(f));
+  const double scan_ns = 1.0 * (NowNanos() - scan_time) / count;
+  Row(name, count, construct_ns, rss, filters[0]->SizeInBytes(), scan_ns);
+  // keeps the scan from being optimized away
+  if (found == count) cout << endl;
+}
+
+template <typename Filter>
+void Heap(const string &name, size_t count, size_t capacity, const vector<uint64_t> &keys) {
+  vector<unique_ptr<Filter>> owned(count);
+  Measure<Filter>(name, count, capacity, keys, [&](size_t f) {
+    owned[f].reset(new Filter(capacity));
+    return owned[f].get();
+  });
+}
+
+template <typename Filter, typename HashFamily>
+void Arena(const string &name, size_t count, size_t capacity, const vector<uint64_t> &keys) {
+  FilterArena arena;
+  const SharedHash<HashFamily> hasher(arena);
+  Measure<Filter>(name, count, capacity, keys,
+                  [&](size_t) { return arena.New<Filter>(capacity, arena, hasher); });
+  cout << setw(30) << left << "" << "arena: " << arena.BytesUsed() << " bytes used, "
+       << arena.BytesMapped() << " mapped, "
+       << (arena.HugePages() ? "huge pages" : "transparent huge pages if enabled") << endl;
+}
+
+// runs row() in a child process
+template <typename Function>
+void Isolated(Function row) {
+  cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    row();
+    cout.flush();
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 100 * 1000;
+  const size_t capacity = (argc > 2) ? strtoull(argv[2], nullptr, 10) : 100;
+  const vector<uint64_t> keys = GenerateRandom64(1 << 22);
+
+  typedef TwoIndependentMultiplyShift Multiply;
+  typedef SharedHash<Multiply> SharedMultiply;
+  typedef SharedHash<SimpleTabulation> SharedTabulation;
+
+  cout << count << " filters of capacity " << capacity << endl;
+  cout << setw(30) << left << "filter" << right << setw(14) << "construct ns" << setw(14)
+       << "RSS bytes" << setw(14) << "table bytes" << setw(12) << "scan ns" << endl;
+  Isolated([&] { Heap<CuckooFilter<uint64_t, 12>>("Single12 heap", count, capacity, keys); });
+  Isolated([&] {
+    Arena<CuckooFilter<uint64_t, 12, SingleTable, SharedMultiply>, Multiply>(
+        "Single12 arena", count, capacity, keys);
+  });
+  // seeding 16 KB of tables from std::random_device takes milliseconds, so this row
+  // builds fewer filters
+  Isolated([&] {
+    Heap<CuckooFilter<uint64_t, 12, SingleTable, SimpleTabulation>>(
+        "Single12 tabulation heap 1%", count / 100, capacity, keys);
+  });
+  Isolated([&] {
+    Arena<CuckooFilter<uint64_t, 12, SingleTable, SharedTabulation>, SimpleTabulation>(
+        "Single12 tabulation arena", count, capacity, keys);
+  });
+  Isolated([&] {
+    Heap<CuckooFilter<uint64_t, 13, PackedTable>>("Packed13 heap", count, capacity, keys);
+  });
+  Isolated([&] {
+    Arena<CuckooFilter<uint64_t, 13, PackedTable, SharedMultiply>, Multiply>(
+        "Packed13 arena", count, capacity, keys);
+  });
+}
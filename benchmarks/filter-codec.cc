@@ -0,0 +1,71 @@
+// This benchmark encodes filters with FilterCodec, as for shipping them to other hosts,
+// and decodes them again, at a range of load factors. It is invoked as:
+//
+//     ./filter-codec.exe [bucket count]
+//
+// Each filter has 2^22 buckets by default, rounded up to a power of two, of 4 slots.
+// The ratio column is the size of the table over the size of its encoding, and bits per
+// key the size of the encoding over the keys in the filter. The encode and decode
+// columns are GB of table per second, decode including allocating the new table. The
+// decoded filter must answer like the original one.
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "filtercodec.h"
+#include "packedtable.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// Encodes and decodes a filter of num_buckets buckets at each load factor, and prints a
+// row for each.
+template <typename Filter>
+void Rows(const string &name, const size_t num_buckets) {
+  const size_t num_slots = 4 * num_buckets;
+  const vector<uint64_t> keys = GenerateRandom64(num_slots);
+  const vector<uint64_t> absent = GenerateRandom64(1000 * 1000);
+  for (const double load : {0.1, 0.25, 0.5, 0.75, 0.9, 0.95}) {
+    // sized for 95% of num_slots, which needs num_buckets buckets
+    Filter filter(num_slots / 100 * 95);
+    size_t added = 0;
+    while (added < load * num_slots && filter.Add(keys[added]) == Ok) added++;
+
+    auto start_time = NowNanos();
+    const vector<char> encoded = FilterCodec<Filter>::Encode(filter);
+    const double encode_seconds = (NowNanos() - start_time) / 1e9;
+    Filter decoded(1);
+    start_time = NowNanos();
+    FilterCodec<Filter>::Decode(encoded, &decoded);
+    const double decode_seconds = (NowNanos() - start_time) / 1e9;
+
+    size_t differ = 0;
+    for (size_t i = 0; i < added; i++) differ += decoded.Contain(keys[i]) != Ok;
+    for (const uint64_t key : absent) {
+      differ += (filter.Contain(key) == Ok) != (decoded.Contain(key) == Ok);
+    }
+    const size_t table_bytes = filter.SizeInBytes();
+    cout << setw(20) << left << name << right << fixed << setprecision(2) << setw(8)
+         << 100.0 * added / num_slots << "%" << setw(12) << table_bytes << setw(12)
+         << encoded.size() << setw(8) << 1.0 * table_bytes / encoded.size() << setw(14)
+         << 8.0 * encoded.size() / added << setw(10) << table_bytes / encode_seconds / 1e9
+         << setw(10) << table_bytes / decode_seconds / 1e9 << setw(8) << differ << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const size_t num_buckets =
+      upperpower2((argc > 1) ? strtoull(argv[1], nullptr, 10) : 1 << 22);
+  cout << setw(20) << left << "table" << right << setw(9) << "load" << setw(12)
+       << "bytes" << setw(12) << "encoded" << setw(8) << "ratio" << setw(14)
+       << "bits per key" << setw(10) << "encode" << setw(10) << "decode" << setw(8)
+       << "differ" << endl;
+  Rows<CuckooFilter<uint64_t, 12>>("SingleTable<12>", num_buckets);
+  Rows<CuckooFilter<uint64_t, 13, PackedTable>>("PackedTable<13>", num_buckets);
+}
@@ -0,0 +1,134 @@
+// This benchmark compares three ways to run lookups on a filter much larger than the
+// caches: one Contain() after another, ContainBatch(), which prefetches the buckets of a
+// block of keys before probing them, and one coroutine per lookup, which co_awaits
+// ContainAsync() and is interleaved with others by a RoundRobinScheduler of a given
+// width. It needs C++20 and is invoked as:
+//
+//     ./interleaved-lookup.exe [add count]
+//
+// Half of the keys looked up were added to the filter. In the independent rows, each
+// lookup is a request of its own, and the processor overlaps the cache misses of
+// consecutive Contain() calls by itself. In the dependent rows, a request makes
+// kChainLength lookups, each of a key that depends on the result of the one before, as
+// request logic often does; then only interleaving requests overlaps their misses.
+
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+#ifndef CUCKOO_FILTER_COROUTINES
+#error "interleaved-lookup needs C++20 coroutines"
+#endif
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+typedef CuckooFilter<uint64_t, 12> Filter;
+
+// lookups per request in the dependent rows
+const size_t kChainLength = 4;
+
+// one request of a service, which looks up key
+LookupTask Lookup(const Filter &filter, uint64_t key, Status *result) {
+  *result = co_await filter.ContainAsync(key);
+}
+
+// the key of the next lookup of a request, after one of key with result
+inline uint64_t NextKey(uint64_t key, Status result) {
+  return key * 0x9e3779b97f4a7c15ULL + result;
+}
+
+// Status of the last of kChainLength dependent lookups starting at key
+Status ChainedContain(const Filter &filter, uint64_t key) {
+  Status result = filter.Contain(key);
+  for (size_t i = 1; i < kChainLength; i++) {
+    key = NextKey(key, result);
+    result = filter.Contain(key);
+  }
+  return result;
+}
+
+LookupTask ChainedLookup(const Filter &filter, uint64_t key, Status *result) {
+  Status status = co_await filter.ContainAsync(key);
+  for (size_t i = 1; i < kChainLength; i++) {
+    key = NextKey(key, status);
+    status = co_await filter.ContainAsync(key);
+  }
+  *result = status;
+}
+
+// Million lookups per second of lookups_per_key per key, and the number of keys found
+template <typename Run>
+pair<double, size_t> LookupBenchmark(const vector<uint64_t> &keys, size_t lookups_per_key,
+                                     Run run) {
+  vector<Status> results(keys.size());
+  const auto start_time = NowNanos();
+  run(results.data());
+  const auto time = NowNanos() - start_time;
+  size_t found = 0;
+  for (const auto result : results) found += (Ok == result);
+  return make_pair(keys.size() * lookups_per_key * 1000.0 / time, found);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t add_count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 30 * 1000 * 1000;
+  const vector<uint64_t> to_add = GenerateRandom64(add_count);
+  const vector<uint64_t> absent = GenerateRandom64(4 * 1000 * 1000);
+  const vector<uint64_t> keys =
+      MixIn(absent.data(), absent.data() + absent.size(), to_add.data(),
+            to_add.data() + to_add.size(), 0.5);
+
+  Filter filter(add_count);
+  if (Ok != filter.AddAll(to_add, 0, to_add.size(), 1)) {
+    cerr << "Filter is full after " << filter.Size() << " items" << endl;
+    exit(1);
+  }
+  cout << "filter of " << (filter.SizeInBytes() >> 20) << " MB, " << keys.size()
+       << " lookups" << endl;
+
+  const auto row = [](const string &name, pair<double, size_t> result) {
+    cout << setw(24) << left << name << fixed << setprecision(2) << setw(12) << right
+         << result.first << setw(12) << result.second << endl;
+  };
+  cout << setw(24) << left << "lookup" << setw(12) << right << "Mlookups/s" << setw(12)
+       << "found" << endl;
+  row("Contain", LookupBenchmark(keys, 1, [&](Status *results) {
+        for (size_t i = 0; i < keys.size(); i++) results[i] = filter.Contain(keys[i]);
+      }));
+  row("ContainBatch", LookupBenchmark(keys, 1, [&](Status *results) {
+        filter.ContainBatch(keys.data(), keys.size(), results);
+      }));
+  for (size_t width = 1; width <= 64; width *= 2) {
+    row("ContainAsync width " + to_string(width),
+        LookupBenchmark(keys, 1, [&](Status *results) {
+          RoundRobinScheduler scheduler(width);
+          for (size_t i = 0; i < keys.size(); i++) {
+            scheduler.Spawn(Lookup(filter, keys[i], &results[i]));
+          }
+          scheduler.Drain();
+        }));
+  }
+
+  cout << endl << "dependent, " << kChainLength << " lookups per request" << endl;
+  row("Contain", LookupBenchmark(keys, kChainLength, [&](Status *results) {
+        for (size_t i = 0; i < keys.size(); i++) {
+          results[i] = ChainedContain(filter, keys[i]);
+        }
+      }));
+  for (size_t width = 1; width <= 64; width *= 2) {
+    row("ContainAsync width " + to_string(width),
+        LookupBenchmark(keys, kChainLength, [&](Status *results) {
+          RoundRobinScheduler scheduler(width);
+          for (size_t i = 0; i < keys.size(); i++) {
+            scheduler.Spawn(ChainedLookup(filter, keys[i], &results[i]));
+          }
+          scheduler.Drain();
+        }));
+  }
+}
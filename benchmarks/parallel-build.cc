@@ -0,0 +1,61 @@
+// This benchmark measures how the construction speed of a cuckoo filter scales with the
+// number of threads passed to CuckooFilter::AddAll. Each row fills a new filter sized as
+// in conext-table3 to 94% of its slots, which is close to where Add starts to fail.
+//
+// Usage:
+//
+//     parallel-build.exe [add count] [max threads]
+//
+// The thread count doubles from 1 up to max threads, which defaults to the number of
+// hardware threads.
+
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// Seconds to add to_add[0, add_count) to a new filter with num_threads threads
+template <typename Table>
+double BuildSeconds(size_t capacity, size_t add_count, const vector<uint64_t>& to_add,
+                    size_t num_threads) {
+  Table cuckoo(capacity);
+  auto start_time = NowNanos();
+  if (Ok != cuckoo.AddAll(to_add, 0, add_count, num_threads)) {
+    cerr << "Filter is full after " << cuckoo.Size() << " items" << endl;
+    exit(1);
+  }
+  auto build_time = NowNanos() - start_time;
+  return build_time / static_cast<double>(1000 * 1000 * 1000);
+}
+
+int main(int argc, char* argv[]) {
+  const size_t capacity = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 127.78 * 1000 * 1000;
+  const size_t max_threads =
+      (argc > 2) ? strtoull(argv[2], nullptr, 10) : max(1u, thread::hardware_concurrency());
+  // CuckooFilter(capacity) has this many slots, see its constructor:
+  size_t num_slots = SingleTable<12>::kTagsPerBucket *
+                     upperpower2(max<uint64_t>(1, capacity / SingleTable<12>::kTagsPerBucket));
+  if (capacity > 0.96 * num_slots) num_slots *= 2;
+  const size_t add_count = 0.94 * num_slots;
+  const vector<uint64_t> to_add = GenerateRandom64(add_count);
+
+  cout << setw(10) << right << "threads" << setw(20) << "million keys/sec" << setw(10)
+       << "speedup" << endl;
+  double base = 0;
+  for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    const double seconds = BuildSeconds<CuckooFilter<uint64_t, 12>>(capacity, add_count,
+                                                                       to_add, num_threads);
+    if (1 == num_threads) base = seconds;
+    cout << setw(10) << num_threads << fixed << setprecision(2) << setw(20)
+         << add_count / seconds / (1000 * 1000) << setw(10) << base / seconds << endl;
+  }
+}
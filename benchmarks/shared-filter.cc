@@ -0,0 +1,116 @@
+// This benchmark shares one SharedCuckooFilter between processes: the parent creates it
+// in POSIX shared memory and fills it with stable keys, then forks reader processes
+// that attach to it read-only and look up the stable keys and absent ones, while the
+// parent keeps deleting and re-adding other keys, whose kick chains move the tags of
+// stable keys between buckets. It is invoked as:
+//
+//     ./shared-filter.exe [key count] [reader count] [lookups per reader]
+//
+// A stable key that a reader does not find is a false negative, which the sequence
+// counters must prevent, so that column should be 0. For comparison, the first row
+// looks up the same keys in a CuckooFilter private to the process, and the second in
+// the shared filter while nothing writes to it. The reader rows are wall time, which
+// includes waiting for a core if there are fewer cores than processes.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "random.h"
+#include "sharedcuckoofilter.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+typedef SharedCuckooFilter<uint64_t, 12> Shared;
+
+void Row(const string &name, double lookup_ns, size_t false_negatives, double fpr) {
+  cout << setw(24) << left << name << right << fixed << setprecision(1) << setw(12)
+       << lookup_ns << setw(18) << false_negatives << setw(10) << setprecision(3)
+       << 100 * fpr << "%" << endl;
+}
+
+// Looks up stable[i] and absent[i] in turn, lookups times in all, and prints a row.
+template <typename Filter>
+void Lookups(const string &name, const Filter &filter, const vector<uint64_t> &stable,
+             const vector<uint64_t> &absent, size_t lookups) {
+  size_t false_negatives = 0, false_positives = 0;
+  const auto start_time = NowNanos();
+  for (size_t i = 0; i < lookups / 2; i++) {
+    false_negatives += (Ok != filter.Contain(stable[i % stable.size()]));
+    false_positives += (Ok == filter.Contain(absent[i % absent.size()]));
+  }
+  const double lookup_ns = 1.0 * (NowNanos() - start_time) / (lookups / 2 * 2);
+  Row(name, lookup_ns, false_negatives, 1.0 * false_positives / (lookups / 2));
+}
+
+int main(int argc, char *argv[]) {
+  const size_t num_keys = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 1 << 22;
+  const size_t num_readers = (argc > 2) ? strtoull(argv[2], nullptr, 10) : 2;
+  const size_t lookups = (argc > 3) ? strtoull(argv[3], nullptr, 10) : 20 * 1000 * 1000;
+  const string name = "/cuckoo-shared-filter-" + to_string(getpid());
+
+  // 85% of the filter is stable, and 10% more is deleted and added over and over
+  const vector<uint64_t> keys = GenerateRandom64(num_keys * 2);
+  const vector<uint64_t> stable(keys.begin(), keys.begin() + num_keys * 85 / 100);
+  const vector<uint64_t> churn(keys.begin() + num_keys * 85 / 100,
+                               keys.begin() + num_keys * 95 / 100);
+  const vector<uint64_t> absent(keys.begin() + num_keys, keys.end());
+
+  cout << setw(24) << left << "filter" << right << setw(12) << "lookup ns" << setw(18)
+       << "false negatives" << setw(11) << "fpr" << endl;
+  {
+    CuckooFilter<uint64_t, 12> local(num_keys);
+    for (const uint64_t key : stable) local.Add(key);
+    for (const uint64_t key : churn) local.Add(key);
+    Lookups("private", local, stable, absent, lookups);
+  }
+
+  auto writer = Shared::Create(name, num_keys);
+  for (const uint64_t key : stable) {
+    if (writer->Add(key) != Ok) {
+      cerr << "filter full" << endl;
+      Shared::Remove(name);
+      return 1;
+    }
+  }
+  for (const uint64_t key : churn) writer->Add(key);
+  Lookups("shared, no writes", *Shared::Attach(name), stable, absent, lookups);
+
+  cout.flush();
+  vector<pid_t> readers;
+  for (size_t r = 0; r < num_readers; r++) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      const auto reader = Shared::Attach(name);
+      Lookups("shared, reader " + to_string(r), *reader, stable, absent, lookups);
+      cout.flush();
+      _exit(0);
+    }
+    readers.push_back(pid);
+  }
+
+  // churn until all readers are done
+  size_t updates = 0;
+  const auto start_time = NowNanos();
+  for (size_t done = 0; done < readers.size();) {
+    for (size_t i = 0; i < 1024; i++, updates += 2) {
+      const uint64_t key = churn[updates / 2 % churn.size()];
+      writer->Delete(key);
+      writer->Add(key);
+    }
+    for (const pid_t pid : readers) done += (waitpid(pid, nullptr, WNOHANG) == pid);
+  }
+  const double seconds = (NowNanos() - start_time) / 1e9;
+  cout << "writer: " << fixed << setprecision(2) << updates / seconds / 1e6
+       << " M updates/s during the lookups; one " << writer->SizeInRegion()
+       << "-byte region shared by " << num_readers + 1 << " processes" << endl;
+  Shared::Remove(name);
+}
@@ -0,0 +1,114 @@
+// This benchmark builds many small filters, one per object as in a per-document term
+// filter, with CuckooFilter, which allocates its table and seeds its own hasher, and with
+// FixedCuckooFilter, which keeps its buckets inline and shares one hasher. It is invoked
+// as:
+//
+//     ./small-filters.exe [filter count]
+//
+// For each capacity, the construct rows time creating and destroying one filter, the add
+// rows filling a filter to its capacity, and the lookup rows one Contain() of an added
+// key and one of another key. The bytes column is the size of the filter object plus
+// the table it allocates.
+
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "fixedcuckoofilter.h"
+#include "random.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+// ns per filter of make(filters, count), which constructs filters
+template <typename Make>
+double TimePerFilter(size_t count, Make make) {
+  const auto start_time = NowNanos();
+  make(count);
+  return 1.0 * (NowNanos() - start_time) / count;
+}
+
+void Row(const string &name, double construct_ns, double add_ns, double lookup_ns,
+         size_t bytes) {
+  cout << setw(28) << left << name << right << fixed << setprecision(1) << setw(14)
+       << construct_ns << setw(12) << add_ns << setw(12) << lookup_ns << setw(10)
+       << bytes << endl;
+}
+
+template <size_t capacity>
+void Compare(size_t filter_count, const vector<uint64_t> &keys) {
+  typedef CuckooFilter<uint64_t, 12> Dynamic;
+  typedef FixedCuckooFilter<capacity, 12> Fixed;
+  const size_t num_keys = filter_count * capacity;
+  const auto key = [&](size_t f, size_t k) { return keys[(f * capacity + k) % keys.size()]; };
+  const auto absent = [&](size_t f, size_t k) { return key(f, k) + 1; };
+  size_t found = 0;
+
+  {
+    const double construct_ns = TimePerFilter(filter_count, [&](size_t n) {
+      for (size_t f = 0; f < n; f++) {
+        Dynamic filter(capacity);
+        found += filter.Size();
+      }
+    });
+    vector<unique_ptr<Dynamic>> filters(filter_count);
+    for (auto &filter : filters) filter.reset(new Dynamic(capacity));
+    auto start_time = NowNanos();
+    for (size_t f = 0; f < filter_count; f++) {
+      for (size_t k = 0; k < capacity; k++) filters[f]->Add(key(f, k));
+    }
+    const double add_ns = 1.0 * (NowNanos() - start_time) / num_keys;
+    start_time = NowNanos();
+    for (size_t f = 0; f < filter_count; f++) {
+      for (size_t k = 0; k < capacity; k++) {
+        found += (Ok == filters[f]->Contain(key(f, k)));
+        found += (Ok == filters[f]->Contain(absent(f, k)));
+      }
+    }
+    const double lookup_ns = 0.5 * (NowNanos() - start_time) / num_keys;
+    Row("CuckooFilter " + to_string(capacity), construct_ns, add_ns, lookup_ns,
+        sizeof(Dynamic) + filters[0]->SizeInBytes());
+  }
+  {
+    const double construct_ns = TimePerFilter(filter_count, [&](size_t n) {
+      for (size_t f = 0; f < n; f++) {
+        Fixed filter;
+        found += filter.Size();
+      }
+    });
+    vector<Fixed> filters(filter_count);
+    auto start_time = NowNanos();
+    for (size_t f = 0; f < filter_count; f++) {
+      for (size_t k = 0; k < capacity; k++) filters[f].Add(key(f, k));
+    }
+    const double add_ns = 1.0 * (NowNanos() - start_time) / num_keys;
+    start_time = NowNanos();
+    for (size_t f = 0; f < filter_count; f++) {
+      for (size_t k = 0; k < capacity; k++) {
+        found += (Ok == filters[f].Contain(key(f, k)));
+        found += (Ok == filters[f].Contain(absent(f, k)));
+      }
+    }
+    const double lookup_ns = 0.5 * (NowNanos() - start_time) / num_keys;
+    Row("FixedCuckooFilter " + to_string(capacity), construct_ns, add_ns, lookup_ns,
+        sizeof(Fixed));
+  }
+  // keeps the loops above from being optimized away
+  if (found == 1) cout << endl;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t filter_count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 100 * 1000;
+  const vector<uint64_t> keys = GenerateRandom64(1 << 22);
+
+  cout << setw(28) << left << "filter, capacity" << right << setw(14) << "construct ns"
+       << setw(12) << "add ns" << setw(12) << "lookup ns" << setw(10) << "bytes" << endl;
+  Compare<8>(filter_count, keys);
+  Compare<64>(filter_count, keys);
+  Compare<256>(filter_count, keys);
+}
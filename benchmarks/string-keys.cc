@@ -0,0 +1,132 @@
+// This benchmark reports the throughput of hashing and of filters with keys that are not
+// integers: URLs, stored as std::string, and 16-byte UUIDs, stored as a struct. It is
+// invoked as:
+//
+//     ./string-keys.exe 4000000
+//
+// The hash rows time each hash function over all keys. The filter rows time Add() of all
+// keys to a CuckooFilter sized for them, which hashes keys with WyHash by default, and
+// Contain() of the same keys.
+
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "timing.h"
+
+using namespace std;
+
+using namespace cuckoofilter;
+
+struct Uuid {
+  uint8_t bytes[16];
+};
+
+// URLs with a host from a small set and a random path of 12 to 91 bytes
+vector<string> GenerateUrls(size_t count) {
+  static const char *kHosts[] = {"www.example.com", "en.wikipedia.org", "news.example.org",
+                                 "cdn.images.example.net", "api.example.io"};
+  static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+  mt19937_64 random(count);
+  vector<string> result(count);
+  for (auto &url : result) {
+    url = "https://";
+    url += kHosts[random() % (sizeof(kHosts) / sizeof(kHosts[0]))];
+    const size_t length = url.size() + 12 + random() % 80;
+    while (url.size() < length) {
+      url += (0 == random() % 8) ? '/' : kAlphabet[random() % (sizeof(kAlphabet) - 1)];
+    }
+  }
+  return result;
+}
+
+// Random (version 4) UUIDs
+vector<Uuid> GenerateUuids(size_t count) {
+  random_device random;
+  vector<Uuid> result(count);
+  for (auto &uuid : result) {
+    for (size_t i = 0; i < sizeof(uuid.bytes); i += 4) {
+      const uint32_t r = random();
+      memcpy(&uuid.bytes[i], &r, 4);
+    }
+    uuid.bytes[6] = (uuid.bytes[6] & 0x0f) | 0x40;
+    uuid.bytes[8] = (uuid.bytes[8] & 0x3f) | 0x80;
+  }
+  return result;
+}
+
+const void *KeyData(const string &key) { return key.data(); }
+size_t KeySize(const string &key) { return key.size(); }
+const void *KeyData(const Uuid &key) { return key.bytes; }
+size_t KeySize(const Uuid &key) { return sizeof(key.bytes); }
+
+// Million keys per second of hash(data, size)
+template <typename Key, typename Hash>
+double HashBenchmark(const vector<Key> &keys, Hash hash) {
+  uint64_t sum = 0;
+  auto start_time = NowNanos();
+  for (const auto &key : keys) sum += hash(KeyData(key), KeySize(key));
+  auto time = NowNanos() - start_time;
+  // Keep the compiler from optimizing out the hashing:
+  if (sum == 42) cerr << "";
+  return keys.size() * 1000.0 / time;
+}
+
+// Million keys per second of Add() and of Contain() of all keys
+template <typename Key>
+pair<double, double> FilterBenchmark(const vector<Key> &keys) {
+  CuckooFilter<Key, 12> filter(keys.size());
+  auto start_time = NowNanos();
+  for (const auto &key : keys) {
+    if (Ok != filter.Add(key)) {
+      cerr << "Filter is full after " << filter.Size() << " items" << endl;
+      exit(1);
+    }
+  }
+  auto add_time = NowNanos() - start_time;
+  size_t found = 0;
+  start_time = NowNanos();
+  for (const auto &key : keys) found += (Ok == filter.Contain(key));
+  auto find_time = NowNanos() - start_time;
+  if (found != keys.size()) {
+    cerr << "False negatives" << endl;
+    exit(1);
+  }
+  return make_pair(keys.size() * 1000.0 / add_time, keys.size() * 1000.0 / find_time);
+}
+
+template <typename Key>
+void Report(const string &name, const vector<Key> &keys) {
+  const WyHash wyhash;
+  const auto row = [&name](const string &what, double speed) {
+    cout << setw(8) << left << name << setw(20) << what << setw(10) << right << fixed
+         << setprecision(2) << speed << endl;
+  };
+  row("WyHash", HashBenchmark(keys, [&wyhash](const void *data, size_t size) {
+        return wyhash(data, size);
+      }));
+  row("MurmurHash2", HashBenchmark(keys, [](const void *data, size_t size) {
+        return HashUtil::MurmurHash(data, size);
+      }));
+  row("BobHash", HashBenchmark(keys, [](const void *data, size_t size) {
+        return HashUtil::BobHash(data, size);
+      }));
+  row("SuperFastHash", HashBenchmark(keys, [](const void *data, size_t size) {
+        return HashUtil::SuperFastHash(data, size);
+      }));
+  const auto filter = FilterBenchmark(keys);
+  row("Cuckoo12 Add", filter.first);
+  row("Cuckoo12 Contain", filter.second);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 4 * 1000 * 1000;
+  cout << setw(8) << left << "keys" << setw(20) << "operation" << setw(10) << right
+       << "Mkeys/sec" << endl;
+  Report("URL", GenerateUrls(count));
+  Report("UUID", GenerateUuids(count));
+}
@@ -0,0 +1,75 @@
+// Checks that reporting a false positive to an AdaptiveCuckooFilter never
+// loses a stored key, when several stored keys have the same tag as the
+// false positive: each of them must keep a slot of its own.
+
+#include "adaptivecuckoofilter.h"
+
+#include <assert.h>
+
+#include <iostream>
+#include <vector>
+
+using cuckoofilter::AdaptiveCuckooFilter;
+using cuckoofilter::IdentityHash;
+
+// With IdentityHash a key is its own hash: its high half picks the bucket,
+// its low 8 bits are the stable part of a 12-bit tag, and the bits between
+// pick the adaptive part.
+typedef AdaptiveCuckooFilter<uint64_t, 12, IdentityHash> Filter;
+
+uint64_t Key(const uint64_t bucket, const uint64_t middle,
+             const uint64_t stable) {
+  return (bucket << 32) | (middle << 8) | stable;
+}
+
+// The next key after *middle with the same tag as key, under the first
+// selector, as Contain of a filter holding only key tells.
+uint64_t NextColliding(const uint64_t key, const uint64_t bucket,
+                       const uint64_t stable, uint64_t *middle) {
+  Filter probe(1024);
+  probe.Add(key);
+  while (probe.Contain(Key(bucket, ++*middle, stable)) != cuckoofilter::Ok) {
+  }
+  return Key(bucket, *middle, stable);
+}
+
+int main() {
+  size_t adapted = 0;
+  for (uint64_t trial = 0; trial < 32; trial++) {
+    const uint64_t bucket = 3 * trial;
+    const uint64_t stable = 1 + 5 * trial;
+    uint64_t middle = 0;
+    const uint64_t a = Key(bucket, middle, stable);
+    const uint64_t b = NextColliding(a, bucket, stable, &middle);
+    const uint64_t query = NextColliding(a, bucket, stable, &middle);
+
+    // a twice and b, all with the tag of query
+    Filter filter(1024);
+    assert(filter.Add(a) == cuckoofilter::Ok);
+    assert(filter.Add(a) == cuckoofilter::Ok);
+    assert(filter.Add(b) == cuckoofilter::Ok);
+    assert(filter.Contain(query) == cuckoofilter::Ok);
+
+    const std::vector<uint64_t> stored = {a, a, b};
+    size_t i1, i2;
+    filter.CandidateBuckets(a, &i1, &i2);
+    auto resolver = [&](size_t bucket1, size_t bucket2,
+                        std::vector<uint64_t> *keys) {
+      assert((bucket1 == i1 && bucket2 == i2) ||
+             (bucket1 == i2 && bucket2 == i1));
+      keys->insert(keys->end(), stored.begin(), stored.end());
+    };
+    adapted += filter.ReportFalsePositive(query, resolver) == cuckoofilter::Ok;
+
+    // no false negatives, for either copy of a
+    assert(filter.Contain(a) == cuckoofilter::Ok);
+    assert(filter.Contain(b) == cuckoofilter::Ok);
+    assert(filter.Delete(a) == cuckoofilter::Ok);
+    assert(filter.Contain(a) == cuckoofilter::Ok);
+    assert(filter.Contain(b) == cuckoofilter::Ok);
+  }
+  assert(adapted == 32);
+
+  std::cout << "adaptive filter: ok\n";
+  return 0;
+}
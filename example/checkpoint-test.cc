@@ -0,0 +1,123 @@
+// Checks that Checkpointer::Restore loads the last complete checkpoint:
+// after the last delta record is torn or corrupt, and after Compact.
+
+#include "checkpointer.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// a keyed alternate index, so that Restore must load it to find keys
+typedef cuckoofilter::CuckooFilter<
+    uint64_t, 12, cuckoofilter::SingleTable,
+    cuckoofilter::TwoIndependentMultiplyShift, cuckoofilter::KeyedAltIndex>
+    Filter;
+typedef cuckoofilter::Checkpointer<Filter> Checkpointer;
+
+const size_t kCapacity = 1 << 16;
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string &path, const std::string &bytes) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+// Restore path into a new filter, and check that it holds exactly the keys
+// [0, num_keys) of the ones added, up to false positives.
+void CheckRestore(const std::string &path, const uint64_t num_keys,
+                  const uint64_t num_added) {
+  Filter filter(kCapacity);
+  Checkpointer::Restore(path, &filter);
+  assert(filter.Size() == num_keys);
+  for (uint64_t key = 0; key < num_keys; key++) {
+    assert(filter.Contain(key) == cuckoofilter::Ok);
+  }
+  size_t present = 0;
+  for (uint64_t key = num_keys; key < num_added; key++) {
+    present += filter.Contain(key) == cuckoofilter::Ok;
+  }
+  assert(present <= (num_added - num_keys) / 100);
+}
+
+int main() {
+  const std::string path =
+      "/tmp/cuckoo-checkpoint-test-" + std::to_string(getpid());
+  const std::string copy = path + ".copy";
+  const uint64_t steps[] = {30000, 45000, 50000};
+
+  Filter filter(kCapacity);
+  std::mutex mutex;
+  {
+    // a large compact_ratio, so that only Compact below compacts
+    Checkpointer checkpointer(filter, path, mutex, 1e9);
+    uint64_t key = 0;
+    for (const uint64_t step : steps) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (; key < step; key++) {
+          assert(filter.Add(key) == cuckoofilter::Ok);
+        }
+      }
+      checkpointer.Checkpoint();
+    }
+    CheckRestore(path, steps[2], steps[2]);
+
+    // a torn last record, as a crash in the middle of an append leaves it
+    const std::string bytes = ReadFile(path);
+    WriteFile(copy, bytes.substr(0, bytes.size() - 1));
+    CheckRestore(copy, steps[1], steps[2]);
+    // a corrupt one, found by its checksum
+    std::string corrupt = bytes;
+    corrupt[corrupt.size() - 100] ^= 1;
+    WriteFile(copy, corrupt);
+    CheckRestore(copy, steps[1], steps[2]);
+
+    // after Compact, the base holds every key, and later records apply
+    checkpointer.Compact();
+    assert(checkpointer.NumCompactions() == 1);
+    assert(checkpointer.LogBytes() == 0);
+    CheckRestore(path, steps[2], steps[2]);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (uint64_t key = steps[2]; key < steps[2] + 1000; key++) {
+        assert(filter.Add(key) == cuckoofilter::Ok);
+      }
+    }
+    checkpointer.Checkpoint();
+    CheckRestore(path, steps[2] + 1000, steps[2] + 1000);
+  }
+
+  // files that hold no checkpoint of this filter are rejected
+  bool rejected = false;
+  try {
+    Filter larger(4 * kCapacity);
+    Checkpointer::Restore(path, &larger);
+  } catch (const std::runtime_error &) {
+    rejected = true;
+  }
+  assert(rejected);
+  WriteFile(copy, std::string(8192, 'x'));
+  rejected = false;
+  try {
+    Filter other(kCapacity);
+    Checkpointer::Restore(copy, &other);
+  } catch (const std::runtime_error &) {
+    rejected = true;
+  }
+  assert(rejected);
+  unlink(copy.c_str());
+  unlink(path.c_str());
+
+  std::cout << "checkpoint: ok\n";
+  return 0;
+}
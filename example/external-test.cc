@@ -0,0 +1,95 @@
+// Checks that an ExternalCuckooFilter saved by Sync is found again by Open,
+// with the tags that spilled from full pages, and that Open rejects files
+// it cannot use.
+
+#include "externalcuckoofilter.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+typedef cuckoofilter::ExternalCuckooFilter<uint64_t, 12> Filter;
+
+int main() {
+  const std::string path =
+      "/tmp/cuckoo-external-test-" + std::to_string(getpid());
+  const size_t num_keys = 20000;
+  // copies of one key overflow its two buckets, and spill
+  const uint64_t copied = num_keys;
+  const size_t num_copies = 12;
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < num_keys; key++) {
+    keys.push_back(key);
+  }
+
+  size_t spilled;
+  {
+    auto filter = Filter::Create(path, num_keys, 1024);
+    for (const uint64_t key : keys) {
+      assert(filter->Add(key) == cuckoofilter::Ok);
+    }
+    for (size_t c = 0; c < num_copies; c++) {
+      assert(filter->Add(copied) == cuckoofilter::Ok);
+    }
+    filter->Sync();
+    spilled = filter->Spilled();
+    assert(spilled >= num_copies - 8);
+    assert(filter->Size() == num_keys + num_copies);
+
+    // only one process may have the file open
+    bool locked = false;
+    try {
+      Filter::Open(path);
+    } catch (const std::system_error &) {
+      locked = true;
+    }
+    assert(locked);
+  }
+
+  {
+    auto filter = Filter::Open(path, 1024);
+    assert(filter->Size() == num_keys + num_copies);
+    assert(filter->Spilled() == spilled);
+    std::vector<cuckoofilter::Status> results(keys.size());
+    filter->ContainBatch(keys.data(), keys.size(), results.data());
+    for (size_t k = 0; k < keys.size(); k++) {
+      assert(results[k] == cuckoofilter::Ok);
+      assert(filter->Contain(keys[k]) == cuckoofilter::Ok);
+    }
+    // every copy is found, in its page or among the spilled tags
+    for (size_t c = 0; c < num_copies; c++) {
+      assert(filter->Contain(copied) == cuckoofilter::Ok);
+      assert(filter->Delete(copied) == cuckoofilter::Ok);
+    }
+    assert(filter->Spilled() == 0);
+    assert(filter->Size() == num_keys);
+  }
+
+  // the deletes were saved by the destructor
+  {
+    auto filter = Filter::Open(path);
+    assert(filter->Size() == num_keys);
+    assert(filter->Spilled() == 0);
+    assert(filter->Contain(keys[0]) == cuckoofilter::Ok);
+  }
+  unlink(path.c_str());
+
+  std::ofstream(path) << std::string(2 * cuckoofilter::kExternalPageSize, 'x');
+  bool rejected = false;
+  try {
+    Filter::Open(path);
+  } catch (const std::runtime_error &) {
+    rejected = true;
+  }
+  assert(rejected);
+  unlink(path.c_str());
+
+  std::cout << "external filter: ok\n";
+  return 0;
+}
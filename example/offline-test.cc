@@ -0,0 +1,69 @@
+// Checks the offline constructor CuckooFilter(keys): every key is found
+// afterwards, for each table and alternate index policy, and many copies of
+// one key neither make it loop nor lose other keys.
+
+#include "cuckoofilter.h"
+
+#include <assert.h>
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using cuckoofilter::CuckooFilter;
+
+std::vector<uint64_t> RandomKeys(const size_t n, const uint64_t seed) {
+  std::mt19937_64 random(seed);
+  std::vector<uint64_t> keys(n);
+  for (uint64_t &key : keys) {
+    key = random();
+  }
+  return keys;
+}
+
+template <typename Filter>
+void CheckBuild(const std::vector<uint64_t> &keys) {
+  Filter filter(keys);
+  for (const uint64_t key : keys) {
+    assert(filter.Contain(key) == cuckoofilter::Ok);
+  }
+  assert(filter.Size() <= keys.size());
+}
+
+int main() {
+  const std::vector<uint64_t> keys = RandomKeys(100000, 1);
+  CheckBuild<CuckooFilter<uint64_t, 12>>(keys);
+  CheckBuild<CuckooFilter<uint64_t, 13, cuckoofilter::PackedTable>>(keys);
+  // filled by Add, as offline placement would lose keys in second buckets
+  CheckBuild<CuckooFilter<uint64_t, 8, cuckoofilter::MortonTable>>(keys);
+  CheckBuild<CuckooFilter<uint64_t, 12, cuckoofilter::SingleTable,
+                          cuckoofilter::TwoIndependentMultiplyShift,
+                          cuckoofilter::KeyedAltIndex>>(keys);
+  CheckBuild<CuckooFilter<uint64_t, 12, cuckoofilter::SingleTable,
+                          cuckoofilter::IdentityHash>>(keys);
+
+  // 30 copies of one key: its two buckets hold 8 of them (9 if the victim
+  // cache is free), and the others are dropped instead of failing every build
+  std::vector<uint64_t> copies = keys;
+  copies.insert(copies.begin() + 500, 30, keys[7]);
+  CuckooFilter<uint64_t, 12> filter(copies);
+  for (const uint64_t key : keys) {
+    assert(filter.Contain(key) == cuckoofilter::Ok);
+  }
+  const size_t kept = filter.Size() - (keys.size() - 1);
+  assert(kept == 8 || kept == 9);
+
+  // Add fails for all keys after the copies that overflow into the victim
+  // cache, so MortonTable filters give up instead
+  bool thrown = false;
+  try {
+    CuckooFilter<uint64_t, 8, cuckoofilter::MortonTable> morton(copies);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "offline build: ok\n";
+  return 0;
+}
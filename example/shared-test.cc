@@ -0,0 +1,104 @@
+// Checks that a SharedCuckooFilter survives a writer killed in the middle of
+// an Add or Delete: the next writable attach ends the write, after which
+// lookups in other processes finish and the filter takes new writes. Also
+// checks that all processes use the keyed alternate index of the region.
+
+#include "sharedcuckoofilter.h"
+
+#include <assert.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+typedef cuckoofilter::SharedCuckooFilter<uint64_t, 12> Shared;
+typedef cuckoofilter::SharedCuckooFilter<
+    uint64_t, 12, cuckoofilter::SingleTable,
+    cuckoofilter::TwoIndependentMultiplyShift, cuckoofilter::KeyedAltIndex>
+    KeyedShared;
+
+const size_t kStableKeys = 60000;
+const int kCrashes = 8;
+
+// The writer spends nearly all its time between BeginWrite and EndWrite, on
+// the kick chains of a nearly full table.
+[[noreturn]] void WriteUntilKilled(const std::string &name, const int seed) {
+  const auto writer = Shared::Attach(name, true);
+  std::mt19937_64 random(seed);
+  for (;;) {
+    const uint64_t hash = random();
+    writer->AddHash(hash);
+    writer->DeleteHash(hash);
+  }
+}
+
+int main() {
+  // a lookup that spins on a counter left odd fails the test
+  alarm(120);
+  const std::string name = "/cuckoo-shared-test-" + std::to_string(getpid());
+  {
+    const auto creator = Shared::Create(name, 1 << 16);
+    for (uint64_t key = 0; key < kStableKeys; key++) {
+      assert(creator->Add(key) == cuckoofilter::Ok);
+    }
+  }
+
+  for (int crash = 0; crash < kCrashes; crash++) {
+    const pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      WriteUntilKilled(name, crash);
+    }
+    usleep(20000 + 5000 * crash);
+    kill(pid, SIGKILL);
+    int status;
+    assert(waitpid(pid, &status, 0) == pid && WIFSIGNALED(status));
+
+    const auto writer = Shared::Attach(name, true);
+    const auto reader = Shared::Attach(name);
+    // each crash loses at most the tag its kick chain was moving
+    size_t missing = 0;
+    for (uint64_t key = 0; key < kStableKeys; key++) {
+      missing += reader->Contain(key) != cuckoofilter::Ok;
+    }
+    assert(missing <= static_cast<size_t>(crash) + 1);
+
+    const uint64_t key = kStableKeys + crash;
+    if (writer->Add(key) == cuckoofilter::Ok) {
+      assert(reader->Contain(key) == cuckoofilter::Ok);
+      assert(writer->Delete(key) == cuckoofilter::Ok);
+    }
+  }
+  Shared::Remove(name);
+
+  // at 90% load many keys are in their alternate buckets, which a reader
+  // finds only with the writer's secret
+  const std::string keyed_name = name + "-keyed";
+  {
+    const auto creator = KeyedShared::Create(keyed_name, 1 << 16);
+    for (uint64_t key = 0; key < kStableKeys; key++) {
+      assert(creator->Add(key) == cuckoofilter::Ok);
+    }
+    const pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      const auto reader = KeyedShared::Attach(keyed_name);
+      for (uint64_t key = 0; key < kStableKeys; key++) {
+        if (reader->Contain(key) != cuckoofilter::Ok) {
+          _exit(1);
+        }
+      }
+      _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0);
+  }
+  KeyedShared::Remove(keyed_name);
+
+  std::cout << "shared filter: ok\n";
+  return 0;
+}
@@ -0,0 +1,53 @@
+// Checks that a CuckooValueFilter returns the value added with each key,
+// after the kicks of a nearly full table, Update and Delete.
+
+#include "cuckoovaluefilter.h"
+
+#include <assert.h>
+
+#include <iostream>
+
+typedef cuckoofilter::CuckooValueFilter<uint64_t, 12, 4> Filter;
+
+uint32_t ValueOf(const uint64_t key) { return (key * 7) & 15; }
+
+int main() {
+  const size_t total_items = 1 << 16;
+  Filter filter(total_items);
+  // fill to 95%, where most adds kick out tags and their values
+  const size_t num_inserted = total_items * 95 / 100;
+  for (uint64_t key = 0; key < num_inserted; key++) {
+    assert(filter.Add(key, ValueOf(key)) == cuckoofilter::Ok);
+  }
+  assert(filter.Size() <= num_inserted);
+
+  uint32_t value;
+  size_t wrong = 0;
+  for (uint64_t key = 0; key < num_inserted; key++) {
+    assert(filter.Lookup(key, &value) == cuckoofilter::Ok);
+    assert(filter.Contain(key) == cuckoofilter::Ok);
+    // another key with the same tag and buckets may answer first
+    wrong += value != ValueOf(key);
+  }
+  assert(wrong < num_inserted / 1000);
+
+  for (uint64_t key = 0; key < num_inserted; key += 2) {
+    assert(filter.Update(key, 15 - ValueOf(key)) == cuckoofilter::Ok);
+  }
+  wrong = 0;
+  for (uint64_t key = 0; key < num_inserted; key++) {
+    assert(filter.Lookup(key, &value) == cuckoofilter::Ok);
+    wrong += value != ((key % 2 == 0) ? 15 - ValueOf(key) : ValueOf(key));
+  }
+  assert(wrong < num_inserted / 1000);
+
+  for (uint64_t key = 1; key < num_inserted; key += 2) {
+    assert(filter.Delete(key) == cuckoofilter::Ok);
+  }
+  for (uint64_t key = 0; key < num_inserted; key += 2) {
+    assert(filter.Lookup(key, &value) == cuckoofilter::Ok);
+  }
+
+  std::cout << "value filter: ok\n";
+  return 0;
+}
@@ -0,0 +1,416 @@
+#ifndef CUCKOO_FILTER_ADAPTIVE_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_ADAPTIVE_CUCKOO_FILTER_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "valuetable.h"
+
+namespace cuckoofilter {
+
+// An adaptive cuckoo filter (see Mitzenmacher, Pontarelli and Reviriego,
+// "Adaptive Cuckoo Filters") that stops repeating a false positive once the
+// caller reports it.
+//
+// Each slot holds a tag plus a 2-bit selector saying which of four tag
+// functions produced it. When a query turns out to be a false positive,
+// ReportFalsePositive() asks the caller's authoritative store for the real
+// key behind the colliding slot and rewrites that slot with the key's tag
+// under the next selector, so the same query no longer matches.
+//
+// A tag is split into a stable low part, shared by all selectors, and a
+// kAdaptiveBits high part that depends on the selector. AltIndex() only uses
+// the stable part, so kicks still work without knowing the key.
+template <typename ItemType, size_t bits_per_item,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type>
+class AdaptiveCuckooFilter {
+  static_assert(bits_per_item >= 8 && bits_per_item <= 32,
+                "bits_per_item must be in [8, 32]");
+
+  static const size_t kSelectorBits = 2;
+  static const size_t kNumSelectors = 1 << kSelectorBits;
+  static const size_t kAdaptiveBits = 4;
+  static const size_t kStableBits = bits_per_item - kAdaptiveBits;
+  static const uint32_t kStableMask = (1ULL << kStableBits) - 1;
+  static const size_t kTagsPerBucket = 4;
+
+ public:
+  // Appends to keys every key in the authoritative store whose candidate
+  // buckets (see CandidateBuckets()) are bucket1 and bucket2, in either
+  // order. A store can serve this by indexing its keys on
+  // min(bucket1, bucket2).
+  typedef std::function<void(size_t bucket1, size_t bucket2,
+                             std::vector<ItemType> *keys)>
+      KeyResolver;
+
+ private:
+  // Storage of items; the value of each slot is its selector
+  ValueTable<bits_per_item, kSelectorBits> table_;
+
+  // Number of items stored
+  size_t num_items_;
+
+  typedef struct {
+    size_t index;
+    uint32_t tag;
+    uint32_t selector;
+    bool used;
+  } VictimCache;
+
+  VictimCache victim_;
+
+  HashFamily hasher_;
+
+  // picks the tags that kick chains kick out
+  WyRand random_;
+
+  // number of buckets, a power of two, for max_num_keys at up to 96% load
+  static size_t NumBucketsFor(const size_t max_num_keys) {
+    size_t num_buckets =
+        upperpower2(std::max<uint64_t>(1, max_num_keys / kTagsPerBucket));
+    double frac = (double)max_num_keys / num_buckets / kTagsPerBucket;
+    if (frac > 0.96) {
+      num_buckets <<= 1;
+    }
+    return num_buckets;
+  }
+
+  inline size_t IndexHash(uint32_t hv) const {
+    return hv & (table_.NumBuckets() - 1);
+  }
+
+  // Tag of the item with hash value hv under the given selector. Selector
+  // zero is used on insertion.
+  inline uint32_t TagHash(uint64_t hv, uint32_t selector) const {
+    // Odd multipliers, one per selector, to draw the adaptive bits from
+    static const uint64_t kSelectorMultipliers[kNumSelectors] = {
+        0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL,
+        0xd6e8feb86659fd93ULL};
+    uint32_t stable = hv & kStableMask;
+    stable += (stable == 0);
+    const uint32_t adaptive =
+        (hv * kSelectorMultipliers[selector]) >> (64 - kAdaptiveBits);
+    return stable | (adaptive << kStableBits);
+  }
+
+  inline void GenerateIndexTags(const ItemType &item, size_t *index,
+                                uint32_t tags[kNumSelectors]) const {
+    const uint64_t hash = hasher_(item);
+    *index = IndexHash(hash >> 32);
+    for (uint32_t s = 0; s < kNumSelectors; s++) {
+      tags[s] = TagHash(hash, s);
+    }
+  }
+
+  inline size_t AltIndex(const size_t index, const uint32_t tag) const {
+    return IndexHash((uint32_t)(index ^ ((tag & kStableMask) * 0x5bd1e995)));
+  }
+
+  Status AddImpl(const size_t i, const uint32_t tag, const uint32_t selector);
+
+  // A slot of the two buckets of a false positive, or the victim if j is
+  // kTagsPerBucket, with the tag and selector it holds.
+  struct Slot {
+    size_t i;
+    size_t j;
+    uint32_t tag;
+    uint32_t selector;
+  };
+
+  // Find a slot among slots for the key of hash hashes[k], taking it from
+  // the key that holds it if that key can move to another one (an
+  // augmenting path). owners[s] is the key of slot s, or -1, and visited
+  // marks the slots tried.
+  bool MatchKey(const size_t k, const std::vector<uint64_t> &hashes,
+                const std::vector<Slot> &slots, std::vector<int> *owners,
+                std::vector<bool> *visited) const;
+
+  // load factor is the fraction of occupancy
+  double LoadFactor() const { return 1.0 * Size() / table_.SizeInTags(); }
+
+  double BitsPerItem() const { return 8.0 * table_.SizeInBytes() / Size(); }
+
+ public:
+  explicit AdaptiveCuckooFilter(const size_t max_num_keys)
+      : table_(NumBucketsFor(max_num_keys)),
+        num_items_(0),
+        victim_(),
+        hasher_(),
+        random_() {
+    victim_.used = false;
+  }
+
+  // A moved-from filter may only be assigned to or destroyed.
+  AdaptiveCuckooFilter(AdaptiveCuckooFilter &&other) noexcept
+      : table_(std::move(other.table_)),
+        num_items_(other.num_items_),
+        victim_(other.victim_),
+        hasher_(std::move(other.hasher_)),
+        random_(other.random_) {
+    other.num_items_ = 0;
+    other.victim_.used = false;
+  }
+
+  AdaptiveCuckooFilter &operator=(AdaptiveCuckooFilter &&other) noexcept {
+    if (this != &other) {
+      table_ = std::move(other.table_);
+      num_items_ = other.num_items_;
+      victim_ = other.victim_;
+      hasher_ = std::move(other.hasher_);
+      random_ = other.random_;
+      other.num_items_ = 0;
+      other.victim_.used = false;
+    }
+    return *this;
+  }
+
+  AdaptiveCuckooFilter(const AdaptiveCuckooFilter &) = delete;
+  AdaptiveCuckooFilter &operator=(const AdaptiveCuckooFilter &) = delete;
+
+  // Add an item to the filter.
+  Status Add(const ItemType &item);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Delete an key from the filter
+  Status Delete(const ItemType &item);
+
+  // Tell the filter that Contain(item) returned a false positive. Every slot
+  // that matched item is rewritten using the true key that resolver returns
+  // for it, which resolver must list once per copy stored, as each copy
+  // keeps a slot of its own. Returns Ok if at least one slot was adapted,
+  // NotFound otherwise (e.g. item was actually added, or resolver did not
+  // know the key).
+  Status ReportFalsePositive(const ItemType &item,
+                             const KeyResolver &resolver);
+
+  // The two buckets item can live in, for use by a KeyResolver.
+  void CandidateBuckets(const ItemType &item, size_t *i1, size_t *i2) const {
+    uint32_t tags[kNumSelectors];
+    GenerateIndexTags(item, i1, tags);
+    *i2 = AltIndex(*i1, tags[0]);
+  }
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return num_items_; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return table_.SizeInBytes(); }
+};
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::Add(
+    const ItemType &item) {
+  size_t i;
+  uint32_t tags[kNumSelectors];
+
+  if (victim_.used) {
+    return NotEnoughSpace;
+  }
+
+  GenerateIndexTags(item, &i, tags);
+  return AddImpl(i, tags[0], 0);
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::AddImpl(
+    const size_t i, const uint32_t tag, const uint32_t selector) {
+  size_t curindex = i;
+  uint32_t curtag = tag;
+  uint32_t curselector = selector;
+  uint32_t oldtag, oldselector;
+
+  for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
+    bool kickout = count > 0;
+    oldtag = 0;
+    oldselector = 0;
+    if (table_.InsertTagToBucket(curindex, curtag, curselector, kickout,
+                                  oldtag, oldselector, random_)) {
+      num_items_++;
+      return Ok;
+    }
+    if (kickout) {
+      curtag = oldtag;
+      curselector = oldselector;
+    }
+    curindex = AltIndex(curindex, curtag);
+  }
+
+  victim_.index = curindex;
+  victim_.tag = curtag;
+  victim_.selector = curselector;
+  victim_.used = true;
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::Contain(
+    const ItemType &key) const {
+  size_t i1, i2;
+  uint32_t tags[kNumSelectors];
+
+  GenerateIndexTags(key, &i1, tags);
+  i2 = AltIndex(i1, tags[0]);
+
+  assert(i1 == AltIndex(i2, tags[0]));
+
+  if (victim_.used && victim_.tag == tags[victim_.selector] &&
+      (i1 == victim_.index || i2 == victim_.index)) {
+    return Ok;
+  }
+  for (size_t j = 0; j < kTagsPerBucket; j++) {
+    if (table_.ReadTag(i1, j) == tags[table_.ReadValue(i1, j)] ||
+        table_.ReadTag(i2, j) == tags[table_.ReadValue(i2, j)]) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::Delete(
+    const ItemType &key) {
+  size_t i1, i2;
+  uint32_t tags[kNumSelectors];
+
+  GenerateIndexTags(key, &i1, tags);
+  i2 = AltIndex(i1, tags[0]);
+
+  for (size_t i : {i1, i2}) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (table_.ReadTag(i, j) == tags[table_.ReadValue(i, j)]) {
+        table_.WriteTag(i, j, 0, 0);
+        num_items_--;
+        if (victim_.used) {
+          victim_.used = false;
+          AddImpl(victim_.index, victim_.tag, victim_.selector);
+        }
+        return Ok;
+      }
+    }
+  }
+  if (victim_.used && victim_.tag == tags[victim_.selector] &&
+      (i1 == victim_.index || i2 == victim_.index)) {
+    victim_.used = false;
+    return Ok;
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+bool AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::MatchKey(
+    const size_t k, const std::vector<uint64_t> &hashes,
+    const std::vector<Slot> &slots, std::vector<int> *owners,
+    std::vector<bool> *visited) const {
+  for (size_t s = 0; s < slots.size(); s++) {
+    if ((*visited)[s] ||
+        TagHash(hashes[k], slots[s].selector) != slots[s].tag) {
+      continue;
+    }
+    (*visited)[s] = true;
+    if ((*owners)[s] < 0 ||
+        MatchKey((*owners)[s], hashes, slots, owners, visited)) {
+      (*owners)[s] = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status AdaptiveCuckooFilter<ItemType, bits_per_item,
+                            HashFamily>::ReportFalsePositive(
+    const ItemType &item, const KeyResolver &resolver) {
+  size_t i1, i2;
+  uint32_t tags[kNumSelectors];
+
+  GenerateIndexTags(item, &i1, tags);
+  i2 = AltIndex(i1, tags[0]);
+
+  // the slots of both buckets and the victim, any of which may hold a key
+  // of the resolver
+  std::vector<Slot> slots;
+  for (size_t i : {i1, i2}) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      slots.push_back(
+          Slot{i, j, table_.ReadTag(i, j), table_.ReadValue(i, j)});
+    }
+    if (i1 == i2) {
+      break;
+    }
+  }
+  if (victim_.used && (i1 == victim_.index || i2 == victim_.index)) {
+    slots.push_back(
+        Slot{victim_.index, kTagsPerBucket, victim_.tag, victim_.selector});
+  }
+  bool collides = false;
+  for (const Slot &slot : slots) {
+    collides |= slot.tag == tags[slot.selector];
+  }
+  if (!collides) {
+    return NotFound;
+  }
+
+  std::vector<ItemType> keys;
+  resolver(i1, i2, &keys);
+  std::vector<uint64_t> hashes;
+  for (const ItemType &key : keys) {
+    if (!(key == item)) {
+      hashes.push_back(hasher_(key));
+    }
+  }
+  // Every stored copy of a key gets a slot of its own before any slot is
+  // rewritten: two keys may have the same tag under the same selector, and
+  // rewriting both of their slots for one of them would lose the other.
+  std::vector<int> owners(slots.size(), -1);
+  for (size_t k = 0; k < hashes.size(); k++) {
+    std::vector<bool> visited(slots.size(), false);
+    MatchKey(k, hashes, slots, &owners, &visited);
+  }
+
+  bool adapted = false;
+  for (size_t s = 0; s < slots.size(); s++) {
+    const Slot &slot = slots[s];
+    if (slot.tag != tags[slot.selector] || owners[s] < 0) {
+      continue;
+    }
+    const uint32_t next = (slot.selector + 1) % kNumSelectors;
+    const uint32_t tag = TagHash(hashes[owners[s]], next);
+    if (slot.j == kTagsPerBucket) {
+      victim_.tag = tag;
+      victim_.selector = next;
+    } else {
+      table_.WriteTag(slot.i, slot.j, tag, next);
+    }
+    adapted = true;
+  }
+  return adapted ? Ok : NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+std::string AdaptiveCuckooFilter<ItemType, bits_per_item, HashFamily>::Info()
+    const {
+  std::stringstream ss;
+  ss << "AdaptiveCuckooFilter Status:\n"
+     << "\t\t" << table_.Info() << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tLoad factor: " << LoadFactor() << "\n"
+     << "\t\tHashtable size: " << (table_.SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << BitsPerItem() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_ADAPTIVE_CUCKOO_FILTER_H_
@@ -0,0 +1,75 @@
+#ifndef CUCKOO_FILTER_ALT_INDEX_H_
+#define CUCKOO_FILTER_ALT_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+
+namespace cuckoofilter {
+
+// Policies computing the alternate bucket of a tag for CuckooFilter. A policy
+// maps (index, tag) to another index in [0, num_buckets), where num_buckets
+// is a power of two, and must be an involution for a fixed tag:
+//   policy(policy(i, tag, n), tag, n) == i
+
+// Partial-key cuckoo hashing over the whole table: the alternate bucket can
+// be anywhere, so the two buckets of an item almost never share a page.
+class XorAltIndex {
+ public:
+  size_t operator()(const size_t index, const uint32_t tag,
+                    const size_t num_buckets) const {
+    // NOTE(binfan): originally we use:
+    // index ^ HashUtil::BobHash((const void*) (&tag), 4)) & table_->INDEXMASK;
+    // now doing a quick-n-dirty way:
+    // 0x5bd1e995 is the hash constant from MurmurHash2
+    return (uint32_t)(index ^ (tag * 0x5bd1e995)) & (num_buckets - 1);
+  }
+};
+
+// Vacuum filter style alternate buckets (see Wang et al., "Vacuum Filters:
+// More Space-Efficient and Faster Replacement for Bloom and Cuckoo
+// Filters"). Three out of four tags keep their alternate bucket inside the
+// same aligned chunk of kChunkBuckets buckets, e.g. a page, so most lookups
+// touch a single page. The remaining tags use the whole table, which keeps
+// the load factor close to that of XorAltIndex.
+template <size_t kChunkBuckets = 512>
+class VacuumAltIndex {
+  static_assert((kChunkBuckets & (kChunkBuckets - 1)) == 0,
+                "kChunkBuckets must be a power of two");
+
+ public:
+  size_t operator()(const size_t index, const uint32_t tag,
+                    const size_t num_buckets) const {
+    const bool local = ((tag * 0x9e3779b9U) >> 30) != 0;
+    const size_t range =
+        (local && kChunkBuckets < num_buckets) ? kChunkBuckets : num_buckets;
+    return ((uint32_t)(index ^ (tag * 0x5bd1e995)) & (range - 1)) |
+           (index & ~(range - 1));
+  }
+};
+
+// XorAltIndex with a random secret per filter, so the alternate bucket of a
+// tag cannot be predicted without it. Meant for use with a keyed
+// HashFamily such as SipHash13, against clients that craft colliding keys.
+class KeyedAltIndex {
+  uint64_t multiply_;
+  uint32_t key_;
+
+ public:
+  KeyedAltIndex() {
+    ::std::random_device random;
+    multiply_ = (random() | (static_cast<uint64_t>(random()) << 32)) | 1;
+    key_ = random();
+  }
+
+  size_t operator()(const size_t index, const uint32_t tag,
+                    const size_t num_buckets) const {
+    return (index ^ ((static_cast<uint64_t>(tag ^ key_) * multiply_) >> 32)) &
+           (num_buckets - 1);
+  }
+};
+
+}  // namespace cuckoofilter
+
+#endif  // CUCKOO_FILTER_ALT_INDEX_H_
@@ -0,0 +1,354 @@
+#ifndef CUCKOO_FILTER_BINARY_FUSE_FILTER_H_
+#define CUCKOO_FILTER_BINARY_FUSE_FILTER_H_
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cuckoofilter.h"
+
+namespace cuckoofilter {
+
+// A static filter for key sets that are known up front and never modified:
+// a 3-wise binary fuse filter (Graf and Lemire, "Binary Fuse Filters: Fast
+// and Smaller Than Xor Filters"). The fingerprint array is split into
+// segments; every key maps to one slot in each of three consecutive
+// segments, and a key is present iff the xor of its three slots equals its
+// fingerprint. The three loads of a lookup only depend on the hash, so they
+// are independent and can all be in flight at once.
+//
+// Slots are assigned by peeling: repeatedly take a slot that only one
+// remaining key maps to, and fill slots in reverse order. With about 1.13
+// slots per key (a bit more for small sets) peeling succeeds with high
+// probability; otherwise AddAll() retries with a fresh hash function.
+//
+// bits_per_fingerprint is 8 or 16, for a false positive rate of about 2^-8
+// or 2^-16.
+template <typename ItemType, size_t bits_per_fingerprint,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type>
+class BinaryFuseFilter {
+  static_assert(bits_per_fingerprint == 8 || bits_per_fingerprint == 16,
+                "bits_per_fingerprint must be 8 or 16");
+
+  typedef typename std::conditional<bits_per_fingerprint == 8, uint8_t,
+                                    uint16_t>::type FingerprintType;
+
+  static const size_t kArity = 3;
+  static const size_t kMaxSegmentLength = 1 << 18;
+  static const int kMaxIterations = 100;
+  // Hash in parallel only for sets large enough to amortize the threads
+  static const size_t kMinParallelKeys = 1 << 16;
+
+  FingerprintType *fingerprints_;
+  size_t array_length_;
+  uint32_t segment_length_;
+  uint32_t segment_length_mask_;
+  uint32_t segment_count_;
+  uint32_t segment_count_length_;
+
+  // Number of items stored, and how many the filter was allocated for
+  size_t num_items_;
+  size_t max_num_keys_;
+
+  HashFamily hasher_;
+
+  static inline uint64_t MulHi(const uint64_t a, const uint64_t b) {
+    return ((unsigned __int128)a * b) >> 64;
+  }
+
+  inline FingerprintType Fingerprint(const uint64_t hash) const {
+    return (FingerprintType)(hash ^ (hash >> 32));
+  }
+
+  // Slots of hash in three consecutive segments; the offsets within the
+  // second and third segments come from disjoint hash bits.
+  inline void SlotHashes(const uint64_t hash, uint32_t *h0, uint32_t *h1,
+                         uint32_t *h2) const {
+    const uint32_t h = (uint32_t)MulHi(hash, segment_count_length_);
+    *h0 = h;
+    *h1 = (h + segment_length_) ^ ((hash >> 18) & segment_length_mask_);
+    *h2 = (h + 2 * segment_length_) ^ (hash & segment_length_mask_);
+  }
+
+  void HashKeys(const std::vector<ItemType> &keys, const size_t start,
+                const size_t end, uint64_t *hashes) const;
+
+  void SortBySlot(const uint64_t *hashes, const size_t size,
+                  uint64_t *sorted) const;
+
+  bool Peel(const uint64_t *hashes, const size_t size, uint64_t *order,
+            uint8_t *order_slot, size_t *num_duplicates);
+
+ public:
+  // Allocate a filter for up to max_num_keys keys; AddAll() fills it.
+  explicit BinaryFuseFilter(const size_t max_num_keys);
+
+  BinaryFuseFilter(BinaryFuseFilter &&that)
+      : fingerprints_(that.fingerprints_),
+        array_length_(that.array_length_),
+        segment_length_(that.segment_length_),
+        segment_length_mask_(that.segment_length_mask_),
+        segment_count_(that.segment_count_),
+        segment_count_length_(that.segment_count_length_),
+        num_items_(that.num_items_),
+        max_num_keys_(that.max_num_keys_),
+        hasher_(that.hasher_) {
+    that.fingerprints_ = nullptr;
+  }
+
+  ~BinaryFuseFilter() { delete[] fingerprints_; }
+
+  // Build the filter from keys[start, end), replacing its contents.
+  // Duplicate keys are allowed. Returns NotEnoughSpace if there are more
+  // keys than the filter was allocated for.
+  Status AddAll(const std::vector<ItemType> &keys, const size_t start,
+                const size_t end);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const {
+    const uint64_t hash = hasher_(item);
+    uint32_t h0, h1, h2;
+    SlotHashes(hash, &h0, &h1, &h2);
+    const FingerprintType f = Fingerprint(hash) ^ fingerprints_[h0] ^
+                              fingerprints_[h1] ^ fingerprints_[h2];
+    return f == 0 ? Ok : NotFound;
+  }
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return num_items_; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return array_length_ * sizeof(FingerprintType); }
+
+ private:
+  BinaryFuseFilter(const BinaryFuseFilter &) = delete;
+  void operator=(const BinaryFuseFilter &) = delete;
+};
+
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::BinaryFuseFilter(
+    const size_t max_num_keys)
+    : fingerprints_(nullptr),
+      num_items_(0),
+      max_num_keys_(max_num_keys),
+      hasher_() {
+  const size_t size = std::max<size_t>(max_num_keys, 2);
+  // Segments grow with the key set, which keeps peeling reliable for small
+  // sets and the slots per key close to 1.125 for large ones.
+  segment_length_ = 1U << (int)floor(log((double)size) / log(3.33) + 2.25);
+  segment_length_ = std::min<uint32_t>(segment_length_, kMaxSegmentLength);
+  segment_length_mask_ = segment_length_ - 1;
+  const double size_factor =
+      std::max(1.125, 0.875 + 0.25 * log(1000000.0) / log((double)size));
+  const size_t capacity = (size_t)round(size * size_factor);
+  const size_t total_segments =
+      (capacity + segment_length_ - 1) / segment_length_;
+  segment_count_ =
+      total_segments <= kArity - 1 ? 1 : total_segments - (kArity - 1);
+  array_length_ = (size_t)(segment_count_ + kArity - 1) * segment_length_;
+  segment_count_length_ = segment_count_ * segment_length_;
+  fingerprints_ = new FingerprintType[array_length_];
+  memset(fingerprints_, 0, SizeInBytes());
+}
+
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+void BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::HashKeys(
+    const std::vector<ItemType> &keys, const size_t start, const size_t end,
+    uint64_t *hashes) const {
+  const size_t size = end - start;
+  size_t num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  if (size < kMinParallelKeys) {
+    num_threads = 1;
+  }
+  auto hash_range = [&](const size_t from, const size_t to) {
+    for (size_t i = from; i < to; i++) {
+      hashes[i - start] = hasher_(keys[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  const size_t chunk = (size + num_threads - 1) / num_threads;
+  for (size_t t = 1; t < num_threads; t++) {
+    const size_t from = std::min(end, start + t * chunk);
+    const size_t to = std::min(end, from + chunk);
+    threads.emplace_back(hash_range, from, to);
+  }
+  hash_range(start, std::min(end, start + chunk));
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// The first slot of a hash grows with its top bits, so a counting sort on
+// those bits makes the slot updates of Peel() sweep the array instead of
+// missing the cache on every key.
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+void BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::SortBySlot(
+    const uint64_t *hashes, const size_t size, uint64_t *sorted) const {
+  int block_bits = 1;
+  while ((1U << block_bits) < segment_count_) {
+    block_bits++;
+  }
+  std::vector<size_t> start_pos((1U << block_bits) + 1, 0);
+  for (size_t i = 0; i < size; i++) {
+    start_pos[(hashes[i] >> (64 - block_bits)) + 1]++;
+  }
+  for (size_t b = 1; b < start_pos.size(); b++) {
+    start_pos[b] += start_pos[b - 1];
+  }
+  for (size_t i = 0; i < size; i++) {
+    sorted[start_pos[hashes[i] >> (64 - block_bits)]++] = hashes[i];
+  }
+}
+
+// Peel the hypergraph of hashes[0, size). On success, order[0, size -
+// *num_duplicates) lists the hashes in peeling order, and order_slot says
+// which of its three slots each one was peeled from.
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+bool BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::Peel(
+    const uint64_t *hashes, const size_t size, uint64_t *order,
+    uint8_t *order_slot, size_t *num_duplicates) {
+  // For every slot: the number of keys mapping to it times 4, xor'd with
+  // the index (0, 1 or 2) of the slot within those keys' triples; and the
+  // xor of those keys' hashes. Once a slot has a single key left, both
+  // identify that key and where it sits.
+  std::vector<uint8_t> count(array_length_, 0);
+  std::vector<uint64_t> xor_hash(array_length_, 0);
+
+  *num_duplicates = 0;
+  for (size_t i = 0; i < size; i++) {
+    const uint64_t hash = hashes[i];
+    uint32_t h[3];
+    SlotHashes(hash, &h[0], &h[1], &h[2]);
+    for (uint8_t k = 0; k < kArity; k++) {
+      count[h[k]] += 4;
+      count[h[k]] ^= k;
+      xor_hash[h[k]] ^= hash;
+    }
+    // An identical hash added twice cancels out in all three slots: undo
+    // both copies and count them as one.
+    if ((xor_hash[h[0]] & xor_hash[h[1]] & xor_hash[h[2]]) == 0) {
+      if ((xor_hash[h[0]] == 0 && count[h[0]] == 8) ||
+          (xor_hash[h[1]] == 0 && count[h[1]] == 8) ||
+          (xor_hash[h[2]] == 0 && count[h[2]] == 8)) {
+        (*num_duplicates)++;
+        for (uint8_t k = 0; k < kArity; k++) {
+          count[h[k]] -= 4;
+          count[h[k]] ^= k;
+          xor_hash[h[k]] ^= hash;
+        }
+      }
+    }
+    // A count wrapping around means far too many keys share a slot.
+    if (count[h[0]] < 4 || count[h[1]] < 4 || count[h[2]] < 4) {
+      return false;
+    }
+  }
+
+  std::vector<uint32_t> alone(array_length_);
+  size_t queue_size = 0;
+  for (uint32_t i = 0; i < array_length_; i++) {
+    alone[queue_size] = i;
+    queue_size += ((count[i] >> 2) == 1) ? 1 : 0;
+  }
+
+  size_t stack_size = 0;
+  while (queue_size > 0) {
+    const uint32_t index = alone[--queue_size];
+    if ((count[index] >> 2) != 1) {
+      continue;
+    }
+    const uint64_t hash = xor_hash[index];
+    const uint8_t found = count[index] & 3;
+    order[stack_size] = hash;
+    order_slot[stack_size] = found;
+    stack_size++;
+
+    uint32_t h[3];
+    SlotHashes(hash, &h[0], &h[1], &h[2]);
+    for (uint8_t k = 1; k < kArity; k++) {
+      const uint8_t slot = (found + k) % kArity;
+      const uint32_t other = h[slot];
+      alone[queue_size] = other;
+      queue_size += ((count[other] >> 2) == 2) ? 1 : 0;
+      count[other] -= 4;
+      count[other] ^= slot;
+      xor_hash[other] ^= hash;
+    }
+  }
+  return stack_size + *num_duplicates == size;
+}
+
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+Status BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::AddAll(
+    const std::vector<ItemType> &keys, const size_t start, const size_t end) {
+  assert(start <= end && end <= keys.size());
+  const size_t size = end - start;
+  if (size > max_num_keys_) {
+    return NotEnoughSpace;
+  }
+
+  std::vector<uint64_t> hashes(size);
+  std::vector<uint64_t> order(size);
+  std::vector<uint8_t> order_slot(size);
+  size_t num_duplicates = 0;
+  int iterations = 0;
+  for (;;) {
+    // order doubles as scratch space until peeling
+    HashKeys(keys, start, end, order.data());
+    SortBySlot(order.data(), size, hashes.data());
+    if (Peel(hashes.data(), size, order.data(), order_slot.data(),
+             &num_duplicates)) {
+      break;
+    }
+    if (++iterations == kMaxIterations) {
+      throw std::runtime_error("BinaryFuseFilter failed to peel the key set");
+    }
+    hasher_ = HashFamily();
+  }
+
+  // Fill slots in reverse peeling order: each key's peeled slot is the last
+  // of its three to be written.
+  memset(fingerprints_, 0, SizeInBytes());
+  for (size_t i = size - num_duplicates; i-- > 0;) {
+    const uint64_t hash = order[i];
+    uint32_t h[3];
+    SlotHashes(hash, &h[0], &h[1], &h[2]);
+    const uint8_t found = order_slot[i];
+    fingerprints_[h[found]] = Fingerprint(hash) ^
+                              fingerprints_[h[(found + 1) % kArity]] ^
+                              fingerprints_[h[(found + 2) % kArity]];
+  }
+  num_items_ = size - num_duplicates;
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_fingerprint, typename HashFamily>
+std::string
+BinaryFuseFilter<ItemType, bits_per_fingerprint, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "BinaryFuseFilter Status:\n"
+     << "\t\tFingerprints: " << array_length_ << " x " << bits_per_fingerprint
+     << " bits in " << segment_count_ + kArity - 1 << " segments of "
+     << segment_length_ << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tHashtable size: " << (SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << 8.0 * SizeInBytes() / Size() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_BINARY_FUSE_FILTER_H_
@@ -0,0 +1,234 @@
+#ifndef CUCKOO_FILTER_BOUNDED_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_BOUNDED_CUCKOO_FILTER_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cuckoofilter.h"
+
+namespace cuckoofilter {
+
+// default bound on the tags waiting for a kick chain
+const size_t kDefaultMaxPending = 64;
+
+// kicks a background chain makes per hold of the lock
+const size_t kKicksPerStep = 16;
+
+// A cuckoo filter whose Add does not run kick chains. If neither bucket of
+// the tag has a free slot, the tag is parked in a bounded queue, and a
+// background thread moves it into the table with the usual kick chain, a
+// few kicks at a time. Contain and Delete also look at the parked tags, so
+// they are never missed. When the queue is full, Add waits for the thread to
+// free a slot.
+//
+// All methods take one lock, which the background thread holds for at most
+// kKicksPerStep kicks, so a single call waits for a short step rather than
+// a whole chain of up to kMaxCuckooCount kicks. Template parameters are
+// those of CuckooFilter.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTable,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type,
+          typename AltIndexPolicy = XorAltIndex,
+          typename StatsPolicy = NoStats>
+class BoundedCuckooFilter {
+  typedef CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                       AltIndexPolicy, StatsPolicy>
+      Filter;
+
+  // a tag carried by a kick chain, which is in neither of its buckets
+  struct ParkedTag {
+    size_t index;
+    uint32_t tag;
+    size_t kicks;
+  };
+
+  Filter filter_;
+
+  // ring buffer of parked tags, the oldest at head_; its chain is the one
+  // the background thread is working on
+  std::vector<ParkedTag> parked_;
+  size_t head_;
+  size_t num_parked_;
+
+  mutable std::mutex mutex_;
+  // signaled when a tag is parked, a victim freed, or on destruction
+  std::condition_variable work_;
+  // signaled when a parked tag is placed
+  std::condition_variable space_;
+  bool stop_;
+  std::thread worker_;
+
+  inline ParkedTag &Parked(const size_t k) {
+    return parked_[(head_ + k) % parked_.size()];
+  }
+
+  inline const ParkedTag &Parked(const size_t k) const {
+    return parked_[(head_ + k) % parked_.size()];
+  }
+
+  // Only the oldest chain goes on, so at most one tag can reach the victim
+  // cache; the others wait until Delete frees it.
+  bool HasWork() const { return num_parked_ > 0 && !filter_.victim_.used; }
+
+  void PopParked() {
+    head_ = (head_ + 1) % parked_.size();
+    num_parked_--;
+    space_.notify_all();
+  }
+
+  void Work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_.wait(lock, [this] { return stop_ || HasWork(); });
+      if (stop_) {
+        return;
+      }
+      ParkedTag &p = Parked(0);
+      const size_t steps = std::min(kKicksPerStep, kMaxCuckooCount - p.kicks);
+      if (filter_.AddWithKicks(&p.index, &p.tag, &p.kicks, steps)) {
+        PopParked();
+      } else if (p.kicks >= kMaxCuckooCount) {
+        filter_.StoreVictim(p.index, p.tag, p.kicks);
+        PopParked();
+      }
+      // let waiting calls in between steps
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+  }
+
+  // whether tag of bucket i1 or i2 is parked
+  bool FindParked(const size_t i1, const size_t i2, const uint32_t tag) const {
+    for (size_t k = 0; k < num_parked_; k++) {
+      const ParkedTag &p = Parked(k);
+      if (p.tag == tag && (p.index == i1 || p.index == i2)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ public:
+  explicit BoundedCuckooFilter(const size_t max_num_keys,
+                               const size_t max_pending = kDefaultMaxPending)
+      : filter_(max_num_keys),
+        parked_(std::max<size_t>(1, max_pending)),
+        head_(0),
+        num_parked_(0),
+        stop_(false) {
+    worker_ = std::thread(&BoundedCuckooFilter::Work, this);
+  }
+
+  BoundedCuckooFilter(const BoundedCuckooFilter &) = delete;
+  BoundedCuckooFilter &operator=(const BoundedCuckooFilter &) = delete;
+
+  // Parked tags are dropped.
+  ~BoundedCuckooFilter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_.notify_one();
+    worker_.join();
+  }
+
+  // Add an item to the filter without kicking out any tag. Waits while the
+  // queue of parked tags is full.
+  Status Add(const ItemType &item) { return AddHash(filter_.hasher_(item)); }
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const {
+    return ContainHash(filter_.hasher_(item));
+  }
+
+  // Delete an key from the filter
+  Status Delete(const ItemType &item) {
+    return DeleteHash(filter_.hasher_(item));
+  }
+
+  // Add, Contain and Delete of a uniform 64-bit hash, see CuckooFilter
+  Status AddHash(const uint64_t hash) {
+    size_t i;
+    uint32_t tag;
+    filter_.IndexTagFromHash(hash, &i, &tag);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (filter_.victim_.used) {
+      filter_.stats_.OnFailedAdd();
+      return NotEnoughSpace;
+    }
+    if (filter_.AddWithoutKicks(i, tag)) {
+      return Ok;
+    }
+    space_.wait(lock, [this] { return num_parked_ < parked_.size(); });
+    Parked(num_parked_++) = ParkedTag{i, tag, 0};
+    work_.notify_one();
+    return Ok;
+  }
+
+  Status ContainHash(const uint64_t hash) const {
+    size_t i1;
+    uint32_t tag;
+    filter_.IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = filter_.AltIndex(i1, tag);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Ok == filter_.ContainHash(hash) || FindParked(i1, i2, tag)) {
+      return Ok;
+    }
+    return NotFound;
+  }
+
+  Status DeleteHash(const uint64_t hash) {
+    size_t i1;
+    uint32_t tag;
+    filter_.IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = filter_.AltIndex(i1, tag);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Ok == filter_.DeleteHash(hash)) {
+      // may have freed the victim cache
+      work_.notify_one();
+      return Ok;
+    }
+    for (size_t k = 0; k < num_parked_; k++) {
+      ParkedTag &p = Parked(k);
+      if (p.tag == tag && (p.index == i1 || p.index == i2)) {
+        // the oldest parked tag takes its place
+        p = Parked(0);
+        PopParked();
+        return Ok;
+      }
+    }
+    return NotFound;
+  }
+
+  // Wait until no tag is parked, or until the rest cannot be placed as the
+  // victim cache is in use.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return !HasWork(); });
+  }
+
+  /* methods for providing stats  */
+  // number of tags waiting for a kick chain
+  size_t NumPending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_parked_;
+  }
+
+  // number of current inserted items, including parked ones
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return filter_.Size() + num_parked_;
+  }
+
+  size_t SizeInBytes() const { return filter_.SizeInBytes(); }
+
+  FilterStats Stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return filter_.Stats();
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_BOUNDED_CUCKOO_FILTER_H_
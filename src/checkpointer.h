@@ -0,0 +1,682 @@
+#ifndef CUCKOO_FILTER_CHECKPOINTER_H_
+#define CUCKOO_FILTER_CHECKPOINTER_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "dirtybitmap.h"
+
+namespace cuckoofilter {
+
+// Saves a CuckooFilter to a file, then only the regions of its table that
+// changed since, for long-lived filters too large to save whole each time.
+// The table tracks the kDirtyRegionBytes regions that writes change (see
+// DirtyBitmap); only SingleTable and PackedTable can.
+//
+// The file is a base image of the filter followed by a log of delta
+// records, each holding the regions that changed since the record before
+// it and a checksum. The first Checkpoint writes a new file next to path
+// and renames it over path once it is complete, so path always holds the
+// last complete checkpoint: the base is copied while writers run, after
+// all regions were marked clean, and the first delta record, which holds
+// every region written during the copy, makes it consistent. Each later
+// Checkpoint appends a delta record. Once the log outgrows compact_ratio
+// times the base, Compact writes the records into the base and truncates
+// the log; a crash meanwhile is harmless, as the records are applied again
+// on Restore.
+//
+// Writers of the filter must hold mutex, which Checkpoint only holds to
+// copy the dirty regions into a buffer of its own, so the pause is a
+// memcpy of the changed regions; the file is written after the mutex is
+// released. Checkpoint may be called directly, or every interval from a
+// background thread (see Start).
+template <typename Filter>
+class Checkpointer {
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().table_)>::type Table;
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().hasher_)>::type HashFamily;
+  static_assert(std::is_trivially_copyable<HashFamily>::value,
+                "the hash functions are saved as bytes");
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().alt_index_)>::type AltIndexPolicy;
+  static_assert(std::is_trivially_copyable<AltIndexPolicy>::value,
+                "the alternate index policy is saved as bytes");
+
+  static const uint64_t kMagic = 0x6375636b6f6f636bULL;        // "cuckoock"
+  static const uint64_t kRecordMagic = 0x6375636b6f6f646cULL;  // "cuckoodl"
+  static const uint32_t kVersion = 2;
+
+  // what a checkpoint saves besides the table
+  struct State {
+    uint64_t num_items;
+    uint64_t victim_index;
+    uint32_t victim_tag;
+    uint32_t victim_used;
+
+    bool operator==(const State &other) const {
+      return memcmp(this, &other, sizeof(State)) == 0;
+    }
+  };
+
+  // the start of the file; all sizes are in bytes
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t bits_per_tag;
+    uint64_t tags_per_bucket;
+    uint64_t num_buckets;
+    uint64_t storage_size;
+    uint64_t region_size;
+    uint64_t hasher_offset;
+    uint64_t hasher_size;
+    // e.g. the secret of KeyedAltIndex, after the hash functions
+    uint64_t alt_index_offset;
+    uint64_t alt_index_size;
+    uint64_t table_offset;
+    uint64_t log_offset;
+    // whether the table was copied while writers ran, and needs the first
+    // delta record to be consistent
+    uint64_t fuzzy;
+    State state;
+  };
+
+  // A delta record is this header, the indexes of its regions, padding to
+  // a region, and the regions. The checksum covers all of it from sequence
+  // on.
+  struct RecordHeader {
+    uint64_t magic;
+    uint64_t checksum;
+    uint64_t sequence;
+    uint64_t num_regions;
+    State state;
+  };
+
+  Filter &filter_;
+  std::mutex &mutex_;
+  std::string path_;
+  double compact_ratio_;
+
+  // the file, once the first Checkpoint wrote its base
+  int fd_;
+  uint64_t log_offset_;
+  uint64_t log_end_;
+  uint64_t sequence_;
+  State last_state_;
+  // serializes Checkpoint and Compact
+  std::mutex file_mutex_;
+  // the record being written, grown as needed
+  std::unique_ptr<char[]> record_;
+  size_t record_capacity_;
+
+  std::thread thread_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  // the first failure of the background thread
+  std::exception_ptr error_;
+
+  std::atomic<uint64_t> num_checkpoints_;
+  std::atomic<uint64_t> num_compactions_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> last_pause_nanos_;
+  std::atomic<uint64_t> max_pause_nanos_;
+  std::atomic<uint64_t> last_regions_;
+
+  static uint64_t AlignUp(const uint64_t x, const uint64_t align) {
+    return (x + align - 1) / align * align;
+  }
+
+  static uint64_t HasherOffset() { return AlignUp(sizeof(Header), 64); }
+
+  static uint64_t AltIndexOffset() {
+    return HasherOffset() + sizeof(HashFamily);
+  }
+
+  static uint64_t TableOffset() {
+    return AlignUp(AltIndexOffset() + sizeof(AltIndexPolicy),
+                   kDirtyRegionBytes);
+  }
+
+  static uint64_t RecordSize(const uint64_t num_regions) {
+    return AlignUp(sizeof(RecordHeader) + num_regions * sizeof(uint64_t),
+                   kDirtyRegionBytes) +
+           num_regions * kDirtyRegionBytes;
+  }
+
+  static uint64_t Checksum(const char *record, const uint64_t size) {
+    static const WyHash hasher(kRecordMagic);
+    const size_t skip = offsetof(RecordHeader, sequence);
+    return hasher(record + skip, size - skip);
+  }
+
+  [[noreturn]] static void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  static void WriteAll(const int fd, const char *data, const uint64_t size,
+                       const uint64_t offset) {
+    for (uint64_t done = 0; done < size;) {
+      const ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+      if (n < 0 && errno != EINTR) {
+        ThrowErrno("pwrite");
+      }
+      done += (n > 0) ? n : 0;
+    }
+  }
+
+  static void ReadAll(const int fd, char *data, const uint64_t size,
+                      const uint64_t offset) {
+    for (uint64_t done = 0; done < size;) {
+      const ssize_t n = pread(fd, data + done, size - done, offset + done);
+      if (n < 0 && errno != EINTR) {
+        ThrowErrno("pread");
+      }
+      if (n == 0) {
+        throw std::runtime_error("checkpoint truncated");
+      }
+      done += (n > 0) ? n : 0;
+    }
+  }
+
+  // the State of the filter; the caller holds mutex_
+  State CaptureState() const {
+    State state;
+    memset(&state, 0, sizeof(state));
+    state.num_items = filter_.num_items_;
+    state.victim_used = filter_.victim_.used;
+    if (filter_.victim_.used) {
+      state.victim_index = filter_.victim_.index;
+      state.victim_tag = filter_.victim_.tag;
+    }
+    return state;
+  }
+
+  static void ApplyState(const State &state, Filter *filter) {
+    filter->num_items_ = state.num_items;
+    filter->victim_.used = state.victim_used != 0;
+    filter->victim_.index = state.victim_index;
+    filter->victim_.tag = state.victim_tag;
+  }
+
+  size_t StorageSize() const {
+    return Table::StorageSize(filter_.table_.NumBuckets());
+  }
+
+  Header MakeHeader(const State &state, const bool fuzzy) const {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.bits_per_tag = TableBits<Table>::value;
+    header.tags_per_bucket = Table::kTagsPerBucket;
+    header.num_buckets = filter_.table_.NumBuckets();
+    header.storage_size = StorageSize();
+    header.region_size = kDirtyRegionBytes;
+    header.hasher_offset = HasherOffset();
+    header.hasher_size = sizeof(HashFamily);
+    header.alt_index_offset = AltIndexOffset();
+    header.alt_index_size = sizeof(AltIndexPolicy);
+    header.table_offset = TableOffset();
+    header.log_offset = log_offset_;
+    header.fuzzy = fuzzy;
+    header.state = state;
+    return header;
+  }
+
+  void Grow(const size_t size) {
+    if (size > record_capacity_) {
+      record_capacity_ = std::max(size, 2 * record_capacity_);
+      record_.reset(new char[record_capacity_]);
+    }
+  }
+
+  // Write a fuzzy base to a new file, and return its descriptor.
+  int WriteBase(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      ThrowErrno("open " + path);
+    }
+    try {
+      const size_t storage_size = StorageSize();
+      log_offset_ = TableOffset() + AlignUp(storage_size, kDirtyRegionBytes);
+      std::vector<char> head(TableOffset(), 0);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // regions written from now on go into the first delta record
+        std::vector<size_t> regions;
+        filter_.table_.TakeDirty(&regions);
+        memcpy(head.data() + HasherOffset(), &filter_.hasher_,
+               sizeof(HashFamily));
+        memcpy(head.data() + AltIndexOffset(), &filter_.alt_index_,
+               sizeof(AltIndexPolicy));
+      }
+      const Header header = MakeHeader(State(), true);
+      memcpy(head.data(), &header, sizeof(header));
+      WriteAll(fd, head.data(), head.size(), 0);
+      // copied while writers run, a region at a time
+      const char *storage = filter_.table_.Storage();
+      for (size_t done = 0; done < storage_size;) {
+        const size_t n =
+            std::min<size_t>(storage_size - done, 256 * kDirtyRegionBytes);
+        WriteAll(fd, storage + done, n, TableOffset() + done);
+        done += n;
+      }
+      if (ftruncate(fd, log_offset_) != 0) {
+        ThrowErrno("ftruncate " + path);
+      }
+      bytes_written_ += log_offset_;
+    } catch (...) {
+      close(fd);
+      unlink(path.c_str());
+      throw;
+    }
+    log_end_ = log_offset_;
+    sequence_ = 0;
+    return fd;
+  }
+
+  // Append a record of the regions written since the last one to fd, unless
+  // nothing changed and force is not set. Returns whether it did.
+  bool AppendDelta(const int fd, const bool force) {
+    std::vector<size_t> regions;
+    State state;
+    uint64_t size;
+    const auto start_time = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      filter_.table_.TakeDirty(&regions);
+      state = CaptureState();
+      if (regions.empty() && state == last_state_ && !force) {
+        return false;
+      }
+      size = RecordSize(regions.size());
+      Grow(size);
+      const char *storage = filter_.table_.Storage();
+      const size_t storage_size = StorageSize();
+      char *data = record_.get() + size - regions.size() * kDirtyRegionBytes;
+      for (size_t k = 0; k < regions.size(); k++) {
+        const size_t offset = regions[k] * kDirtyRegionBytes;
+        const size_t n = std::min(kDirtyRegionBytes, storage_size - offset);
+        memcpy(data + k * kDirtyRegionBytes, storage + offset, n);
+        memset(data + k * kDirtyRegionBytes + n, 0, kDirtyRegionBytes - n);
+      }
+    }
+    const uint64_t pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start_time)
+                               .count();
+    last_pause_nanos_ = pause;
+    if (pause > max_pause_nanos_) {
+      max_pause_nanos_ = pause;
+    }
+
+    char *record = record_.get();
+    const size_t index_bytes = size - regions.size() * kDirtyRegionBytes;
+    memset(record, 0, index_bytes);
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kRecordMagic;
+    header.sequence = ++sequence_;
+    header.num_regions = regions.size();
+    header.state = state;
+    memcpy(record, &header, sizeof(header));
+    for (size_t k = 0; k < regions.size(); k++) {
+      const uint64_t r = regions[k];
+      memcpy(record + sizeof(header) + k * sizeof(r), &r, sizeof(r));
+    }
+    header.checksum = Checksum(record, size);
+    memcpy(record, &header, sizeof(header));
+    WriteAll(fd, record, size, log_end_);
+    if (fdatasync(fd) != 0) {
+      ThrowErrno("fdatasync");
+    }
+    log_end_ += size;
+    last_state_ = state;
+    last_regions_ = regions.size();
+    bytes_written_ += size;
+    return true;
+  }
+
+  // Compact with file_mutex_ held.
+  void CompactLocked() {
+    if (fd_ < 0 || log_end_ == log_offset_) {
+      return;
+    }
+    State state = last_state_;
+    for (uint64_t offset = log_offset_; offset < log_end_;) {
+      RecordHeader header;
+      ReadAll(fd_, reinterpret_cast<char *>(&header), sizeof(header), offset);
+      const uint64_t size = RecordSize(header.num_regions);
+      Grow(size);
+      ReadAll(fd_, record_.get(), size, offset);
+      const char *data =
+          record_.get() + size - header.num_regions * kDirtyRegionBytes;
+      for (uint64_t k = 0; k < header.num_regions; k++) {
+        uint64_t r;
+        memcpy(&r, record_.get() + sizeof(header) + k * sizeof(r), sizeof(r));
+        WriteAll(fd_, data + k * kDirtyRegionBytes, kDirtyRegionBytes,
+                 TableOffset() + r * kDirtyRegionBytes);
+      }
+      state = header.state;
+      offset += size;
+    }
+    const Header header = MakeHeader(state, false);
+    WriteAll(fd_, reinterpret_cast<const char *>(&header), sizeof(header), 0);
+    if (fdatasync(fd_) != 0) {
+      ThrowErrno("fdatasync");
+    }
+    // the records are in the base now, so a crash before this is harmless
+    if (ftruncate(fd_, log_offset_) != 0 || fdatasync(fd_) != 0) {
+      ThrowErrno("ftruncate");
+    }
+    log_end_ = log_offset_;
+    num_compactions_++;
+  }
+
+  // Stop writing to the file after a failure, which leaves the last
+  // complete checkpoint in it, so that the next Checkpoint writes a new one.
+  void Abandon() {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  // fsync the directory of path, so that a rename in it is durable
+  static void SyncDirectory(const std::string &path) {
+    const size_t slash = path.rfind('/');
+    const std::string dir =
+        (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+      fsync(fd);
+      close(fd);
+    }
+  }
+
+ public:
+  // Checkpoint filter to path, whose writers hold mutex, and compact once
+  // the log is larger than compact_ratio times the base. Starts tracking
+  // the dirty regions of the table. Nothing is written before the first
+  // Checkpoint.
+  Checkpointer(Filter &filter, const std::string &path, std::mutex &mutex,
+               const double compact_ratio = 0.5)
+      : filter_(filter),
+        mutex_(mutex),
+        path_(path),
+        compact_ratio_(compact_ratio),
+        fd_(-1),
+        log_offset_(0),
+        log_end_(0),
+        sequence_(0),
+        record_capacity_(0),
+        stop_(false),
+        num_checkpoints_(0),
+        num_compactions_(0),
+        bytes_written_(0),
+        last_pause_nanos_(0),
+        max_pause_nanos_(0),
+        last_regions_(0) {
+    memset(&last_state_, 0, sizeof(last_state_));
+    std::lock_guard<std::mutex> lock(mutex_);
+    filter_.table_.TrackDirty();
+  }
+
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // Stops the background thread, ignoring its failures.
+  ~Checkpointer() {
+    try {
+      Stop();
+    } catch (...) {
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  // Save the filter: the whole of it to a new file the first time, and the
+  // regions changed since the last Checkpoint after that, compacting if the
+  // log grew too large. Returns once the checkpoint is durable. Throws
+  // std::system_error if the file cannot be written.
+  void Checkpoint() {
+    std::lock_guard<std::mutex> files(file_mutex_);
+    if (fd_ < 0) {
+      const std::string tmp = path_ + ".tmp";
+      const int fd = WriteBase(tmp);
+      try {
+        AppendDelta(fd, true);
+        if (rename(tmp.c_str(), path_.c_str()) != 0) {
+          ThrowErrno("rename " + tmp);
+        }
+      } catch (...) {
+        close(fd);
+        unlink(tmp.c_str());
+        throw;
+      }
+      SyncDirectory(path_);
+      fd_ = fd;
+    } else {
+      try {
+        AppendDelta(fd_, false);
+      } catch (...) {
+        // the regions of the lost record are clean now, so start over
+        Abandon();
+        throw;
+      }
+    }
+    num_checkpoints_++;
+    if (log_end_ - log_offset_ > compact_ratio_ * log_offset_) {
+      try {
+        CompactLocked();
+      } catch (...) {
+        Abandon();
+        throw;
+      }
+    }
+  }
+
+  // Fold the delta records into the base.
+  void Compact() {
+    std::lock_guard<std::mutex> files(file_mutex_);
+    try {
+      CompactLocked();
+    } catch (...) {
+      Abandon();
+      throw;
+    }
+  }
+
+  // Checkpoint every interval from a background thread, until Stop.
+  void Start(const std::chrono::milliseconds interval) {
+    Stop();
+    stop_ = false;
+    thread_ = std::thread([this, interval] {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      while (!wake_.wait_for(lock, interval, [this] { return stop_; })) {
+        lock.unlock();
+        try {
+          Checkpoint();
+        } catch (...) {
+          lock.lock();
+          error_ = std::current_exception();
+          return;
+        }
+        lock.lock();
+      }
+    });
+  }
+
+  // Stop the background thread, and rethrow its failure if it had one.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+  // Load the checkpoint at path into filter, whose table must have as many
+  // buckets as that of the filter saved, e.g. from the same max_num_keys:
+  // the base is mapped and copied into the table, and each complete delta
+  // record is applied to it in turn, up to the first torn or corrupt one.
+  // Throws std::system_error if path cannot be read, and
+  // std::runtime_error if it holds no complete checkpoint of such a filter.
+  static void Restore(const std::string &path, Filter *filter);
+
+  /* methods for providing stats  */
+  uint64_t NumCheckpoints() const { return num_checkpoints_; }
+  uint64_t NumCompactions() const { return num_compactions_; }
+  // bytes written to files, bases and records
+  uint64_t BytesWritten() const { return bytes_written_; }
+  // time the last, and the longest, Checkpoint held the writers' mutex
+  uint64_t LastPauseNanos() const { return last_pause_nanos_; }
+  uint64_t MaxPauseNanos() const { return max_pause_nanos_; }
+  // regions in the last delta record
+  uint64_t LastRegions() const { return last_regions_; }
+  // size of the base, and of the log after it
+  uint64_t BaseBytes() const { return log_offset_; }
+  uint64_t LogBytes() const { return log_end_ - log_offset_; }
+};
+
+template <typename Filter>
+void Checkpointer<Filter>::Restore(const std::string &path, Filter *filter) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ThrowErrno("open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    ThrowErrno("fstat " + path);
+  }
+  const uint64_t file_size = st.st_size;
+  void *p = (file_size >= sizeof(Header))
+                ? mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                : MAP_FAILED;
+  const int error = errno;
+  close(fd);
+  if (file_size < sizeof(Header)) {
+    throw std::runtime_error(path + " is not a checkpoint");
+  }
+  if (p == MAP_FAILED) {
+    errno = error;
+    ThrowErrno("mmap " + path);
+  }
+  std::unique_ptr<void, std::function<void(void *)>> mapping(
+      p, [file_size](void *q) { munmap(q, file_size); });
+  const char *base = static_cast<const char *>(p);
+  madvise(p, file_size, MADV_SEQUENTIAL);
+
+  Header header;
+  memcpy(&header, base, sizeof(header));
+  const size_t num_buckets = filter->table_.NumBuckets();
+  const size_t storage_size = Table::StorageSize(num_buckets);
+  const uint64_t num_regions = DirtyBitmap::NumRegions(storage_size);
+  if (header.magic != kMagic) {
+    throw std::runtime_error(path + " is not a checkpoint");
+  }
+  const char *mismatch =
+      header.version != kVersion ? "version"
+      : header.bits_per_tag != TableBits<Table>::value ? "tag size"
+      : header.tags_per_bucket != Table::kTagsPerBucket ? "tags per bucket"
+      : header.num_buckets != num_buckets ? "number of buckets"
+      : header.storage_size != storage_size ? "table type"
+      : header.hasher_offset != HasherOffset() ||
+              header.hasher_size != sizeof(HashFamily)
+          ? "hash family"
+      : header.alt_index_offset != AltIndexOffset() ||
+              header.alt_index_size != sizeof(AltIndexPolicy)
+          ? "alternate index policy"
+      : header.region_size != kDirtyRegionBytes ||
+              header.table_offset != TableOffset() ||
+              header.log_offset !=
+                  TableOffset() + AlignUp(storage_size, kDirtyRegionBytes) ||
+              file_size < header.log_offset
+          ? "layout"
+          : nullptr;
+  if (mismatch != nullptr) {
+    throw std::runtime_error(std::string("checkpoint: ") + mismatch +
+                             " differs");
+  }
+
+  memcpy(&filter->hasher_, base + HasherOffset(), sizeof(HashFamily));
+  memcpy(&filter->alt_index_, base + AltIndexOffset(),
+         sizeof(AltIndexPolicy));
+  char *storage = filter->table_.Storage();
+  memcpy(storage, base + TableOffset(), storage_size);
+  State state = header.state;
+  bool complete = !header.fuzzy;
+  for (uint64_t offset = header.log_offset;
+       offset + sizeof(RecordHeader) <= file_size;) {
+    RecordHeader record;
+    memcpy(&record, base + offset, sizeof(record));
+    if (record.magic != kRecordMagic || record.num_regions > num_regions) {
+      break;
+    }
+    const uint64_t size = RecordSize(record.num_regions);
+    if (offset + size > file_size ||
+        Checksum(base + offset, size) != record.checksum) {
+      break;
+    }
+    const char *data = base + offset + size -
+                       record.num_regions * kDirtyRegionBytes;
+    bool valid = true;
+    for (uint64_t k = 0; k < record.num_regions && valid; k++) {
+      uint64_t r;
+      memcpy(&r, base + offset + sizeof(record) + k * sizeof(r), sizeof(r));
+      valid = r < num_regions;
+      if (valid) {
+        memcpy(storage + r * kDirtyRegionBytes, data + k * kDirtyRegionBytes,
+               std::min(kDirtyRegionBytes,
+                        storage_size - r * kDirtyRegionBytes));
+      }
+    }
+    if (!valid) {
+      break;
+    }
+    state = record.state;
+    complete = true;
+    offset += size;
+  }
+  if (!complete) {
+    throw std::runtime_error("checkpoint: " + path + " is incomplete");
+  }
+  ApplyState(state, filter);
+}
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CHECKPOINTER_H_
@@ -2,13 +2,28 @@
 #define CUCKOO_FILTER_CUCKOO_FILTER_H_
 
 #include <assert.h>
+#include <string.h>
 #include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "altindex.h"
 #include "debug.h"
+#include "filterarena.h"
+#include "filterstats.h"
 #include "hashutil.h"
+#include "interleave.h"
+#include "mortontable.h"
 #include "packedtable.h"
 #include "printutil.h"
+#include "randutil.h"
 #include "singletable.h"
+#include "splittable.h"
+#include "valuetable.h"
 
 namespace cuckoofilter {
 // status returned by a cuckoo filter operation
@@ -22,19 +37,134 @@ enum Status {
 // maximum number of cuckoo kicks before claiming failure
 const size_t kMaxCuckooCount = 500;
 
+// maximum load factor a table is sized for when all keys are known up front
+const double kMaxOfflineLoad = 0.98;
+// number of builds with new hash functions before a table is doubled
+const size_t kMaxOfflineAttempts = 4;
+
+// number of times the offline constructor doubles a table before giving up
+const size_t kMaxOfflineDoublings = 1;
+
+// minimum number of buckets in each range of a parallel AddAll
+const size_t kMinParallelBuckets = 1 << 12;
+
+// number of items ContainBatch hashes and prefetches before probing any
+const size_t kContainBatchSize = 32;
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+class BoundedCuckooFilter;
+
+template <typename Filter>
+class Checkpointer;
+
+template <typename Filter>
+class FilterCodec;
+
+// the tag size of a table type, TableBits<SingleTable<12>>::value == 12
+template <typename Table>
+struct TableBits;
+
+template <template <size_t> class TableType, size_t bits_per_tag>
+struct TableBits<TableType<bits_per_tag>> {
+  static const size_t value = bits_per_tag;
+};
+
+// Whether the offline build can place tags into any free slot of either
+// bucket. MortonTable cannot: its buckets share the slots of a block, and a
+// lookup only reads the second bucket once the first has overflowed, so
+// its filters are built by Add instead.
+template <typename Table>
+struct PlacesTagsOffline {
+  static const bool value = true;
+};
+
+template <size_t bits_per_tag>
+struct PlacesTagsOffline<MortonTable<bits_per_tag>> {
+  static const bool value = false;
+};
+
+// The bucket and tag of a uniform 64-bit hash in a table of num_buckets
+// buckets, a power of two: the high half picks the bucket, and the low
+// bits_per_item bits are the tag, where 0, which marks empty slots, becomes 1.
+template <size_t bits_per_item>
+inline void IndexTagOfHash(const uint64_t hash, const size_t num_buckets,
+                           size_t *index, uint32_t *tag) {
+  *index = (uint32_t)(hash >> 32) & (num_buckets - 1);
+  *tag = hash & ((1ULL << bits_per_item) - 1);
+  *tag += (*tag == 0);
+}
+
+// The kick chain of an insert: put *tag into bucket *index of table if it
+// has a free slot, or else kick out one of its tags and carry that one on to
+// its alternate bucket, alt_index(bucket, tag), for up to kMaxCuckooCount
+// buckets. before_write(bucket) is called before each insert into a bucket.
+// Returns true once a tag is placed; otherwise *index and *tag are the tag
+// carried last, which is in neither of its buckets. Adds the number of tags
+// kicked out to *kicks.
+template <typename Table, typename AltIndexFunction,
+          typename BeforeWriteFunction>
+inline bool RunKickChain(Table *table, size_t *index, uint32_t *tag,
+                         size_t *kicks, WyRand *random,
+                         const AltIndexFunction &alt_index,
+                         const BeforeWriteFunction &before_write) {
+  size_t curindex = *index;
+  uint32_t curtag = *tag;
+  uint32_t oldtag;
+
+  // kicks only counts tags actually kicked out, as an insert with kickout
+  // may still find a free slot
+  for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
+    bool kickout = count > 0;
+    oldtag = 0;
+    before_write(curindex);
+    // NOTE: MortonTable may kick out a tag from another bucket than curindex
+    // and then updates curindex to that bucket
+    if (table->InsertTagToBucket(curindex, curtag, kickout, oldtag,
+                                 *random)) {
+      return true;
+    }
+    if (kickout) {
+      curtag = oldtag;
+      ++*kicks;
+    }
+    curindex = alt_index(curindex, curtag);
+  }
+  *index = curindex;
+  *tag = curtag;
+  return false;
+}
+
 // A cuckoo filter class exposes a Bloomier filter interface,
 // providing methods of Add, Delete, Contain. It takes three
 // template parameters:
 //   ItemType:  the type of item you want to insert
 //   bits_per_item: how many bits each item is hashed into
-//   TableType: the storage of table, SingleTable by default, and
-// PackedTable to enable semi-sorting
+//   TableType: the storage of table, SingleTable by default,
+// PackedTable to enable semi-sorting, MortonTable for compressed
+// cache-line blocks, SplitTable for 12-bit tags split into byte and
+// nibble planes, and ValueTableOf<bits_per_value>::Table to store a small
+// value with every item (see Add(item, value) and Lookup)
+//   HashFamily: the hash function applied to items, by default
+// multiply-shift for integer items and WyHash over the bytes of others
+// (see ItemBytes), or a SharedHash of one to share among many filters
+//   AltIndexPolicy: how to find the alternate bucket of a tag, XorAltIndex
+// by default, and VacuumAltIndex to keep most alternates in the same page
+//   StatsPolicy: NoStats by default, or ThreadStats to count operations,
+// kicks and where lookups hit (see Counters)
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType = SingleTable,
-          typename HashFamily = TwoIndependentMultiplyShift>
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type,
+          typename AltIndexPolicy = XorAltIndex,
+          typename StatsPolicy = NoStats>
 class CuckooFilter {
-  // Storage of items
-  TableType<bits_per_item> *table_;
+  // the bits of a tag; tags carry the value above them in a ValueTable
+  static const uint32_t kTagMask = (1ULL << bits_per_item) - 1;
+
+  // Storage of items, held by value so that lookups load the bucket array
+  // pointer straight from the filter
+  TableType<bits_per_item> table_;
 
   // Number of items stored
   size_t num_items_;
@@ -49,64 +179,354 @@ class CuckooFilter {
 
   HashFamily hasher_;
 
-  inline size_t IndexHash(uint32_t hv) const {
-    // table_->num_buckets is always a power of two, so modulo can be replaced
-    // with
-    // bitwise-and:
-    return hv & (table_->NumBuckets() - 1);
+  AltIndexPolicy alt_index_;
+
+  // picks the tags that kick chains kick out
+  WyRand random_;
+
+  // mutable, as lookups are counted too
+  mutable StatsPolicy stats_;
+
+  // number of buckets, a power of two, for max_num_keys at up to max_load
+  static size_t NumBucketsFor(const size_t max_num_keys,
+                              const double max_load) {
+    size_t assoc = TableType<bits_per_item>::kTagsPerBucket;
+    size_t num_buckets =
+        upperpower2(std::max<uint64_t>(1, max_num_keys / assoc));
+    double frac = (double)max_num_keys / num_buckets / assoc;
+    if (frac > max_load) {
+      num_buckets <<= 1;
+    }
+    return num_buckets;
   }
 
-  inline uint32_t TagHash(uint32_t hv) const {
-    uint32_t tag;
-    tag = hv & ((1ULL << bits_per_item) - 1);
-    tag += (tag == 0);
-    return tag;
+  inline void IndexTagFromHash(const uint64_t hash, size_t* index,
+                               uint32_t* tag) const {
+    IndexTagOfHash<bits_per_item>(hash, table_.NumBuckets(), index, tag);
   }
 
   inline void GenerateIndexTagHash(const ItemType& item, size_t* index,
                                    uint32_t* tag) const {
-    const uint64_t hash = hasher_(item);
-    *index = IndexHash(hash >> 32);
-    *tag = TagHash(hash);
+    IndexTagFromHash(hasher_(item), index, tag);
   }
 
   inline size_t AltIndex(const size_t index, const uint32_t tag) const {
-    // NOTE(binfan): originally we use:
-    // index ^ HashUtil::BobHash((const void*) (&tag), 4)) & table_->INDEXMASK;
-    // now doing a quick-n-dirty way:
-    // 0x5bd1e995 is the hash constant from MurmurHash2
-    return IndexHash((uint32_t)(index ^ (tag * 0x5bd1e995)));
+    return alt_index_(index, tag & kTagMask, table_.NumBuckets());
+  }
+
+  inline bool VictimMatches(const size_t i1, const size_t i2,
+                            const uint32_t tag) const {
+    return victim_.used && (tag == (victim_.tag & kTagMask)) &&
+           (i1 == victim_.index || i2 == victim_.index);
+  }
+
+  // kicks counts tags already kicked out by the chain that carries tag
+  Status AddImpl(const size_t i, const uint32_t tag, size_t kicks = 0);
+
+  // the lookup of ContainHash once the buckets are known, for ContainAwaiter
+  Status Probe(const size_t i1, const size_t i2, const uint32_t tag) const {
+    const bool found = VictimMatches(i1, i2, tag);
+    const bool hit = found || table_.FindTagInBuckets(i1, i2, tag);
+    if (StatsPolicy::kEnabled) {
+      CountLookup(i1, tag, found, hit);
+    }
+    return hit ? Ok : NotFound;
+  }
+
+  // count a lookup of tag in i1 and its alternate, only called if
+  // StatsPolicy::kEnabled, so that the extra probe costs nothing otherwise
+  void CountLookup(const size_t i1, const uint32_t tag, const bool victim_hit,
+                   const bool hit) const {
+    stats_.OnLookup(!hit         ? kLookupMiss
+                    : victim_hit ? kVictimHit
+                    : table_.FindTagInBucket(i1, tag) ? kFirstBucketHit
+                                                       : kSecondBucketHit);
+  }
+
+  // a tag to be inserted with AddImpl(index, tag), after kicks tags were
+  // kicked out by its chain so far
+  struct PendingTag {
+    uint32_t index;
+    uint32_t tag;
+    uint32_t kicks;
+  };
+
+  bool AddImplInRange(const size_t i, const uint32_t tag, size_t kicks,
+                      const bool kickout, const size_t begin,
+                      const size_t end, WyRand *random,
+                      std::vector<PendingTag> *pending);
+
+  // Insert tag into bucket i or its alternate if either has a free slot,
+  // without kicking out anything.
+  bool AddWithoutKicks(const size_t i, const uint32_t tag) {
+    size_t curindex = i;
+    uint32_t oldtag = 0;
+    if (table_.InsertTagToBucket(curindex, tag, false, oldtag, random_)) {
+      num_items_++;
+      stats_.OnAdd(0);
+      return true;
+    }
+    curindex = AltIndex(i, tag);
+    if (table_.InsertTagToBucket(curindex, tag, false, oldtag, random_)) {
+      num_items_++;
+      stats_.OnAdd(0);
+      return true;
+    }
+    return false;
+  }
+
+  // Run up to max_kicks steps of the kick chain of AddImpl for the tag
+  // carried in *index and *tag, starting by kicking out a tag of *index.
+  // Returns true once a tag is placed; otherwise *index and *tag are the tag
+  // now carried, which is in neither of its buckets. *kicks counts the kicks
+  // of the whole chain.
+  bool AddWithKicks(size_t *index, uint32_t *tag, size_t *kicks,
+                    const size_t max_kicks) {
+    size_t curindex = *index;
+    uint32_t curtag = *tag;
+    for (size_t k = 0; k < max_kicks; k++) {
+      uint32_t oldtag = 0;
+      if (table_.InsertTagToBucket(curindex, curtag, true, oldtag,
+                                   random_)) {
+        num_items_++;
+        stats_.OnAdd(*kicks);
+        return true;
+      }
+      curtag = oldtag;
+      curindex = AltIndex(curindex, curtag);
+      ++*kicks;
+    }
+    *index = curindex;
+    *tag = curtag;
+    return false;
+  }
+
+  // where AddImpl leaves the tag of a chain that ran too long, after kicks
+  // kicks
+  void StoreVictim(const size_t index, const uint32_t tag,
+                   const size_t kicks) {
+    victim_.index = index;
+    victim_.tag = tag;
+    victim_.used = true;
+    stats_.OnAdd(kicks);
+    stats_.OnVictimStore();
   }
 
-  Status AddImpl(const size_t i, const uint32_t tag);
+  // BoundedCuckooFilter drives the filter through the private methods above
+  friend class BoundedCuckooFilter<ItemType, bits_per_item, TableType,
+                                   HashFamily, AltIndexPolicy, StatsPolicy>;
+  // Checkpointer saves and restores the table, the hash functions, the
+  // alternate index policy and the victim
+  template <typename Filter>
+  friend class Checkpointer;
+  // FilterCodec encodes them for transfer
+  template <typename Filter>
+  friend class FilterCodec;
+
+  bool BuildFromKeys(const std::vector<ItemType> &keys, const size_t start,
+                     const size_t end);
 
   // load factor is the fraction of occupancy
-  double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
+  double LoadFactor() const { return 1.0 * Size() / table_.SizeInTags(); }
 
-  double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
+  double BitsPerItem() const { return 8.0 * table_.SizeInBytes() / Size(); }
 
  public:
-  explicit CuckooFilter(const size_t max_num_keys) : num_items_(0), victim_(), hasher_() {
-    size_t assoc = 4;
-    size_t num_buckets = upperpower2(std::max<uint64_t>(1, max_num_keys / assoc));
-    double frac = (double)max_num_keys / num_buckets / assoc;
-    if (frac > 0.96) {
-      num_buckets <<= 1;
-    }
+  explicit CuckooFilter(const size_t max_num_keys)
+      : table_(NumBucketsFor(max_num_keys, 0.96)),
+        num_items_(0),
+        victim_(),
+        hasher_(),
+        alt_index_(),
+        random_(),
+        stats_() {
+    victim_.used = false;
+  }
+
+  // A filter whose table is allocated from arena, for one of many small
+  // filters. With a SharedHash of the arena for hasher, the filter itself
+  // can be placed in the arena too, as arena.New<CuckooFilter>(max_num_keys,
+  // arena, hasher), and all its memory is freed with the arena. Only
+  // SingleTable and PackedTable take an arena, and ThreadStats keeps its
+  // counters on the heap, so it must not be used for filters made by New.
+  CuckooFilter(const size_t max_num_keys, FilterArena &arena,
+               const HashFamily &hasher = HashFamily())
+      : table_(NumBucketsFor(max_num_keys, 0.96), &arena),
+        num_items_(0),
+        victim_(),
+        hasher_(hasher),
+        alt_index_(),
+        random_(arena.NewSeed()),
+        stats_() {
+    victim_.used = false;
+  }
+
+  // Build a filter holding keys[start, end), placing all of them at once
+  // instead of one random walk per key. The table is sized for up to
+  // kMaxOfflineLoad. In the unlikely case that the keys do not fit, the
+  // build is retried with new hash functions and alternate index policy, and
+  // the table is doubled after a few failures, or at once if HashFamily is
+  // not seeded (e.g. IdentityHash). Copies of a key beyond those its two
+  // buckets and the victim cache hold are dropped, as Add would fail for
+  // them, except with MortonTable, whose filters are filled by Add. Throws
+  // std::runtime_error if the keys do not fit after kMaxOfflineDoublings.
+  // The result is a normal filter that supports Add and Delete.
+  CuckooFilter(const std::vector<ItemType> &keys, const size_t start,
+               const size_t end)
+      : table_(NumBucketsFor(end - start, kMaxOfflineLoad)),
+        num_items_(0),
+        victim_(),
+        hasher_(),
+        alt_index_(),
+        random_(),
+        stats_() {
+    static_assert(std::is_default_constructible<HashFamily>::value,
+                  "the offline build draws new hash functions on retries");
+    assert(start <= end && end <= keys.size());
     victim_.used = false;
-    table_ = new TableType<bits_per_item>(num_buckets);
+    size_t num_buckets = table_.NumBuckets();
+    size_t doublings = 0;
+    for (size_t attempt = 1; !BuildFromKeys(keys, start, end); attempt++) {
+      const HashFamily old_hasher = hasher_;
+      hasher_ = HashFamily();
+      alt_index_ = AltIndexPolicy();
+      const bool reseeded =
+          !std::is_trivially_copyable<HashFamily>::value ||
+          memcmp(&old_hasher, &hasher_, sizeof(HashFamily)) != 0;
+      if (!reseeded || attempt % kMaxOfflineAttempts == 0) {
+        if (doublings++ == kMaxOfflineDoublings) {
+          throw std::runtime_error("CuckooFilter: the keys do not fit");
+        }
+        num_buckets <<= 1;
+      }
+      table_ = TableType<bits_per_item>(num_buckets);
+      num_items_ = 0;
+      victim_.used = false;
+    }
+  }
+
+  explicit CuckooFilter(const std::vector<ItemType> &keys)
+      : CuckooFilter(keys, 0, keys.size()) {}
+
+  // A moved-from filter may only be assigned to or destroyed.
+  CuckooFilter(CuckooFilter &&other) noexcept
+      : table_(std::move(other.table_)),
+        num_items_(other.num_items_),
+        victim_(other.victim_),
+        hasher_(std::move(other.hasher_)),
+        alt_index_(std::move(other.alt_index_)),
+        random_(other.random_),
+        stats_(std::move(other.stats_)) {
+    other.num_items_ = 0;
+    other.victim_.used = false;
+  }
+
+  CuckooFilter &operator=(CuckooFilter &&other) noexcept {
+    if (this != &other) {
+      table_ = std::move(other.table_);
+      num_items_ = other.num_items_;
+      victim_ = other.victim_;
+      hasher_ = std::move(other.hasher_);
+      alt_index_ = std::move(other.alt_index_);
+      random_ = other.random_;
+      stats_ = std::move(other.stats_);
+      other.num_items_ = 0;
+      other.victim_.used = false;
+    }
+    return *this;
   }
 
-  ~CuckooFilter() { delete table_; }
+  CuckooFilter(const CuckooFilter &) = delete;
+  CuckooFilter &operator=(const CuckooFilter &) = delete;
+
+  // Remove all items, keeping the table's memory and the hash functions, to
+  // reuse the filter for a new set of keys.
+  void Clear() {
+    table_.Clear();
+    num_items_ = 0;
+    victim_.used = false;
+  }
 
   // Add an item to the filter.
-  Status Add(const ItemType &item);
+  Status Add(const ItemType &item) { return AddHash(hasher_(item)); }
+
+  // Seed the choice of tags to kick out, which is otherwise random, so that
+  // adding the same hashes in the same order always gives the same table.
+  void SeedKicks(const uint64_t seed) { random_ = WyRand(seed); }
+
+  // Add keys[start, end) with up to num_threads threads, for bulk loading a
+  // filter. Returns NotEnoughSpace if some keys did not fit.
+  Status AddAll(const std::vector<ItemType> &keys, const size_t start,
+                const size_t end, size_t num_threads);
 
   // Report if the item is inserted, with false positive rate.
-  Status Contain(const ItemType &item) const;
+  Status Contain(const ItemType &item) const {
+    return ContainHash(hasher_(item));
+  }
+
+  // Report if each of items[0, n) is inserted, like Contain. The items are
+  // hashed a block at a time, and all buckets of a block are prefetched
+  // before any is probed, so the cache misses overlap.
+  void ContainBatch(const ItemType *items, const size_t n,
+                    Status *results) const;
 
   // Delete an key from the filter
-  Status Delete(const ItemType &item);
+  Status Delete(const ItemType &item) { return DeleteHash(hasher_(item)); }
+
+  // Add, look up and overwrite the value stored with an item, in the spirit
+  // of a Bloomier filter, only for filters over ValueTableOf<n>::Table. The
+  // value moves with its tag during kicks, and a key that was never added
+  // may find the value of a colliding key with the false positive rate of
+  // Contain. Adding an item twice stores it twice, and Update changes the
+  // value of one copy.
+  Status Add(const ItemType &item, const uint32_t value);
+  Status Lookup(const ItemType &item, uint32_t *value) const;
+  Status Update(const ItemType &item, const uint32_t value);
+
+  // Add, Contain and Delete for callers that already hold a uniform 64-bit
+  // hash of each key, which is used in place of HashFamily's. A filter
+  // should get all of its keys either this way or as items.
+  Status AddHash(const uint64_t hash);
+  Status ContainHash(const uint64_t hash) const;
+  Status DeleteHash(const uint64_t hash);
+  // ContainBatch for hashes
+  void ContainHashBatch(const uint64_t *hashes, const size_t n,
+                        Status *results) const;
+
+#ifdef CUCKOO_FILTER_COROUTINES
+  // The result of ContainAsync: co_await gives the Status of Contain.
+  class ContainAwaiter {
+    const CuckooFilter *filter_;
+    size_t i1_, i2_;
+    uint32_t tag_;
+
+   public:
+    ContainAwaiter(const CuckooFilter *filter, const size_t i1,
+                   const size_t i2, const uint32_t tag)
+        : filter_(filter), i1_(i1), i2_(i2), tag_(tag) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    Status await_resume() const { return filter_->Probe(i1_, i2_, tag_); }
+  };
+
+  // Contain for a LookupTask: prefetches both buckets of the item, and the
+  // co_await suspends the task until its scheduler resumes it to probe them
+  // (see interleave.h). Only with C++20.
+  ContainAwaiter ContainAsync(const ItemType &item) const {
+    return ContainHashAsync(hasher_(item));
+  }
+
+  ContainAwaiter ContainHashAsync(const uint64_t hash) const {
+    size_t i1;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = AltIndex(i1, tag);
+    table_.PrefetchBucket(i1);
+    table_.PrefetchBucket(i2);
+    return ContainAwaiter(this, i1, i2, tag);
+  }
+#endif
 
   /* methods for providing stats  */
   // summary infomation
@@ -116,99 +536,627 @@ class CuckooFilter {
   size_t Size() const { return num_items_; }
 
   // size of the filter in bytes.
-  size_t SizeInBytes() const { return table_->SizeInBytes(); }
+  size_t SizeInBytes() const { return table_.SizeInBytes(); }
+
+  // operation counters of all threads since construction or the last
+  // ResetCounters(), all zero with the default NoStats policy
+  FilterCounters Counters() const { return stats_.Snapshot(); }
+
+  void ResetCounters() { stats_.Reset(); }
+
+  // state of the table, from a scan of all buckets that takes a few
+  // milliseconds per million buckets, and the operation counters
+  FilterStats Stats() const;
 };
 
 template <typename ItemType, size_t bits_per_item,
-          template <size_t> class TableType, typename HashFamily>
-Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Add(
-    const ItemType &item) {
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::AddHash(const uint64_t hash) {
   size_t i;
   uint32_t tag;
 
   if (victim_.used) {
+    stats_.OnFailedAdd();
     return NotEnoughSpace;
   }
 
-  GenerateIndexTagHash(item, &i, &tag);
+  IndexTagFromHash(hash, &i, &tag);
   return AddImpl(i, tag);
 }
 
 template <typename ItemType, size_t bits_per_item,
-          template <size_t> class TableType, typename HashFamily>
-Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddImpl(
-    const size_t i, const uint32_t tag) {
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::Add(const ItemType &item,
+                                      const uint32_t value) {
+  size_t i;
+  uint32_t tag;
+
+  if (victim_.used) {
+    stats_.OnFailedAdd();
+    return NotEnoughSpace;
+  }
+
+  GenerateIndexTagHash(item, &i, &tag);
+  return AddImpl(i, table_.TagWithValue(tag, value));
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::Lookup(const ItemType &item,
+                                         uint32_t *value) const {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(item, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  const bool found = VictimMatches(i1, i2, tag);
+  if (found) {
+    *value = victim_.tag >> bits_per_item;
+  }
+  const bool hit = found || table_.FindTagInBuckets(i1, i2, tag, value);
+  if (StatsPolicy::kEnabled) {
+    CountLookup(i1, tag, found, hit);
+  }
+  return hit ? Ok : NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::Update(const ItemType &item,
+                                         const uint32_t value) {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(item, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  if (VictimMatches(i1, i2, tag)) {
+    victim_.tag = table_.TagWithValue(tag, value);
+    return Ok;
+  }
+  if (table_.UpdateTagInBucket(i1, tag, value) ||
+      table_.UpdateTagInBucket(i2, tag, value)) {
+    return Ok;
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::AddImpl(const size_t i, const uint32_t tag,
+                                          size_t kicks) {
+  size_t curindex = i;
+  uint32_t curtag = tag;
+
+  if (RunKickChain(&table_, &curindex, &curtag, &kicks, &random_,
+                   [this](const size_t index, const uint32_t t) {
+                     return AltIndex(index, t);
+                   },
+                   [](size_t) {})) {
+    num_items_++;
+    stats_.OnAdd(kicks);
+    return Ok;
+  }
+
+  victim_.index = curindex;
+  victim_.tag = curtag;
+  victim_.used = true;
+  stats_.OnAdd(kicks);
+  stats_.OnVictimStore();
+  return Ok;
+}
+
+// Same kick chain as AddImpl, restricted to buckets in [begin, end). When the
+// chain would move on to a bucket outside the range, or runs too long, the
+// tag it carries is appended to pending instead, and false is returned.
+// kickout continues such a chain, which kicks out a tag from i if full, and
+// kicks counts the tags the chain has kicked out so far. random is the
+// generator of the calling thread.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+bool CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                  AltIndexPolicy,
+                  StatsPolicy>::AddImplInRange(const size_t i,
+                                               const uint32_t tag,
+                                               size_t kicks,
+                                               const bool kickout,
+                                               const size_t begin,
+                                               const size_t end,
+                                               WyRand *random,
+                                               std::vector<PendingTag>
+                                                   *pending) {
   size_t curindex = i;
   uint32_t curtag = tag;
   uint32_t oldtag;
 
-  for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
-    bool kickout = count > 0;
+  for (uint32_t count = kickout ? 1 : 0; count < kMaxCuckooCount; count++) {
+    bool kick = count > 0;
     oldtag = 0;
-    if (table_->InsertTagToBucket(curindex, curtag, kickout, oldtag)) {
-      num_items_++;
-      return Ok;
+    if (table_.InsertTagToBucket(curindex, curtag, kick, oldtag, *random)) {
+      stats_.OnAdd(kicks);
+      return true;
     }
-    if (kickout) {
+    if (kick) {
       curtag = oldtag;
+      kicks++;
     }
     curindex = AltIndex(curindex, curtag);
+    if (curindex < begin || curindex >= end) {
+      break;
+    }
   }
+  pending->push_back(
+      PendingTag{(uint32_t)curindex, curtag, (uint32_t)kicks});
+  return false;
+}
 
-  victim_.index = curindex;
-  victim_.tag = curtag;
-  victim_.used = true;
+// The table is cut into 2 * num_threads ranges of buckets, and each thread
+// inserts the keys whose first bucket is in one range: first all threads
+// work on even ranges, then on odd ones. Tables may rewrite a few bytes or a
+// block past a bucket, so neighboring ranges are never worked on at the same
+// time. The tags whose kick chains leave their range go through more such
+// rounds, redistributed by the bucket they are headed to, while rounds make
+// progress; the rest are inserted serially.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::AddAll(const std::vector<ItemType> &keys,
+                                         const size_t start,
+                                         const size_t end,
+                                         size_t num_threads) {
+  assert(start <= end && end <= keys.size());
+  const size_t num_buckets = table_.NumBuckets();
+  num_threads = std::min(num_threads, num_buckets / (2 * kMinParallelBuckets));
+  if (num_threads <= 1) {
+    for (size_t k = start; k < end; k++) {
+      if (Add(keys[k]) != Ok) {
+        return NotEnoughSpace;
+      }
+    }
+    return Ok;
+  }
+  if (victim_.used) {
+    return NotEnoughSpace;
+  }
+  assert(num_buckets <= UINT32_MAX);
+  const size_t num_ranges = 2 * num_threads;
+  const size_t range_size = (num_buckets + num_ranges - 1) / num_ranges;
+  auto parallel = [num_threads](const std::function<void(size_t)> &work) {
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+      threads.emplace_back(work, t);
+    }
+    work(0);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  };
+
+  // by_range[t * num_ranges + r] are the tags hashed by thread t whose first
+  // bucket is in range r
+  std::vector<std::vector<PendingTag>> by_range(num_threads * num_ranges);
+  const size_t chunk = (end - start + num_threads - 1) / num_threads;
+  parallel([&](const size_t t) {
+    const size_t from = std::min(end, start + t * chunk);
+    const size_t to = std::min(end, from + chunk);
+    size_t i;
+    uint32_t tag;
+    for (size_t k = from; k < to; k++) {
+      GenerateIndexTagHash(keys[k], &i, &tag);
+      by_range[t * num_ranges + i / range_size].push_back(
+          PendingTag{(uint32_t)i, tag, 0});
+    }
+  });
+
+  std::vector<size_t> added(num_threads, 0);
+  std::vector<std::vector<PendingTag>> pending(num_threads);
+  // one generator per thread, seeded from the filter's
+  std::vector<WyRand> randoms;
+  for (size_t t = 0; t < num_threads; t++) {
+    randoms.push_back(WyRand(random_()));
+  }
+  size_t num_pending = end - start;
+  for (bool kickout = false;; kickout = true) {
+    for (size_t parity = 0; parity < 2; parity++) {
+      parallel([&](const size_t t) {
+        const size_t r = 2 * t + parity;
+        const size_t begin = r * range_size;
+        const size_t range_end = std::min(num_buckets, begin + range_size);
+        for (size_t h = 0; h < num_threads; h++) {
+          std::vector<PendingTag> &tags = by_range[h * num_ranges + r];
+          for (const PendingTag &p : tags) {
+            added[t] += AddImplInRange(p.index, p.tag, p.kicks, kickout,
+                                       begin, range_end, &randoms[t],
+                                       &pending[t]);
+          }
+          std::vector<PendingTag>().swap(tags);
+        }
+      });
+    }
+    // Another round for the tags whose chains left their range, unless few
+    // are left or the last round placed few of them.
+    const size_t last_pending = num_pending;
+    num_pending = 0;
+    for (const auto &tags : pending) {
+      num_pending += tags.size();
+    }
+    if (num_pending < (end - start) / 64 ||
+        num_pending > last_pending - last_pending / 8) {
+      break;
+    }
+    parallel([&](const size_t t) {
+      for (const PendingTag &p : pending[t]) {
+        by_range[t * num_ranges + p.index / range_size].push_back(p);
+      }
+      pending[t].clear();
+    });
+  }
+  for (size_t t = 0; t < num_threads; t++) {
+    num_items_ += added[t];
+  }
+
+  for (const auto &tags : pending) {
+    for (const PendingTag &p : tags) {
+      if (victim_.used) {
+        return NotEnoughSpace;
+      }
+      AddImpl(p.index, p.tag, p.kicks);
+    }
+  }
   return Ok;
 }
 
+// Offline placement treats keys as edges between their two buckets and
+// assigns each edge to one of its ends, with at most kTagsPerBucket edges per
+// bucket:
+//   1. counting sort the tags of keys into per-bucket lists;
+//   2. peel: a bucket with no more unassigned tags than free slots takes
+//      all of them, which may enable its neighbors in turn;
+//   3. when peeling gets stuck, place one tag into its less contended
+//      bucket, and go on peeling;
+//   4. place the tags left over along BFS augmenting paths of moves.
+// A tag and one of its buckets give its other bucket, so keys are only
+// hashed to build the lists. Keys with the same tag and buckets are
+// interchangeable, so a tag placed from one list is found again in the
+// other list by value. A key that still cannot be placed goes to the victim
+// cache. A second one is dropped if both of its buckets are full of copies
+// of its tag, as many copies of one key make, and makes the build fail
+// otherwise.
 template <typename ItemType, size_t bits_per_item,
-          template <size_t> class TableType, typename HashFamily>
-Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Contain(
-    const ItemType &key) const {
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+bool CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                  AltIndexPolicy,
+                  StatsPolicy>::BuildFromKeys(const std::vector<ItemType> &keys,
+                                              const size_t start,
+                                              const size_t end) {
+  if (!PlacesTagsOffline<TableType<bits_per_item>>::value) {
+    for (size_t k = start; k < end; k++) {
+      if (Add(keys[k]) != Ok) {
+        return false;
+      }
+    }
+    return true;
+  }
+  const size_t assoc = TableType<bits_per_item>::kTagsPerBucket;
+  const size_t num_buckets = table_.NumBuckets();
+  const uint32_t kNone = UINT32_MAX;
+  assert(end - start < kNone / 2 && num_buckets < kNone);
+  size_t i1, i2;
+  uint32_t tag;
+
+  // Everything the build needs to know about a bucket, kept together so
+  // that visiting a bucket costs one cache miss.
+  struct BuildBucket {
+    // lists[offset, next bucket's offset) are the tags of keys in this
+    // bucket, or 0 once dropped
+    uint32_t offset;
+    // number of tags in the list not dropped yet
+    uint32_t remaining;
+    // slots[0, used) are the tags placed in this bucket
+    uint32_t used;
+    uint32_t slots[TableType<bits_per_item>::kTagsPerBucket];
+  };
+  std::vector<BuildBucket> buckets(num_buckets + 1, BuildBucket());
+
+  // 1. counting sort of tags by bucket
+  for (size_t k = start; k < end; k++) {
+    GenerateIndexTagHash(keys[k], &i1, &tag);
+    i2 = AltIndex(i1, tag);
+    buckets[i1 + 1].offset++;
+    buckets[i2 + 1].offset += (i2 != i1);
+  }
+  for (size_t b = 0; b < num_buckets; b++) {
+    buckets[b + 1].offset += buckets[b].offset;
+  }
+  std::vector<uint32_t> lists(buckets[num_buckets].offset);
+  for (size_t k = start; k < end; k++) {
+    GenerateIndexTagHash(keys[k], &i1, &tag);
+    i2 = AltIndex(i1, tag);
+    lists[buckets[i1].offset + buckets[i1].remaining++] = tag;
+    if (i2 != i1) {
+      lists[buckets[i2].offset + buckets[i2].remaining++] = tag;
+    }
+  }
+
+  std::vector<uint32_t> queue;
+  auto push_if_peelable = [&](const size_t b) {
+    if (buckets[b].remaining > 0 &&
+        buckets[b].remaining <= assoc - buckets[b].used) {
+      queue.push_back(b);
+    }
+  };
+  // Drop the k-th list entry, a tag of bucket b, from the lists of both
+  // of its buckets.
+  auto drop = [&](const size_t b, const size_t k) {
+    const uint32_t t = lists[k];
+    const size_t other = AltIndex(b, t);
+    lists[k] = 0;
+    buckets[b].remaining--;
+    if (other != b) {
+      size_t twin = buckets[other].offset;
+      while (lists[twin] != t) {
+        twin++;
+      }
+      lists[twin] = 0;
+      buckets[other].remaining--;
+      push_if_peelable(other);
+    }
+    push_if_peelable(b);
+  };
+  // Place the k-th list entry into bucket to, which is b or its other bucket
+  auto place = [&](const size_t b, const size_t k, const size_t to) {
+    buckets[to].slots[buckets[to].used++] = lists[k];
+    drop(b, k);
+  };
+  auto peel = [&]() {
+    while (!queue.empty()) {
+      const size_t b = queue.back();
+      queue.pop_back();
+      if (buckets[b].remaining == 0 ||
+          buckets[b].remaining > assoc - buckets[b].used) {
+        continue;
+      }
+      for (size_t k = buckets[b].offset; k < buckets[b + 1].offset; k++) {
+        if (lists[k] != 0) {
+          place(b, k, b);
+        }
+      }
+    }
+  };
+
+  // 2. and 3.
+  for (size_t b = 0; b < num_buckets; b++) {
+    push_if_peelable(b);
+  }
+  peel();
+  std::vector<std::pair<uint32_t, uint32_t>> unplaced;
+  for (size_t b = 0; b < num_buckets; b++) {
+    for (size_t k = buckets[b].offset; k < buckets[b + 1].offset; k++) {
+      if (lists[k] == 0) {
+        continue;
+      }
+      // prefer the bucket with more free slots left over for its other tags
+      const size_t other = AltIndex(b, lists[k]);
+      const long slack = (long)(assoc - buckets[b].used) - buckets[b].remaining;
+      const long other_slack =
+          (long)(assoc - buckets[other].used) - buckets[other].remaining;
+      size_t to = (slack >= other_slack) ? b : other;
+      if (buckets[to].used == assoc) {
+        to = (to == b) ? other : b;
+      }
+      if (buckets[to].used == assoc) {
+        unplaced.push_back(std::make_pair(b, lists[k]));
+        drop(b, k);
+        continue;
+      }
+      place(b, k, to);
+      peel();
+    }
+  }
+  std::vector<uint32_t>().swap(lists);
+
+  // 4. augmenting paths: BFS over buckets from both buckets of a tag, where
+  // an edge b -> b' moves the tag in one slot of b to its other bucket b'.
+  // Once a bucket with a free slot is reached, shift the tags along the
+  // path backwards and put the new tag into the slot freed in its own
+  // bucket.
+  std::vector<uint32_t> stamp(num_buckets, 0);
+  std::vector<uint32_t> parent(num_buckets);
+  std::vector<uint8_t> parent_slot(num_buckets);
+  std::vector<uint32_t> bfs;
+  uint32_t round = 0;
+  for (const auto &u : unplaced) {
+    round++;
+    bfs.clear();
+    i1 = u.first;
+    tag = u.second;
+    i2 = AltIndex(i1, tag);
+    for (const size_t s : {i1, i2}) {
+      if (stamp[s] != round) {
+        stamp[s] = round;
+        parent[s] = kNone;
+        bfs.push_back(s);
+      }
+    }
+    bool found = false;
+    for (size_t head = 0; head < bfs.size() && !found; head++) {
+      const size_t b = bfs[head];
+      for (size_t j = 0; j < assoc && !found; j++) {
+        const size_t other = AltIndex(b, buckets[b].slots[j]);
+        if (stamp[other] == round) {
+          continue;
+        }
+        stamp[other] = round;
+        parent[other] = b;
+        parent_slot[other] = j;
+        if (buckets[other].used == assoc) {
+          bfs.push_back(other);
+          continue;
+        }
+        size_t to = other;
+        size_t to_slot = buckets[other].used++;
+        while (parent[to] != kNone) {
+          const size_t from = parent[to];
+          buckets[to].slots[to_slot] = buckets[from].slots[parent_slot[to]];
+          to_slot = parent_slot[to];
+          to = from;
+        }
+        buckets[to].slots[to_slot] = tag;
+        found = true;
+      }
+    }
+    if (!found && !victim_.used) {
+      victim_.index = i1;
+      victim_.tag = tag;
+      victim_.used = true;
+    } else if (!found) {
+      size_t copies = 0;
+      for (const size_t s : {i1, i2}) {
+        for (size_t j = 0; j < buckets[s].used; j++) {
+          copies += buckets[s].slots[j] == tag;
+        }
+      }
+      if (copies < 2 * assoc) {
+        return false;
+      }
+    }
+  }
+
+  for (size_t b = 0; b < num_buckets; b++) {
+    for (size_t j = 0; j < buckets[b].used; j++) {
+      size_t i = b;
+      uint32_t oldtag;
+      table_.InsertTagToBucket(i, buckets[b].slots[j], false, oldtag,
+                               random_);
+      num_items_++;
+    }
+  }
+  return true;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::ContainHash(const uint64_t hash) const {
   bool found = false;
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
   assert(i1 == AltIndex(i2, tag));
 
-  found = victim_.used && (tag == victim_.tag) &&
-          (i1 == victim_.index || i2 == victim_.index);
+  found = VictimMatches(i1, i2, tag);
 
-  if (found || table_->FindTagInBuckets(i1, i2, tag)) {
-    return Ok;
-  } else {
-    return NotFound;
+  const bool hit = found || table_.FindTagInBuckets(i1, i2, tag);
+  if (StatsPolicy::kEnabled) {
+    CountLookup(i1, tag, found, hit);
   }
+  return hit ? Ok : NotFound;
 }
 
 template <typename ItemType, size_t bits_per_item,
-          template <size_t> class TableType, typename HashFamily>
-Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Delete(
-    const ItemType &key) {
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+void CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                  AltIndexPolicy,
+                  StatsPolicy>::ContainBatch(const ItemType *items,
+                                             const size_t n,
+                                             Status *results) const {
+  uint64_t hashes[kContainBatchSize];
+  for (size_t start = 0; start < n; start += kContainBatchSize) {
+    const size_t count = std::min(kContainBatchSize, n - start);
+    HashItems(hasher_, items + start, count, hashes);
+    ContainHashBatch(hashes, count, results + start);
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+void CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                  AltIndexPolicy,
+                  StatsPolicy>::ContainHashBatch(const uint64_t *hashes,
+                                                 const size_t n,
+                                                 Status *results) const {
+  size_t i1[kContainBatchSize], i2[kContainBatchSize];
+  uint32_t tags[kContainBatchSize];
+
+  for (size_t start = 0; start < n; start += kContainBatchSize) {
+    const size_t count = std::min(kContainBatchSize, n - start);
+    for (size_t k = 0; k < count; k++) {
+      IndexTagFromHash(hashes[start + k], &i1[k], &tags[k]);
+      i2[k] = AltIndex(i1[k], tags[k]);
+    }
+    for (size_t k = 0; k < count; k++) {
+      table_.PrefetchBucket(i1[k]);
+      table_.PrefetchBucket(i2[k]);
+    }
+    for (size_t k = 0; k < count; k++) {
+      const bool found = VictimMatches(i1[k], i2[k], tags[k]);
+      results[start + k] =
+          (found || table_.FindTagInBuckets(i1[k], i2[k], tags[k]))
+              ? Ok
+              : NotFound;
+      if (StatsPolicy::kEnabled) {
+        CountLookup(i1[k], tags[k], found, Ok == results[start + k]);
+      }
+    }
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                    AltIndexPolicy,
+                    StatsPolicy>::DeleteHash(const uint64_t hash) {
   size_t i1, i2;
   uint32_t tag;
 
-  GenerateIndexTagHash(key, &i1, &tag);
+  IndexTagFromHash(hash, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
-  if (table_->DeleteTagFromBucket(i1, tag)) {
+  if (table_.DeleteTagFromBucket(i1, tag)) {
     num_items_--;
     goto TryEliminateVictim;
-  } else if (table_->DeleteTagFromBucket(i2, tag)) {
+  } else if (table_.DeleteTagFromBucket(i2, tag)) {
     num_items_--;
     goto TryEliminateVictim;
-  } else if (victim_.used && tag == victim_.tag &&
-             (i1 == victim_.index || i2 == victim_.index)) {
+  } else if (VictimMatches(i1, i2, tag)) {
     // num_items_--;
     victim_.used = false;
+    stats_.OnDelete(true);
     return Ok;
   } else {
+    stats_.OnDelete(false);
     return NotFound;
   }
 TryEliminateVictim:
+  stats_.OnDelete(true);
   if (victim_.used) {
     victim_.used = false;
     size_t i = victim_.index;
@@ -219,14 +1167,17 @@ TryEliminateVictim:
 }
 
 template <typename ItemType, size_t bits_per_item,
-          template <size_t> class TableType, typename HashFamily>
-std::string CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Info() const {
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+std::string CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                         AltIndexPolicy,
+                         StatsPolicy>::Info() const {
   std::stringstream ss;
   ss << "CuckooFilter Status:\n"
-     << "\t\t" << table_->Info() << "\n"
+     << "\t\t" << table_.Info() << "\n"
      << "\t\tKeys stored: " << Size() << "\n"
      << "\t\tLoad factor: " << LoadFactor() << "\n"
-     << "\t\tHashtable size: " << (table_->SizeInBytes() >> 10) << " KB\n";
+     << "\t\tHashtable size: " << (table_.SizeInBytes() >> 10) << " KB\n";
   if (Size() > 0) {
     ss << "\t\tbit/key:   " << BitsPerItem() << "\n";
   } else {
@@ -234,5 +1185,26 @@ std::string CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Info()
   }
   return ss.str();
 }
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily,
+          typename AltIndexPolicy, typename StatsPolicy>
+FilterStats CuckooFilter<ItemType, bits_per_item, TableType, HashFamily,
+                         AltIndexPolicy, StatsPolicy>::Stats() const {
+  FilterStats stats;
+  stats.num_items = Size();
+  stats.num_buckets = table_.NumBuckets();
+  stats.bits_per_tag = bits_per_item;
+  stats.size_in_bytes = SizeInBytes();
+  stats.load_factor = LoadFactor();
+  stats.bits_per_item = (Size() > 0) ? BitsPerItem() : 0;
+  table_.OccupancyHistogram(stats.occupancy);
+  stats.victim_used = victim_.used;
+  stats.victim_index = victim_.used ? victim_.index : 0;
+  stats.victim_tag = victim_.used ? victim_.tag & kTagMask : 0;
+  stats.fpr_estimate = EstimateFpr(stats.occupancy, bits_per_item);
+  stats.counters = Counters();
+  return stats;
+}
 }  // namespace cuckoofilter
 #endif  // CUCKOO_FILTER_CUCKOO_FILTER_H_
@@ -0,0 +1,21 @@
+#ifndef CUCKOO_FILTER_CUCKOO_VALUE_FILTER_H_
+#define CUCKOO_FILTER_CUCKOO_VALUE_FILTER_H_
+
+#include "cuckoofilter.h"
+#include "valuetable.h"
+
+namespace cuckoofilter {
+
+// A cuckoo filter that maps each key to a bits_per_value bit value (e.g. a
+// shard ID) with Add(item, value), Lookup(item, &value) and Update(item,
+// value): a CuckooFilter over ValueTable, see CuckooFilter::Lookup.
+template <typename ItemType, size_t bits_per_item, size_t bits_per_value,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type,
+          typename AltIndexPolicy = XorAltIndex,
+          typename StatsPolicy = NoStats>
+using CuckooValueFilter =
+    CuckooFilter<ItemType, bits_per_item,
+                 ValueTableOf<bits_per_value>::template Table, HashFamily,
+                 AltIndexPolicy, StatsPolicy>;
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CUCKOO_VALUE_FILTER_H_
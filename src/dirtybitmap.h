@@ -0,0 +1,81 @@
+#ifndef CUCKOO_FILTER_DIRTY_BITMAP_H_
+#define CUCKOO_FILTER_DIRTY_BITMAP_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+namespace cuckoofilter {
+
+// size of the regions of a table whose changes DirtyBitmap tracks, a page
+const size_t kDirtyRegionBytes = 4096;
+
+// One bit per kDirtyRegionBytes of a table's storage, set by every write to
+// the table once tracking is on, so that a checkpoint only saves the regions
+// that changed (see Checkpointer). Off by default, when it costs the table a
+// pointer and each write a predictable branch.
+class DirtyBitmap {
+  std::unique_ptr<uint64_t[]> words_;
+
+  // A word covers 64 regions, more than the bucket ranges that the threads
+  // of AddAll write at once, so bits are set atomically, and only when not
+  // set yet, which keeps rewrites of a dirty region cheap.
+  inline void MarkRegion(const size_t r) {
+    const uint64_t bit = 1ULL << (r % 64);
+    if ((__atomic_load_n(&words_[r / 64], __ATOMIC_RELAXED) & bit) == 0) {
+      __atomic_fetch_or(&words_[r / 64], bit, __ATOMIC_RELAXED);
+    }
+  }
+
+ public:
+  static size_t NumRegions(const size_t bytes) {
+    return (bytes + kDirtyRegionBytes - 1) / kDirtyRegionBytes;
+  }
+
+  bool Enabled() const { return words_ != nullptr; }
+
+  // start tracking a storage of bytes bytes, with all regions dirty
+  void Enable(const size_t bytes) {
+    const size_t num_words = (NumRegions(bytes) + 63) / 64;
+    words_.reset(new uint64_t[num_words]);
+    memset(words_.get(), 0xff, num_words * sizeof(uint64_t));
+  }
+
+  // mark the regions of bytes [first, last] dirty, which are at most two as
+  // tables write less than a region at once
+  inline void Mark(const size_t first, const size_t last) {
+    if (words_ != nullptr) {
+      MarkRegion(first / kDirtyRegionBytes);
+      MarkRegion(last / kDirtyRegionBytes);
+    }
+  }
+
+  void MarkAll(const size_t bytes) {
+    if (words_ != nullptr) {
+      Enable(bytes);
+    }
+  }
+
+  // Append the dirty regions of a storage of bytes bytes to regions, in
+  // order, and mark them clean.
+  void Take(const size_t bytes, std::vector<size_t> *regions) {
+    if (words_ == nullptr) {
+      return;
+    }
+    const size_t num_regions = NumRegions(bytes);
+    for (size_t w = 0; w * 64 < num_regions; w++) {
+      for (uint64_t bits = words_[w]; bits != 0; bits &= bits - 1) {
+        const size_t r = w * 64 + __builtin_ctzll(bits);
+        if (r < num_regions) {
+          regions->push_back(r);
+        }
+      }
+      words_[w] = 0;
+    }
+  }
+};
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_DIRTY_BITMAP_H_
@@ -0,0 +1,696 @@
+#ifndef CUCKOO_FILTER_EXTERNAL_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_EXTERNAL_CUCKOO_FILTER_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "ioring.h"
+
+namespace cuckoofilter {
+
+// size of the blocks an ExternalCuckooFilter reads and writes, the page of
+// most SSDs
+const size_t kExternalPageSize = 4096;
+// pages an ExternalCuckooFilter keeps in flight at once
+const unsigned kExternalQueueDepth = 64;
+// items ContainBatch looks up, and pages Flush updates, per round of reads
+const size_t kExternalBatchPages = 1024;
+// load factor of the pages for max_num_keys keys, low enough that few pages
+// overflow (see Spilled)
+const double kExternalMaxLoad = 0.92;
+
+// A cuckoo filter whose buckets live in a file, for key sets whose filter
+// is larger than memory, on an SSD. The file is read and written in pages
+// of kExternalPageSize bytes, with O_DIRECT where the file system allows it
+// so that the page cache does not hold a second copy.
+//
+// Both buckets of a key are in the same page: the key's hash picks a page
+// and a bucket in it, and the alternate bucket is found inside the page,
+// so a lookup reads one page. Pages do not hold the same number of keys,
+// and a kick chain that fails in a full page leaves its last tag in a
+// small list in memory, as CuckooFilter leaves it in its victim; the file
+// is sized so that this is rare (see kExternalMaxLoad).
+//
+// Add only buffers the hash of the key in memory. Flush, called once the
+// buffer is full, sorts the buffer by page and updates each page with all
+// of its keys in one read and one write. ContainBatch groups its keys by
+// page too, and reads the pages through an IoRing, kExternalQueueDepth at a
+// time, to keep the SSD busy; Contain reads one page with pread.
+//
+// One process at a time may open the file, which an exclusive flock
+// enforces. Sync, or the destructor, writes the item count and the spilled
+// tags to the file, so that Open finds the filter again. HashFamily must
+// be trivially copyable, as it is saved in the file. Only SingleTable and
+// PackedTable can be used, as tables that adopt memory (see
+// SingleTable::Adopt). Not thread-safe.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTable,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type>
+class ExternalCuckooFilter {
+  static_assert(std::is_trivially_copyable<HashFamily>::value,
+                "the hash functions are saved as bytes");
+
+  typedef TableType<bits_per_item> Table;
+
+  static const uint64_t kMagic = 0x6375636b6f6f6578ULL;  // "cuckooex"
+  static const uint32_t kVersion = 1;
+
+  // the start of the file; all sizes are in bytes
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t bits_per_tag;
+    uint64_t tags_per_bucket;
+    uint64_t page_size;
+    uint64_t page_buckets;
+    uint64_t num_pages;
+    uint64_t hasher_offset;
+    uint64_t hasher_size;
+    uint64_t table_offset;
+    uint64_t num_items;
+    uint64_t num_spilled;
+  };
+
+  // a tag that did not fit into its page
+  struct SpilledTag {
+    uint64_t page;
+    uint32_t bucket;
+    uint32_t tag;
+
+    bool operator<(const SpilledTag &other) const { return page < other.page; }
+  };
+
+  // where a hash goes
+  struct Slot {
+    uint64_t page;
+    size_t b1, b2;
+    uint32_t tag;
+  };
+
+  // memory for blocks read or written with O_DIRECT, aligned to a page
+  struct FreeDeleter {
+    void operator()(char *p) const { free(p); }
+  };
+  typedef std::unique_ptr<char, FreeDeleter> Buffer;
+
+  static Buffer AllocateBuffer(const size_t size) {
+    void *p = nullptr;
+    if (posix_memalign(&p, kExternalPageSize, size) != 0) {
+      throw std::bad_alloc();
+    }
+    return Buffer(static_cast<char *>(p));
+  }
+
+  int fd_;
+  bool direct_io_;
+  size_t page_buckets_;
+  size_t num_pages_;
+  size_t table_offset_;
+  size_t buffer_items_;
+  size_t num_items_;
+  HashFamily hasher_;
+  WyRand random_;
+  // spilled tags, sorted by page, and their maximum number before Add
+  // reports the filter full
+  std::vector<SpilledTag> spilled_;
+  size_t max_spilled_;
+  // Hashes added since the last Flush; the first pending_sorted_ are
+  // sorted. Lookups sort the rest, so the buffer is mutable.
+  mutable std::vector<uint64_t> pending_;
+  mutable size_t pending_sorted_;
+  // the IO state of lookups is mutable too
+  mutable IoRing ring_;
+  mutable Buffer page_;
+  mutable Buffer batch_;
+
+  static size_t AlignUp(const size_t x, const size_t align) {
+    return (x + align - 1) / align * align;
+  }
+
+  // number of buckets whose table fits in a page
+  static size_t PageBuckets() {
+    size_t buckets = kExternalPageSize * 8 / (bits_per_item * 4);
+    while (buckets > 1 && Table::StorageSize(buckets) > kExternalPageSize) {
+      buckets--;
+    }
+    return buckets;
+  }
+
+  static size_t HasherOffset() { return AlignUp(sizeof(Header), 64); }
+
+  static size_t TableOffset() {
+    return AlignUp(HasherOffset() + sizeof(HashFamily), kExternalPageSize);
+  }
+
+  [[noreturn]] static void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  // Take the lock on fd, and switch it to O_DIRECT where possible. Closes
+  // fd on failure.
+  static bool Prepare(const int fd, const std::string &path) {
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowErrno("another process has " + path + " open");
+    }
+#ifdef O_DIRECT
+    // fails, without side effects, on file systems without O_DIRECT
+    const int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0;
+#else
+    return false;
+#endif
+  }
+
+  ExternalCuckooFilter(const int fd, const bool direct_io,
+                       const size_t num_pages, const size_t buffer_items,
+                       const HashFamily &hasher)
+      : fd_(fd),
+        direct_io_(direct_io),
+        page_buckets_(PageBuckets()),
+        num_pages_(num_pages),
+        table_offset_(TableOffset()),
+        buffer_items_(std::max<size_t>(1, buffer_items)),
+        num_items_(0),
+        hasher_(hasher),
+        random_(),
+        max_spilled_(std::max<size_t>(64, num_pages * page_buckets_ * 4 /
+                                              1024)),
+        pending_sorted_(0),
+        ring_(kExternalQueueDepth),
+        page_(AllocateBuffer(kExternalPageSize)),
+        batch_(AllocateBuffer(kExternalBatchPages * kExternalPageSize)) {}
+
+  uint64_t PageOffset(const uint64_t page) const {
+    return table_offset_ + page * kExternalPageSize;
+  }
+
+  uint64_t SpillOffset() const { return PageOffset(num_pages_); }
+
+  // the page from the high 32 bits of the hash, so that sorting hashes
+  // sorts them by page, and the bucket from a remix of all bits
+  Slot SlotOf(const uint64_t hash) const {
+    Slot slot;
+    slot.page = ((hash >> 32) * num_pages_) >> 32;
+    uint64_t mix = (hash ^ (hash >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    slot.b1 = ((mix >> 32) * page_buckets_) >> 32;
+    slot.tag = hash & ((1ULL << bits_per_item) - 1);
+    slot.tag += (slot.tag == 0);
+    slot.b2 = AltBucket(slot.b1, slot.tag);
+    return slot;
+  }
+
+  // The alternate bucket of a tag inside its page: an involution for any
+  // number of buckets, unlike XorAltIndex, so a page holds as many buckets
+  // as fit.
+  size_t AltBucket(const size_t bucket, const uint32_t tag) const {
+    const size_t h = (tag * 0x5bd1e995U) % page_buckets_;
+    return (h + page_buckets_ - bucket) % page_buckets_;
+  }
+
+  Table PageTable(char *page) const {
+    return Table::Adopt(page_buckets_, page);
+  }
+
+  // the kick chain of CuckooFilter::AddImpl, inside one page
+  void AddToPage(Table &table, const uint64_t page, const size_t bucket,
+                 const uint32_t tag) {
+    size_t curindex = bucket;
+    uint32_t curtag = tag;
+    for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
+      const bool kickout = count > 0;
+      uint32_t oldtag = 0;
+      if (table.InsertTagToBucket(curindex, curtag, kickout, oldtag,
+                                  random_)) {
+        num_items_++;
+        return;
+      }
+      if (kickout) {
+        curtag = oldtag;
+      }
+      curindex = AltBucket(curindex, curtag);
+    }
+    spilled_.push_back(SpilledTag{page, static_cast<uint32_t>(curindex),
+                                  curtag});
+    num_items_++;
+  }
+
+  // the first spilled tag of the key of slot, or spilled_.end()
+  typename std::vector<SpilledTag>::const_iterator FindSpilled(
+      const Slot &slot) const {
+    auto it = std::lower_bound(spilled_.begin(), spilled_.end(),
+                               SpilledTag{slot.page, 0, 0});
+    for (; it != spilled_.end() && it->page == slot.page; ++it) {
+      if (it->tag == slot.tag &&
+          (it->bucket == slot.b1 || it->bucket == slot.b2)) {
+        return it;
+      }
+    }
+    return spilled_.end();
+  }
+
+  bool InSpilled(const Slot &slot) const {
+    return FindSpilled(slot) != spilled_.end();
+  }
+
+  // Whether hash was added since the last Flush. A few unsorted hashes are
+  // scanned; more are sorted and merged into the rest first.
+  bool InPending(const uint64_t hash) const {
+    if (pending_.size() - pending_sorted_ > 256) {
+      std::sort(pending_.begin() + pending_sorted_, pending_.end());
+      std::inplace_merge(pending_.begin(), pending_.begin() + pending_sorted_,
+                         pending_.end());
+      pending_sorted_ = pending_.size();
+    }
+    return std::binary_search(pending_.begin(),
+                              pending_.begin() + pending_sorted_, hash) ||
+           std::find(pending_.begin() + pending_sorted_, pending_.end(),
+                     hash) != pending_.end();
+  }
+
+  void ReadPage(const uint64_t page) const {
+    IoRing::Transfer(fd_, false,
+                     IoRequest{page_.get(), kExternalPageSize,
+                               PageOffset(page)});
+  }
+
+  void WritePage(const uint64_t page) {
+    IoRing::Transfer(fd_, true,
+                     IoRequest{page_.get(), kExternalPageSize,
+                               PageOffset(page)});
+  }
+
+  void WriteHeader() {
+    Buffer block = AllocateBuffer(table_offset_);
+    memset(block.get(), 0, table_offset_);
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.bits_per_tag = bits_per_item;
+    header.tags_per_bucket = Table::kTagsPerBucket;
+    header.page_size = kExternalPageSize;
+    header.page_buckets = page_buckets_;
+    header.num_pages = num_pages_;
+    header.hasher_offset = HasherOffset();
+    header.hasher_size = sizeof(HashFamily);
+    header.table_offset = table_offset_;
+    header.num_items = num_items_;
+    header.num_spilled = spilled_.size();
+    memcpy(block.get(), &header, sizeof(header));
+    memcpy(block.get() + HasherOffset(), &hasher_, sizeof(HashFamily));
+    IoRing::Transfer(fd_, true, IoRequest{block.get(), table_offset_, 0});
+  }
+
+ public:
+  // Create a filter for up to max_num_keys keys in a new file at path,
+  // buffering up to buffer_items added keys in memory. Throws
+  // std::system_error if path exists or cannot be created.
+  static std::unique_ptr<ExternalCuckooFilter> Create(
+      const std::string &path, const size_t max_num_keys,
+      const size_t buffer_items = 1 << 20,
+      const HashFamily &hasher = HashFamily()) {
+    const size_t slots = PageBuckets() * Table::kTagsPerBucket;
+    const size_t num_pages = std::max<size_t>(
+        1, static_cast<size_t>(max_num_keys / kExternalMaxLoad / slots) + 1);
+    if (num_pages >> 32) {
+      throw std::length_error("external cuckoo filter: too many pages");
+    }
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+      ThrowErrno("open " + path);
+    }
+    std::unique_ptr<ExternalCuckooFilter> filter;
+    try {
+      const bool direct_io = Prepare(fd, path);
+      filter.reset(new ExternalCuckooFilter(fd, direct_io, num_pages,
+                                            buffer_items, hasher));
+      // a sparse file, which reads as empty buckets
+      if (ftruncate(fd, filter->SpillOffset()) != 0) {
+        ThrowErrno("ftruncate " + path);
+      }
+      filter->WriteHeader();
+    } catch (...) {
+      if (!filter) {
+        close(fd);
+      }
+      unlink(path.c_str());
+      throw;
+    }
+    return filter;
+  }
+
+  // Open the filter in the file at path, which Create made with the same
+  // template arguments. Throws std::system_error if it cannot be opened, or
+  // another process has it open, and std::runtime_error if it was made for
+  // another kind of filter.
+  static std::unique_ptr<ExternalCuckooFilter> Open(
+      const std::string &path, const size_t buffer_items = 1 << 20) {
+    const int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      ThrowErrno("open " + path);
+    }
+    const bool direct_io = Prepare(fd, path);
+    Header header;
+    HashFamily hasher;
+    std::vector<SpilledTag> spilled;
+    try {
+      Buffer block = AllocateBuffer(TableOffset());
+      IoRing::Transfer(fd, false, IoRequest{block.get(), TableOffset(), 0});
+      memcpy(&header, block.get(), sizeof(header));
+      if (header.magic != kMagic) {
+        throw std::runtime_error(path + " is not an external cuckoo filter");
+      }
+      const size_t spill_bytes =
+          AlignUp(header.num_spilled * sizeof(SpilledTag), kExternalPageSize);
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        ThrowErrno("fstat " + path);
+      }
+      const char *mismatch =
+          header.version != kVersion ? "version"
+          : header.bits_per_tag != bits_per_item ? "tag size"
+          : header.tags_per_bucket != Table::kTagsPerBucket
+              ? "tags per bucket"
+          : header.page_size != kExternalPageSize ? "page size"
+          : header.page_buckets != PageBuckets() ? "table type"
+          : header.hasher_offset != HasherOffset() ||
+                  header.hasher_size != sizeof(HashFamily)
+              ? "hash family"
+          : header.table_offset != TableOffset() ||
+                  static_cast<uint64_t>(st.st_size) <
+                      TableOffset() + header.num_pages * kExternalPageSize +
+                          spill_bytes
+              ? "layout"
+              : nullptr;
+      if (mismatch != nullptr) {
+        throw std::runtime_error(std::string("external cuckoo filter: ") +
+                                 mismatch + " differs");
+      }
+      memcpy(&hasher, block.get() + HasherOffset(), sizeof(HashFamily));
+      if (spill_bytes > 0) {
+        Buffer spill = AllocateBuffer(spill_bytes);
+        IoRing::Transfer(fd, false,
+                         IoRequest{spill.get(), spill_bytes,
+                                   TableOffset() + header.num_pages *
+                                                       kExternalPageSize});
+        spilled.resize(header.num_spilled);
+        memcpy(spilled.data(), spill.get(),
+               header.num_spilled * sizeof(SpilledTag));
+      }
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    std::unique_ptr<ExternalCuckooFilter> filter;
+    try {
+      filter.reset(new ExternalCuckooFilter(fd, direct_io, header.num_pages,
+                                            buffer_items, hasher));
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    filter->num_items_ = header.num_items;
+    filter->spilled_.swap(spilled);
+    return filter;
+  }
+
+  ExternalCuckooFilter(const ExternalCuckooFilter &) = delete;
+  ExternalCuckooFilter &operator=(const ExternalCuckooFilter &) = delete;
+
+  // Syncs, ignoring errors; call Sync to see them.
+  ~ExternalCuckooFilter() {
+    try {
+      Sync();
+    } catch (...) {
+    }
+    close(fd_);
+  }
+
+  // Add an item to the filter. It is buffered until the next Flush.
+  // Returns NotEnoughSpace once too many tags spilled from their pages.
+  Status Add(const ItemType &item) { return AddHash(hasher_(item)); }
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const {
+    return ContainHash(hasher_(item));
+  }
+
+  // Report if each of items[0, n) is inserted, like Contain, reading the
+  // pages of up to kExternalBatchPages items at a time together.
+  void ContainBatch(const ItemType *items, const size_t n,
+                    Status *results) const {
+    std::vector<uint64_t> hashes(n);
+    HashItems(hasher_, items, n, hashes.data());
+    ContainHashBatch(hashes.data(), n, results);
+  }
+
+  // Delete an key from the filter, reading and writing its page at once.
+  Status Delete(const ItemType &item) { return DeleteHash(hasher_(item)); }
+
+  // Add, Contain, ContainBatch and Delete of a uniform 64-bit hash, see
+  // CuckooFilter
+  Status AddHash(const uint64_t hash) {
+    if (spilled_.size() >= max_spilled_) {
+      return NotEnoughSpace;
+    }
+    pending_.push_back(hash);
+    if (pending_.size() >= buffer_items_) {
+      Flush();
+    }
+    return Ok;
+  }
+
+  Status ContainHash(const uint64_t hash) const {
+    const Slot slot = SlotOf(hash);
+    if (InPending(hash) || InSpilled(slot)) {
+      return Ok;
+    }
+    ReadPage(slot.page);
+    return PageTable(page_.get()).FindTagInBuckets(slot.b1, slot.b2, slot.tag)
+               ? Ok
+               : NotFound;
+  }
+
+  void ContainHashBatch(const uint64_t *hashes, const size_t n,
+                        Status *results) const;
+
+  Status DeleteHash(const uint64_t hash);
+
+  // Insert the buffered keys into their pages, reading and writing each
+  // page once, in the order of the file.
+  void Flush();
+
+  // Flush, and save the item count and the spilled tags to the file.
+  void Sync();
+
+  /* methods for providing stats  */
+  // number of current inserted items, buffered ones included
+  size_t Size() const { return num_items_ + pending_.size(); }
+
+  // size of the file in bytes, without the spilled tags
+  size_t SizeInBytes() const { return SpillOffset(); }
+
+  // number of tags kept in memory, as their page was full
+  size_t Spilled() const { return spilled_.size(); }
+
+  // whether pages bypass the page cache with O_DIRECT
+  bool DirectIo() const { return direct_io_; }
+
+  // whether batches of pages go through an io_uring
+  bool Uring() const { return ring_.Uring(); }
+
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "ExternalCuckooFilter Status:\n"
+       << "\t\t" << PageTable(page_.get()).Info() << "\n"
+       << "\t\tKeys stored: " << Size() << "\n"
+       << "\t\tPages: " << num_pages_ << " of " << kExternalPageSize
+       << " bytes, " << page_buckets_ << " buckets each\n"
+       << "\t\tSpilled tags: " << spilled_.size() << "\n"
+       << "\t\tIO: " << (direct_io_ ? "O_DIRECT" : "page cache") << ", "
+       << (ring_.Uring() ? "io_uring" : "pread") << " with "
+       << ring_.Depth() << " pages in flight\n";
+    return ss.str();
+  }
+};
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void ExternalCuckooFilter<ItemType, bits_per_item, TableType,
+                          HashFamily>::ContainHashBatch(const uint64_t *hashes,
+                                                        const size_t n,
+                                                        Status *results)
+    const {
+  // the items left to look up in the file, by page
+  std::vector<std::pair<Slot, size_t>> misses;
+  std::vector<IoRequest> requests;
+  // the first miss of each request, and one past the last
+  std::vector<size_t> firsts;
+  for (size_t start = 0; start < n; start += kExternalBatchPages) {
+    const size_t count = std::min(kExternalBatchPages, n - start);
+    misses.clear();
+    for (size_t k = start; k < start + count; k++) {
+      const Slot slot = SlotOf(hashes[k]);
+      if (InPending(hashes[k]) || InSpilled(slot)) {
+        results[k] = Ok;
+      } else {
+        misses.push_back(std::make_pair(slot, k));
+      }
+    }
+    std::sort(misses.begin(), misses.end(),
+              [](const std::pair<Slot, size_t> &a,
+                 const std::pair<Slot, size_t> &b) {
+                return a.first.page < b.first.page;
+              });
+    requests.clear();
+    firsts.clear();
+    for (size_t m = 0; m < misses.size(); m++) {
+      if (m == 0 || misses[m].first.page != misses[m - 1].first.page) {
+        requests.push_back(IoRequest{
+            batch_.get() + requests.size() * kExternalPageSize,
+            kExternalPageSize, PageOffset(misses[m].first.page)});
+        firsts.push_back(m);
+      }
+    }
+    firsts.push_back(misses.size());
+    ring_.Run(fd_, false, requests.data(), requests.size(),
+              [&](const size_t r) {
+                const Table table = PageTable(requests[r].buffer);
+                for (size_t m = firsts[r]; m < firsts[r + 1]; m++) {
+                  const Slot &slot = misses[m].first;
+                  results[misses[m].second] =
+                      table.FindTagInBuckets(slot.b1, slot.b2, slot.tag)
+                          ? Ok
+                          : NotFound;
+                }
+              });
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status ExternalCuckooFilter<ItemType, bits_per_item, TableType,
+                            HashFamily>::DeleteHash(const uint64_t hash) {
+  if (InPending(hash)) {
+    // sorted by now, unless it was among the last few
+    auto it = std::lower_bound(pending_.begin(),
+                               pending_.begin() + pending_sorted_, hash);
+    if (it != pending_.begin() + pending_sorted_ && *it == hash) {
+      pending_sorted_--;
+    } else {
+      it = std::find(pending_.begin() + pending_sorted_, pending_.end(), hash);
+    }
+    pending_.erase(it);
+    return Ok;
+  }
+  const Slot slot = SlotOf(hash);
+  ReadPage(slot.page);
+  Table table = PageTable(page_.get());
+  if (table.DeleteTagFromBucket(slot.b1, slot.tag) ||
+      table.DeleteTagFromBucket(slot.b2, slot.tag)) {
+    num_items_--;
+    const auto it = std::lower_bound(spilled_.begin(), spilled_.end(),
+                                     SpilledTag{slot.page, 0, 0});
+    if (it != spilled_.end() && it->page == slot.page) {
+      // a slot was freed, so try to put a spilled tag of the page back
+      const SpilledTag spilled = *it;
+      spilled_.erase(it);
+      num_items_--;
+      AddToPage(table, spilled.page, spilled.bucket, spilled.tag);
+      std::sort(spilled_.begin(), spilled_.end());
+    }
+    WritePage(slot.page);
+    return Ok;
+  }
+  const auto it = FindSpilled(slot);
+  if (it != spilled_.end()) {
+    spilled_.erase(it);
+    num_items_--;
+    return Ok;
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void ExternalCuckooFilter<ItemType, bits_per_item, TableType,
+                          HashFamily>::Flush() {
+  std::sort(pending_.begin(), pending_.end());
+  std::vector<IoRequest> requests;
+  std::vector<size_t> firsts;
+  for (size_t start = 0; start < pending_.size();) {
+    // the next kExternalBatchPages pages with pending hashes
+    requests.clear();
+    firsts.clear();
+    size_t end = start;
+    while (end < pending_.size() && requests.size() < kExternalBatchPages) {
+      const uint64_t page = SlotOf(pending_[end]).page;
+      requests.push_back(IoRequest{
+          batch_.get() + requests.size() * kExternalPageSize,
+          kExternalPageSize, PageOffset(page)});
+      firsts.push_back(end);
+      while (end < pending_.size() && SlotOf(pending_[end]).page == page) {
+        end++;
+      }
+    }
+    firsts.push_back(end);
+    ring_.Run(fd_, false, requests.data(), requests.size(),
+              [&](const size_t r) {
+                Table table = PageTable(requests[r].buffer);
+                for (size_t k = firsts[r]; k < firsts[r + 1]; k++) {
+                  const Slot slot = SlotOf(pending_[k]);
+                  AddToPage(table, slot.page, slot.b1, slot.tag);
+                }
+              });
+    ring_.Run(fd_, true, requests.data(), requests.size(), [](size_t) {});
+    start = end;
+  }
+  pending_.clear();
+  pending_sorted_ = 0;
+  std::sort(spilled_.begin(), spilled_.end());
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void ExternalCuckooFilter<ItemType, bits_per_item, TableType,
+                          HashFamily>::Sync() {
+  Flush();
+  const size_t bytes =
+      AlignUp(spilled_.size() * sizeof(SpilledTag), kExternalPageSize);
+  if (bytes > 0) {
+    Buffer block = AllocateBuffer(bytes);
+    memset(block.get(), 0, bytes);
+    memcpy(block.get(), spilled_.data(), spilled_.size() * sizeof(SpilledTag));
+    IoRing::Transfer(fd_, true, IoRequest{block.get(), bytes, SpillOffset()});
+  }
+  if (ftruncate(fd_, SpillOffset() + bytes) != 0) {
+    ThrowErrno("ftruncate");
+  }
+  WriteHeader();
+  if (fdatasync(fd_) != 0) {
+    ThrowErrno("fdatasync");
+  }
+}
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_EXTERNAL_CUCKOO_FILTER_H_
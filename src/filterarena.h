@@ -0,0 +1,189 @@
+#ifndef CUCKOO_FILTER_FILTER_ARENA_H_
+#define CUCKOO_FILTER_FILTER_ARENA_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "bitsutil.h"
+#include "hashutil.h"
+#include "randutil.h"
+
+namespace cuckoofilter {
+
+// Memory for many small filters, such as one per customer: their tables,
+// their headers (see New) and the hash functions they share (see
+// SharedHash) are carved out of a few large slabs, instead of a heap
+// allocation or three per filter. Filters then sit next to each other, so a
+// scan over all of them reads memory in order, and the slabs are backed by
+// huge pages where the system allows, so that scanning them takes few TLB
+// misses.
+//
+// Nothing is freed until the whole arena is: Release, or the destructor,
+// unmaps all slabs at once without running any destructors. Objects placed
+// in the arena must therefore not own memory elsewhere. An arena is not
+// thread-safe; filters in it are as thread-safe as others.
+class FilterArena {
+  // slabs are multiples of the huge page size
+  static const size_t kHugePageSize = 2 << 20;
+
+  struct Slab {
+    char *base;
+    size_t size;
+  };
+
+  std::vector<Slab> slabs_;
+  size_t slab_size_;
+  // free space of the last slab
+  char *next_;
+  char *end_;
+  // bytes handed out by Allocate
+  size_t bytes_used_;
+  // whether all slabs are explicit huge pages (MAP_HUGETLB)
+  bool huge_pages_;
+  // seeds the kick choices of the filters in the arena
+  WyRand random_;
+
+  // map a slab of size bytes, a multiple of kHugePageSize
+  char *MapSlab(const size_t size) {
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // only succeeds if the administrator reserved huge pages
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+      huge_pages_ = false;
+      p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+#ifdef MADV_HUGEPAGE
+      // ask for transparent huge pages instead
+      madvise(p, size, MADV_HUGEPAGE);
+#endif
+    }
+    slabs_.push_back(Slab{static_cast<char *>(p), size});
+    return static_cast<char *>(p);
+  }
+
+ public:
+  // slab_size is rounded up to a multiple of 2 MB; requests larger than a
+  // slab get a slab of their own.
+  explicit FilterArena(const size_t slab_size = 64 << 20)
+      : slab_size_(std::max<size_t>(1, (slab_size + kHugePageSize - 1) /
+                                           kHugePageSize) *
+                   kHugePageSize),
+        next_(nullptr),
+        end_(nullptr),
+        bytes_used_(0),
+        huge_pages_(true),
+        random_() {}
+
+  FilterArena(const FilterArena &) = delete;
+  FilterArena &operator=(const FilterArena &) = delete;
+
+  ~FilterArena() { Release(); }
+
+  // Unmap all slabs, destroying everything in the arena at once. The arena
+  // can be used again afterwards.
+  void Release() {
+    for (const Slab &slab : slabs_) {
+      munmap(slab.base, slab.size);
+    }
+    slabs_.clear();
+    next_ = end_ = nullptr;
+    bytes_used_ = 0;
+    huge_pages_ = true;
+  }
+
+  // Uninitialized memory for size bytes. A block of at most a cache line is
+  // aligned to the smallest power of two no less than size, so it never
+  // straddles two lines; larger ones span several lines anyway, and are
+  // aligned to 8 bytes only, so that little memory goes to padding.
+  void *Allocate(const size_t size) {
+    const size_t align =
+        (size > 64) ? 8 : upperpower2(std::max<size_t>(size, 1));
+    char *p = reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(next_) + align - 1) & ~(align - 1));
+    if (next_ == nullptr || p + size > end_) {
+      if (size > slab_size_) {
+        // keep filling the current slab after this one
+        const size_t big = (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+        bytes_used_ += size;
+        return MapSlab(big);
+      }
+      p = MapSlab(slab_size_);
+      end_ = p + slab_size_;
+    }
+    next_ = p + size;
+    bytes_used_ += size;
+    return p;
+  }
+
+  // Construct a T in the arena. It is never destroyed, see above.
+  template <typename T, typename... Args>
+  T *New(Args &&... args) {
+    return new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // a seed for the kick choices of a new filter, cheaper than reading
+  // std::random_device for each
+  uint64_t NewSeed() { return random_(); }
+
+  // bytes handed out, and bytes mapped, some of which may not be touched yet
+  size_t BytesUsed() const { return bytes_used_; }
+  size_t BytesMapped() const {
+    size_t bytes = 0;
+    for (const Slab &slab : slabs_) {
+      bytes += slab.size;
+    }
+    return bytes;
+  }
+
+  // whether all slabs are explicit huge pages; otherwise they were only
+  // advised to be transparent huge pages
+  bool HugePages() const { return huge_pages_; }
+};
+
+// A HashFamily for filters that share their hash functions, such as all
+// filters of an arena: it holds a pointer to one HashFamily, so copies
+// hash alike and a filter holding one is 8 bytes larger instead of
+// sizeof(HashFamily), which is 16 KB for SimpleTabulation. Only filters
+// built with a copy of an existing SharedHash can use it, as it cannot be
+// default constructed.
+template <typename HashFamily>
+class SharedHash {
+  const HashFamily *family_;
+
+ public:
+  // hash functions of a new HashFamily, placed in and freed with arena
+  explicit SharedHash(FilterArena &arena)
+      : family_(arena.New<HashFamily>()) {}
+
+  // hash functions of family, which must outlive all copies
+  explicit SharedHash(const HashFamily &family) : family_(&family) {}
+
+  const HashFamily &Family() const { return *family_; }
+
+  template <typename ItemType>
+  uint64_t operator()(const ItemType &item) const {
+    return (*family_)(item);
+  }
+};
+
+template <typename HashFamily, typename ItemType>
+inline void HashItems(const SharedHash<HashFamily> &hasher,
+                      const ItemType *items, const size_t n,
+                      uint64_t *hashes) {
+  HashItems(hasher.Family(), items, n, hashes);
+}
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_FILTER_ARENA_H_
@@ -0,0 +1,720 @@
+#ifndef CUCKOO_FILTER_FILTER_CODEC_H_
+#define CUCKOO_FILTER_FILTER_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "hashutil.h"
+#include "packedtable.h"
+#include "permencoding.h"
+#include "singletable.h"
+
+namespace cuckoofilter {
+
+// buckets in each block of an encoded filter, which decodes on its own
+const size_t kCodecBlockBuckets = 1 << 12;
+// number of blocks decoded at once: a block is a chain of dependent loads,
+// each finding where the next bucket starts, and a few chains overlap
+const size_t kCodecStreams = 4;
+
+// Reads and writes the four tags of a bucket, zero for empty slots, for the
+// tables FilterCodec supports: SingleTable and PackedTable.
+template <typename Table>
+struct BucketTags;
+
+template <size_t bits_per_tag>
+struct BucketTags<SingleTable<bits_per_tag>> {
+  static void Read(const SingleTable<bits_per_tag> &table, const size_t i,
+                   uint32_t tags[4]) {
+    for (size_t j = 0; j < 4; j++) {
+      tags[j] = table.ReadTag(i, j);
+    }
+  }
+
+  // write tags to the empty bucket i
+  static void Write(SingleTable<bits_per_tag> *table, const size_t i,
+                    const uint32_t tags[4]) {
+    for (size_t j = 0; j < 4; j++) {
+      table->WriteTag(i, j, tags[j]);
+    }
+  }
+
+  // Write the count tags of bucket i, for tags of up to 16 bits, sorted by
+  // their low 4 bits: tag j is in lane j of bits. For tables that store
+  // them so, code is the PermEncoding code of those bits of the tags and of
+  // 4 - count empty slots before them, and high the rest of each tag packed
+  // one after another.
+  static void WriteLanes(SingleTable<bits_per_tag> *table, const size_t i,
+                         const uint64_t bits, const size_t /* count */,
+                         const uint16_t /* code */,
+                         const uint64_t /* high */) {
+    table->WriteBucket(i, bits);
+  }
+};
+
+template <size_t bits_per_tag>
+struct BucketTags<PackedTable<bits_per_tag>> {
+  static void Read(const PackedTable<bits_per_tag> &table, const size_t i,
+                   uint32_t tags[4]) {
+    table.ReadBucket(i, tags);
+  }
+
+  static void Write(PackedTable<bits_per_tag> *table, const size_t i,
+                    const uint32_t tags[4]) {
+    uint32_t sorted[4] = {tags[0], tags[1], tags[2], tags[3]};
+    table->WriteBucket(i, sorted);
+  }
+
+  // the empty slots sort first, and the tags after them
+  static void WriteLanes(PackedTable<bits_per_tag> *table, const size_t i,
+                         const uint64_t /* bits */, const size_t count,
+                         const uint16_t code, const uint64_t high) {
+    const size_t dir_bits = bits_per_tag - 4;
+    const uint64_t dirbits = high & ((1ULL << (count * dir_bits)) - 1);
+    table->WriteBucketBits(i, code, dirbits << ((4 - count) * dir_bits));
+  }
+};
+
+// The sorted multisets of 1 to 4 nibbles, numbered in colex order: the
+// multiset a1 <= ... <= ac is number C(a1, 1) + C(a2 + 1, 2) + ... +
+// C(ac + c - 1, c). Like PermEncoding, which numbers those of 4 nibbles, it
+// saves the bits that the order of the tags in a bucket would cost, 2 for
+// 3 tags and 4 for 4.
+class NibbleMultisets {
+  // C(n, k) for n < 20, k <= 4
+  uint32_t binomial_[20][5];
+
+  static uint32_t Binomial(const uint32_t n, const uint32_t k) {
+    uint64_t b = 1;
+    for (uint32_t i = 0; i < k; i++) {
+      b = b * (n - i) / (i + 1);
+    }
+    return k > n ? 0 : b;
+  }
+
+  // number the multisets of count nibbles from base on, the first k given
+  void Generate(const size_t count, const size_t k, const uint32_t base,
+                const uint32_t nibbles) {
+    if (k == count) {
+      const uint32_t r = offset_[count] + Rank(nibbles, count);
+      packed_[r] = nibbles;
+      uint8_t lowbits[4] = {0, 0, 0, 0};
+      for (size_t j = 0; j < count; j++) {
+        lowbits[4 - count + j] = (nibbles >> (4 * j)) & 0xf;
+      }
+      perm_code_[r] = PermEncoding::Shared().encode(lowbits);
+      return;
+    }
+    for (uint32_t a = base; a < 16; a++) {
+      Generate(count, k + 1, a, nibbles | (a << (4 * k)));
+    }
+  }
+
+ public:
+  // the multisets of count nibbles are numbered [0, size_[count]), and
+  // written in code_bits_[count] bits
+  uint32_t size_[5];
+  uint32_t code_bits_[5];
+  uint32_t offset_[5];
+  // the nibbles of multiset r of count nibbles, ascending from bit 0, at
+  // offset_[count] + r
+  uint16_t packed_[1 + 16 + 136 + 816 + 3876];
+  // the PermEncoding code of those nibbles and 4 - count zeros, at the same
+  // place, for decoding straight into a PackedTable
+  uint16_t perm_code_[1 + 16 + 136 + 816 + 3876];
+
+  NibbleMultisets() {
+    for (uint32_t n = 0; n < 20; n++) {
+      for (uint32_t k = 0; k <= 4; k++) {
+        binomial_[n][k] = Binomial(n, k);
+      }
+    }
+    uint32_t offset = 0;
+    for (size_t count = 0; count <= 4; count++) {
+      size_[count] = Binomial(15 + count, count);
+      code_bits_[count] = 0;
+      while ((1U << code_bits_[count]) < size_[count]) {
+        code_bits_[count]++;
+      }
+      offset_[count] = offset;
+      offset += size_[count];
+      Generate(count, 0, 0, 0);
+    }
+  }
+
+  // The tables are the same for everyone, so all codecs share one copy.
+  static const NibbleMultisets &Shared() {
+    static const NibbleMultisets multisets;
+    return multisets;
+  }
+
+  // all ones for the first count of 4 slots, and zeros for the others; a
+  // load, where a comparison with count may well compile to a branch
+  static uint32_t SlotMask(const size_t count, const size_t k) {
+    static const uint32_t kMasks[5][4] = {{0, 0, 0, 0},
+                                          {~0U, 0, 0, 0},
+                                          {~0U, ~0U, 0, 0},
+                                          {~0U, ~0U, ~0U, 0},
+                                          {~0U, ~0U, ~0U, ~0U}};
+    return kMasks[count][k];
+  }
+
+  // the number of the first count of the sorted nibbles packed in nibbles
+  inline uint32_t Rank(const uint32_t nibbles, const size_t count) const {
+    uint32_t rank = 0;
+    for (size_t k = 0; k < 4; k++) {
+      rank += binomial_[((nibbles >> (4 * k)) & 0xf) + k][k + 1] &
+              SlotMask(count, k);
+    }
+    return rank;
+  }
+};
+
+// Encodes a CuckooFilter into a compact byte string, for shipping filters
+// to other hosts, and decodes it into a filter of the same type there. Only
+// the tags are encoded, so a table that is half empty takes about half its
+// size:
+//
+//   - the number of tags of each bucket is Huffman coded, with a code built
+//     from the occupancy histogram of the table;
+//   - the tags of a bucket are sorted by their low 4 bits, as PackedTable
+//     does, which are written as the number of their multiset (see
+//     NibbleMultisets), followed by the high bits of each tag.
+//
+// A bucket is thus a few bits of count, up to 12 bits of low nibbles and the
+// high bits of its tags, one bit string from the first bucket to the last.
+// The encoding starts with a Header, followed by the hash functions and the
+// alternate index policy, as bytes, the bit offset of every
+// kCodecBlockBuckets buckets in the bit string, and the bit string. Decode
+// checks a checksum of all but the header, and builds a new table of the
+// encoded size straight from the bit string, kCodecStreams blocks at a time.
+// The table only needs to be a SingleTable or PackedTable with tags of the
+// same size; the filters may differ in max_num_keys.
+template <typename Filter>
+class FilterCodec {
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().table_)>::type Table;
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().hasher_)>::type HashFamily;
+  static_assert(std::is_trivially_copyable<HashFamily>::value,
+                "the hash functions are encoded as bytes");
+  typedef typename std::remove_reference<decltype(
+      std::declval<Filter &>().alt_index_)>::type AltIndexPolicy;
+  static_assert(std::is_trivially_copyable<AltIndexPolicy>::value,
+                "the alternate index policy is encoded as bytes");
+  static_assert(Table::kTagsPerBucket == 4, "buckets hold 4 tags");
+
+  static const uint64_t kMagic = 0x6375636b6f6f6663ULL;  // "cuckoofc"
+  static const uint32_t kVersion = 2;
+  // bytes of the hash functions and the alternate index policy, which
+  // follow the header
+  static const size_t kPolicyBytes =
+      sizeof(HashFamily) + sizeof(AltIndexPolicy);
+
+  static const size_t kBitsPerTag = TableBits<Table>::value;
+  // bits of a tag in its nibble, and after it
+  static const size_t kLowBits = kBitsPerTag < 4 ? kBitsPerTag : 4;
+  static const size_t kHighBits = kBitsPerTag - kLowBits;
+  // longest code of a count of tags, as there are 5 counts
+  static const size_t kMaxCountBits = 4;
+  // bits of the longest bucket
+  static const size_t kBucketBits = kMaxCountBits + 12 + 4 * kHighBits;
+  // whether a bucket is written at once, and read from the 64-bit load that
+  // finds its count, which holds at least 57 bits of it
+  static const bool kOneLoad = kBucketBits <= 56;
+  // zeros after the bit string, so that the loads of a bucket that starts
+  // in it never pass its end
+  static const size_t kPadding = 24;
+
+  // Tags of 4 to 16 bits are decoded into a bucket of one word, with a lane
+  // per tag as in SingleTable; the masks of the lanes, of their low bits,
+  // their high bits, and of all their nibbles and high parts.
+  static const bool kLanes = kBitsPerTag >= 4 && kBitsPerTag <= 16;
+  static const uint64_t kLaneMask =
+      (4 * kBitsPerTag >= 64) ? ~0ULL : (1ULL << ((4 * kBitsPerTag) % 64)) - 1;
+  static const uint64_t kLaneOnes = kLaneMask / ((1ULL << kBitsPerTag) - 1);
+  static const uint64_t kLaneTop = kLaneOnes << (kBitsPerTag - 1);
+  static const uint64_t kLaneLow = kLaneMask & ~kLaneTop;
+  static const uint64_t kLaneNibbles = kLaneOnes * 0xf;
+  static const uint64_t kLaneHighParts = kLaneMask & ~kLaneNibbles;
+
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t bits_per_tag;
+    uint64_t tags_per_bucket;
+    uint64_t num_buckets;
+    uint64_t hasher_size;
+    uint64_t alt_index_size;
+    uint64_t num_items;
+    uint64_t victim_index;
+    uint32_t victim_tag;
+    uint32_t victim_used;
+    // the length of the code of each number of tags in a bucket, 0 for
+    // those that no bucket has
+    uint8_t count_bits[8];
+    // length of the bit string
+    uint64_t num_bits;
+    // of all that follows the header
+    uint64_t checksum;
+  };
+
+  // What the next kMaxCountBits bits of the bit string tell of the bucket
+  // that starts with them: the count of its tags, and the length of each of
+  // its parts. Taken from one table, so that a bucket costs a load of its
+  // bits and a lookup before the next one can be found.
+  struct CountEntry {
+    // the first count lanes, if kLanes
+    uint64_t lanes;
+    uint8_t count;
+    // 0 if no code starts so
+    uint8_t count_bits;
+    uint8_t rank_bits;
+    uint8_t bucket_bits;
+    uint16_t offset;
+    uint16_t size;
+  };
+
+  // Appends bit strings of up to 56 bits, first bit first, to a buffer of
+  // bytes with room for all of them and 8 more.
+  class BitWriter {
+    char *out_;
+    // the bits of the byte at out_ written so far, fewer than 8
+    uint64_t bits_;
+    size_t num_bits_;
+
+   public:
+    explicit BitWriter(char *out) : out_(out), bits_(0), num_bits_(0) {}
+
+    inline void Put(const uint64_t value, const size_t num_bits) {
+      bits_ |= value << num_bits_;
+      num_bits_ += num_bits;
+      memcpy(out_, &bits_, sizeof(bits_));
+      out_ += num_bits_ >> 3;
+      bits_ >>= num_bits_ & ~7;
+      num_bits_ &= 7;
+    }
+
+    // the bits written since start
+    uint64_t NumBits(const char *start) const {
+      return 8 * (out_ - start) + num_bits_;
+    }
+  };
+
+  static size_t BlockBuckets(const size_t num_buckets) {
+    return std::min(num_buckets, kCodecBlockBuckets);
+  }
+
+  static uint64_t Checksum(const char *data, const size_t size) {
+    static const WyHash hasher(kMagic);
+    return hasher(data, size);
+  }
+
+  static inline uint64_t Load(const char *string, const uint64_t position) {
+    uint64_t bits;
+    memcpy(&bits, string + (position >> 3), sizeof(bits));
+    return bits >> (position & 7);
+  }
+
+  // the lowest bits of x in the bits of mask, which holds a run of ones of
+  // the same length in each of the 4 lanes
+  static inline uint64_t Deposit(const uint64_t x, const uint64_t mask) {
+#ifdef __BMI2__
+    return _pdep_u64(x, mask);
+#else
+    if (mask == 0) {
+      return 0;
+    }
+    const size_t shift = __builtin_ctzll(mask);
+    const size_t width = __builtin_popcountll(mask) / 4;
+    uint64_t result = 0;
+    for (size_t k = 0; k < 4; k++) {
+      result |= ((x >> (k * width)) & ((1ULL << width) - 1))
+                << (k * kBitsPerTag + shift);
+    }
+    return result;
+#endif
+  }
+
+  // the top bit of each lane of v that is zero, as in SingleTable
+  static inline uint64_t ZeroLanes(const uint64_t v) {
+    return ~(((v & kLaneLow) + kLaneLow) | v) & kLaneTop;
+  }
+
+  // Lengths of a Huffman code for symbols of the given frequencies, 0 for
+  // those of frequency 0; a single symbol gets a 1-bit code.
+  static void CodeLengths(const uint64_t frequency[5], uint8_t lengths[5]) {
+    // nodes 0-4 are the symbols, and 5-8 the inner nodes
+    uint64_t weight[9];
+    int parent[9];
+    bool active[9];
+    size_t num_nodes = 5, num_active = 0;
+    for (size_t s = 0; s < 5; s++) {
+      weight[s] = frequency[s];
+      parent[s] = -1;
+      active[s] = frequency[s] > 0;
+      num_active += active[s];
+    }
+    for (; num_active > 1; num_active--, num_nodes++) {
+      int least[2] = {-1, -1};
+      for (size_t n = 0; n < num_nodes; n++) {
+        if (!active[n]) continue;
+        if (least[0] < 0 || weight[n] < weight[least[0]]) {
+          least[1] = least[0];
+          least[0] = n;
+        } else if (least[1] < 0 || weight[n] < weight[least[1]]) {
+          least[1] = n;
+        }
+      }
+      weight[num_nodes] = weight[least[0]] + weight[least[1]];
+      parent[num_nodes] = -1;
+      active[num_nodes] = true;
+      for (const int n : least) {
+        parent[n] = num_nodes;
+        active[n] = false;
+      }
+    }
+    for (size_t s = 0; s < 5; s++) {
+      lengths[s] = 0;
+      for (int n = parent[s]; n >= 0; n = parent[n]) {
+        lengths[s]++;
+      }
+      if (frequency[s] > 0 && lengths[s] == 0) {
+        lengths[s] = 1;
+      }
+    }
+  }
+
+  // The canonical code of each symbol given their lengths, bit reversed so
+  // that the first bit of a code is its lowest. Returns false unless the
+  // lengths are those of a prefix code of up to kMaxCountBits bits.
+  static bool Codes(const uint8_t lengths[5], uint32_t codes[5]) {
+    uint32_t kraft = 0;
+    for (size_t s = 0; s < 5; s++) {
+      if (lengths[s] > kMaxCountBits) {
+        return false;
+      }
+      kraft += lengths[s] ? 1U << (kMaxCountBits - lengths[s]) : 0;
+    }
+    if (kraft == 0 || kraft > (1U << kMaxCountBits)) {
+      return false;
+    }
+    uint32_t code = 0;
+    for (uint32_t length = 1; length <= kMaxCountBits; length++) {
+      for (size_t s = 0; s < 5; s++) {
+        if (lengths[s] == length) {
+          uint32_t reversed = 0;
+          for (uint32_t b = 0; b < length; b++) {
+            reversed |= ((code >> b) & 1) << (length - 1 - b);
+          }
+          codes[s] = reversed;
+          code++;
+        }
+      }
+      code <<= 1;
+    }
+    return true;
+  }
+
+  // Decode the bucket that starts at *position of string into the empty
+  // bucket i of table, and move *position past it. Returns false if it
+  // cannot be part of an encoding, or starts after limit.
+  static inline bool DecodeBucket(const char *string, const uint64_t limit,
+                                  const CountEntry *entries,
+                                  const uint16_t *packed,
+                                  const uint16_t *perm_codes,
+                                  uint64_t *position, const size_t i,
+                                  Table *table) {
+    // a branch rather than a select, so that the next load does not wait
+    // for this bucket to be checked
+    if (*position > limit) {
+      return false;
+    }
+    uint64_t bits = Load(string, *position);
+    const CountEntry &entry = entries[bits & ((1U << kMaxCountBits) - 1)];
+    const uint64_t high_position =
+        *position + entry.count_bits + entry.rank_bits;
+    *position += entry.bucket_bits;
+    bits >>= entry.count_bits;
+    const uint32_t rank = bits & ((1U << entry.rank_bits) - 1);
+    bits >>= entry.rank_bits;
+    bool valid = (entry.count_bits > 0) & (rank < entry.size);
+    const uint32_t r = entry.offset + (valid ? rank : 0);
+    const uint32_t nibbles = packed[r];
+    // only a corrupt encoding holds empty slots among the tags
+    if (kLanes) {
+      const uint64_t high = kOneLoad ? bits : Load(string, high_position);
+      const uint64_t lanes = (Deposit(nibbles, kLaneNibbles) |
+                              Deposit(high, kLaneHighParts)) &
+                             entry.lanes;
+      valid &= (ZeroLanes(lanes) & entry.lanes) == 0;
+      BucketTags<Table>::WriteLanes(table, i, lanes, entry.count,
+                                    perm_codes[r], high);
+    } else {
+      const uint64_t high_mask = (1ULL << kHighBits) - 1;
+      uint32_t tags[4];
+      for (size_t k = 0; k < 4; k++) {
+        const uint64_t part = kOneLoad
+                                  ? bits >> (k * kHighBits)
+                                  : Load(string, high_position + k * kHighBits);
+        const uint32_t tag =
+            ((nibbles >> (4 * k)) & 0xf) |
+            static_cast<uint32_t>((part & high_mask) << kLowBits);
+        const uint32_t mask = NibbleMultisets::SlotMask(entry.count, k);
+        tags[k] = tag & mask;
+        valid &= (tag | ~mask) != 0;
+      }
+      BucketTags<Table>::Write(table, i, tags);
+    }
+    return valid;
+  }
+
+  // Decode the streams blocks from block on, a bucket of each in turn.
+  // Returns false if one is corrupt.
+  template <size_t streams>
+  static bool DecodeBlocks(const char *string, const uint64_t *offsets,
+                           const CountEntry *entries, const size_t block,
+                           const size_t block_buckets, Table *table) {
+    const uint16_t *packed = NibbleMultisets::Shared().packed_;
+    const uint16_t *perm_codes = NibbleMultisets::Shared().perm_code_;
+    uint64_t positions[streams];
+    for (size_t s = 0; s < streams; s++) {
+      positions[s] = offsets[block + s];
+    }
+    bool valid = true;
+    for (size_t j = 0; j < block_buckets && valid; j++) {
+      // unrolled, so that the positions stay in registers
+#pragma GCC unroll 4
+      for (size_t s = 0; s < streams; s++) {
+        // a block must not pass the start of the next one
+        valid &= DecodeBucket(string, offsets[block + s + 1], entries, packed,
+                              perm_codes, &positions[s],
+                              (block + s) * block_buckets + j, table);
+      }
+    }
+    for (size_t s = 0; s < streams; s++) {
+      valid &= positions[s] == offsets[block + s + 1];
+    }
+    return valid;
+  }
+
+ public:
+  // Encode filter, whose writers must wait until this returns.
+  static std::vector<char> Encode(const Filter &filter);
+
+  // Decode data, which Encode returned for a filter of this type, into
+  // filter, replacing its table with one of the encoded size. Throws
+  // std::runtime_error if data is not such an encoding or is corrupt.
+  static void Decode(const char *data, const size_t size, Filter *filter);
+
+  static void Decode(const std::vector<char> &data, Filter *filter) {
+    Decode(data.data(), data.size(), filter);
+  }
+};
+
+template <typename Filter>
+std::vector<char> FilterCodec<Filter>::Encode(const Filter &filter) {
+  const Table &table = filter.table_;
+  const NibbleMultisets &multisets = NibbleMultisets::Shared();
+  const size_t num_buckets = table.NumBuckets();
+  const size_t block_buckets = BlockBuckets(num_buckets);
+  const size_t num_blocks = num_buckets / block_buckets;
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.bits_per_tag = kBitsPerTag;
+  header.tags_per_bucket = Table::kTagsPerBucket;
+  header.num_buckets = num_buckets;
+  header.hasher_size = sizeof(HashFamily);
+  header.alt_index_size = sizeof(AltIndexPolicy);
+  header.num_items = filter.num_items_;
+  header.victim_used = filter.victim_.used;
+  if (filter.victim_.used) {
+    header.victim_index = filter.victim_.index;
+    header.victim_tag = filter.victim_.tag;
+  }
+  uint64_t histogram[5] = {0, 0, 0, 0, 0};
+  table.OccupancyHistogram(histogram);
+  uint8_t lengths[5];
+  uint32_t codes[5];
+  CodeLengths(histogram, lengths);
+  Codes(lengths, codes);
+  memcpy(header.count_bits, lengths, sizeof(lengths));
+
+  // room for the longest bucket each
+  std::vector<char> out(sizeof(Header) + kPolicyBytes +
+                        num_blocks * sizeof(uint64_t) +
+                        (num_buckets * kBucketBits + 7) / 8 + kPadding);
+  memcpy(out.data() + sizeof(Header), &filter.hasher_, sizeof(HashFamily));
+  memcpy(out.data() + sizeof(Header) + sizeof(HashFamily), &filter.alt_index_,
+         sizeof(AltIndexPolicy));
+  char *offsets = out.data() + sizeof(Header) + kPolicyBytes;
+  char *string = offsets + num_blocks * sizeof(uint64_t);
+  BitWriter writer(string);
+  for (size_t i = 0; i < num_buckets; i++) {
+    if ((i & (block_buckets - 1)) == 0) {
+      const uint64_t offset = writer.NumBits(string);
+      memcpy(offsets + i / block_buckets * sizeof(offset), &offset,
+             sizeof(offset));
+    }
+    uint32_t tags[4];
+    BucketTags<Table>::Read(table, i, tags);
+    // sort the tags by their low bits, empty slots last, with a sorting
+    // network of keys that hold the low bits above the high ones
+    uint64_t keys[4];
+    for (size_t j = 0; j < 4; j++) {
+      const uint64_t empty = 0 - uint64_t(tags[j] == 0);
+      keys[j] = (uint64_t(tags[j] & 0xf) << 32) | (tags[j] >> 4) | empty;
+    }
+    static const int kNetwork[5][2] = {{0, 2}, {1, 3}, {0, 1}, {2, 3}, {1, 2}};
+    for (const auto &pair : kNetwork) {
+      const uint64_t a = keys[pair[0]], b = keys[pair[1]];
+      keys[pair[0]] = std::min(a, b);
+      keys[pair[1]] = std::max(a, b);
+    }
+    const size_t count = (tags[0] != 0) + (tags[1] != 0) + (tags[2] != 0) +
+                         (tags[3] != 0);
+    uint32_t nibbles = 0;
+    uint64_t high = 0;
+    for (size_t k = 0; k < 4; k++) {
+      nibbles |= ((keys[k] >> 32) & 0xf) << (4 * k);
+      const uint64_t part = keys[k] & NibbleMultisets::SlotMask(count, k);
+      high |= kOneLoad ? part << (k * kHighBits) : 0;
+    }
+    const uint64_t head =
+        codes[count] |
+        (uint64_t(multisets.Rank(nibbles, count)) << lengths[count]);
+    const size_t head_bits = lengths[count] + multisets.code_bits_[count];
+    if (kOneLoad) {
+      writer.Put(head | (high << head_bits), head_bits + count * kHighBits);
+    } else {
+      writer.Put(head, head_bits);
+      for (size_t k = 0; k < count; k++) {
+        writer.Put(keys[k] & 0xffffffff, kHighBits);
+      }
+    }
+  }
+  header.num_bits = writer.NumBits(string);
+  char *end = string + (header.num_bits + 7) / 8;
+  memset(end, 0, kPadding);
+  out.resize(end + kPadding - out.data());
+  header.checksum = Checksum(out.data() + sizeof(Header),
+                             out.size() - sizeof(Header));
+  memcpy(out.data(), &header, sizeof(header));
+  return out;
+}
+
+template <typename Filter>
+void FilterCodec<Filter>::Decode(const char *data, const size_t size,
+                                 Filter *filter) {
+  Header header;
+  if (size < sizeof(Header) + kPolicyBytes + kPadding) {
+    throw std::runtime_error("filter codec: not an encoded filter");
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != kMagic) {
+    throw std::runtime_error("filter codec: not an encoded filter");
+  }
+  uint32_t codes[5];
+  const uint64_t max_buckets = (1ULL << 32) / Table::kTagsPerBucket;
+  const size_t num_buckets = header.num_buckets;
+  const size_t block_buckets = BlockBuckets(num_buckets);
+  const size_t num_blocks = (num_buckets > 0) ? num_buckets / block_buckets : 0;
+  const char *mismatch =
+      header.version != kVersion ? "version"
+      : header.bits_per_tag != kBitsPerTag ? "tag size"
+      : header.tags_per_bucket != Table::kTagsPerBucket ? "tags per bucket"
+      : header.hasher_size != sizeof(HashFamily) ? "hash family"
+      : header.alt_index_size != sizeof(AltIndexPolicy)
+          ? "alternate index policy"
+      : header.num_buckets == 0 || header.num_buckets > max_buckets ||
+              (header.num_buckets & (header.num_buckets - 1)) != 0 ||
+              header.num_buckets > header.num_bits
+          ? "number of buckets"
+      : header.num_bits > 8 * size ||
+              size != sizeof(Header) + kPolicyBytes +
+                          num_blocks * sizeof(uint64_t) +
+                          (header.num_bits + 7) / 8 + kPadding
+          ? "size"
+      : !Codes(header.count_bits, codes) ? "code"
+      : Checksum(data + sizeof(Header), size - sizeof(Header)) !=
+              header.checksum
+          ? "checksum"
+          : nullptr;
+  if (mismatch != nullptr) {
+    throw std::runtime_error(std::string("filter codec: ") + mismatch +
+                             " differs");
+  }
+
+  const NibbleMultisets &multisets = NibbleMultisets::Shared();
+  CountEntry entries[1 << kMaxCountBits];
+  memset(entries, 0, sizeof(entries));
+  for (uint32_t count = 0; count < 5; count++) {
+    const uint32_t length = header.count_bits[count];
+    for (uint32_t x = 0; length > 0 && x < (1U << kMaxCountBits); x++) {
+      if ((x & ((1U << length) - 1)) == codes[count]) {
+        CountEntry &entry = entries[x];
+        entry.lanes = (count == 4) ? kLaneMask
+                                   : (1ULL << (count * kBitsPerTag % 64)) - 1;
+        entry.count = count;
+        entry.count_bits = length;
+        entry.rank_bits = multisets.code_bits_[count];
+        entry.bucket_bits =
+            length + multisets.code_bits_[count] + count * kHighBits;
+        entry.offset = multisets.offset_[count];
+        entry.size = multisets.size_[count];
+      }
+    }
+  }
+
+  // the start of each block, and the end of the last
+  std::vector<uint64_t> offsets(num_blocks + 1);
+  const char *index = data + sizeof(Header) + kPolicyBytes;
+  memcpy(offsets.data(), index, num_blocks * sizeof(uint64_t));
+  offsets[num_blocks] = header.num_bits;
+  bool valid = offsets[0] == 0;
+  for (size_t b = 0; b < num_blocks; b++) {
+    valid &= offsets[b] <= offsets[b + 1];
+  }
+  const char *string = index + num_blocks * sizeof(uint64_t);
+  Table table(num_buckets);
+  size_t block = 0;
+  for (; block + kCodecStreams <= num_blocks && valid;
+       block += kCodecStreams) {
+    valid = DecodeBlocks<kCodecStreams>(string, offsets.data(), entries,
+                                        block, block_buckets, &table);
+  }
+  for (; block < num_blocks && valid; block++) {
+    valid = DecodeBlocks<1>(string, offsets.data(), entries, block,
+                            block_buckets, &table);
+  }
+  if (!valid) {
+    throw std::runtime_error("filter codec: corrupt tags");
+  }
+
+  filter->table_ = std::move(table);
+  memcpy(&filter->hasher_, data + sizeof(Header), sizeof(HashFamily));
+  memcpy(&filter->alt_index_, data + sizeof(Header) + sizeof(HashFamily),
+         sizeof(AltIndexPolicy));
+  filter->num_items_ = header.num_items;
+  filter->victim_.used = header.victim_used != 0;
+  filter->victim_.index = header.victim_index;
+  filter->victim_.tag = header.victim_tag;
+}
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_FILTER_CODEC_H_
@@ -0,0 +1,303 @@
+#ifndef CUCKOO_FILTER_FILTER_STATS_H_
+#define CUCKOO_FILTER_FILTER_STATS_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <cmath>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace cuckoofilter {
+
+// Policies counting the operations of a CuckooFilter. NoStats, the default,
+// counts nothing and compiles to no code at all; ThreadStats keeps counters
+// per thread, so that threads of AddAll and concurrent readers do not share
+// cache lines.
+
+// number of bins of the kicks per add histogram: bin 0 counts adds without
+// kicks and bin b > 0 adds with [2^(b-1), 2^b) kicks, the last bin also
+// those with more
+const size_t kKickHistogramSize = 10;
+
+// where a lookup found its tag
+enum LookupResult {
+  kLookupMiss = 0,
+  kFirstBucketHit = 1,
+  kSecondBucketHit = 2,
+  kVictimHit = 3,
+};
+
+// Counters of a filter, summed over all threads
+struct FilterCounters {
+  // adds that stored the item, including those that ended in the victim cache
+  uint64_t adds;
+  // adds that returned NotEnoughSpace
+  uint64_t failed_adds;
+  // tags kicked out by all adds
+  uint64_t kicks;
+  uint64_t kick_histogram[kKickHistogramSize];
+  // adds whose last kicked out tag was left in the victim cache
+  uint64_t victim_stores;
+  uint64_t lookups;
+  uint64_t first_bucket_hits;
+  uint64_t second_bucket_hits;
+  uint64_t victim_hits;
+  uint64_t deletes;
+  // deletes that returned NotFound
+  uint64_t delete_misses;
+
+  FilterCounters() { memset(this, 0, sizeof(*this)); }
+};
+
+// most tags a bucket of any table holds
+const size_t kMaxBucketOccupancy = 4;
+
+// Expected false positive rate of a lookup that probes two random buckets of
+// a table with the given occupancy histogram: each tag in them matches with
+// probability 1 / (2^bits_per_tag - 1), as tags are never zero.
+inline double EstimateFpr(const uint64_t *occupancy,
+                          const size_t bits_per_tag) {
+  const double miss = 1.0 - 1.0 / (std::ldexp(1.0, bits_per_tag) - 1);
+  uint64_t num_buckets = 0;
+  double all_miss = 0;
+  for (size_t n = 0; n <= kMaxBucketOccupancy; n++) {
+    num_buckets += occupancy[n];
+    all_miss += occupancy[n] * std::pow(miss, n);
+  }
+  if (num_buckets == 0) {
+    return 0;
+  }
+  all_miss /= num_buckets;
+  return 1.0 - all_miss * all_miss;
+}
+
+// State of a filter, as returned by CuckooFilter::Stats
+struct FilterStats {
+  size_t num_items;
+  size_t num_buckets;
+  size_t bits_per_tag;
+  size_t size_in_bytes;
+  double load_factor;
+  // bits of table per item stored, 0 for an empty filter
+  double bits_per_item;
+  // occupancy[n]: number of buckets holding n tags
+  uint64_t occupancy[kMaxBucketOccupancy + 1];
+  bool victim_used;
+  size_t victim_index;
+  uint32_t victim_tag;
+  // see EstimateFpr; an upper bound for MortonTable, whose lookups often
+  // read one bucket only
+  double fpr_estimate;
+  FilterCounters counters;
+
+  FilterStats()
+      : num_items(0),
+        num_buckets(0),
+        bits_per_tag(0),
+        size_in_bytes(0),
+        load_factor(0),
+        bits_per_item(0),
+        victim_used(false),
+        victim_index(0),
+        victim_tag(0),
+        fpr_estimate(0) {
+    memset(occupancy, 0, sizeof(occupancy));
+  }
+
+  // one line of JSON, for scraping
+  std::string ToJson() const {
+    std::stringstream ss;
+    ss.precision(8);
+    ss << "{\"num_items\":" << num_items << ",\"num_buckets\":" << num_buckets
+       << ",\"bits_per_tag\":" << bits_per_tag
+       << ",\"size_in_bytes\":" << size_in_bytes
+       << ",\"load_factor\":" << load_factor
+       << ",\"bits_per_item\":" << bits_per_item << ",\"occupancy\":[";
+    for (size_t n = 0; n <= kMaxBucketOccupancy; n++) {
+      ss << (n ? "," : "") << occupancy[n];
+    }
+    ss << "],\"victim\":{\"used\":" << (victim_used ? "true" : "false")
+       << ",\"index\":" << victim_index << ",\"tag\":" << victim_tag
+       << "},\"fpr_estimate\":" << fpr_estimate << ",\"counters\":{"
+       << "\"adds\":" << counters.adds
+       << ",\"failed_adds\":" << counters.failed_adds
+       << ",\"kicks\":" << counters.kicks << ",\"kick_histogram\":[";
+    for (size_t b = 0; b < kKickHistogramSize; b++) {
+      ss << (b ? "," : "") << counters.kick_histogram[b];
+    }
+    ss << "],\"victim_stores\":" << counters.victim_stores
+       << ",\"lookups\":" << counters.lookups
+       << ",\"first_bucket_hits\":" << counters.first_bucket_hits
+       << ",\"second_bucket_hits\":" << counters.second_bucket_hits
+       << ",\"victim_hits\":" << counters.victim_hits
+       << ",\"deletes\":" << counters.deletes
+       << ",\"delete_misses\":" << counters.delete_misses << "}}";
+    return ss.str();
+  }
+};
+
+class NoStats {
+ public:
+  static const bool kEnabled = false;
+
+  void OnAdd(const size_t /* kicks */) {}
+  void OnFailedAdd() {}
+  void OnVictimStore() {}
+  void OnLookup(const LookupResult /* result */) {}
+  void OnDelete(const bool /* found */) {}
+
+  FilterCounters Snapshot() const { return FilterCounters(); }
+  void Reset() {}
+};
+
+class ThreadStats {
+  // counters of the threads given a slot, on cache lines of their own
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> adds;
+    std::atomic<uint64_t> failed_adds;
+    std::atomic<uint64_t> kicks;
+    std::atomic<uint64_t> kick_histogram[kKickHistogramSize];
+    std::atomic<uint64_t> victim_stores;
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> hits[4];  // indexed by LookupResult
+    std::atomic<uint64_t> deletes;
+    std::atomic<uint64_t> delete_misses;
+  };
+
+  // threads beyond this many share slots
+  static const size_t kMaxSlots = 64;
+
+  Slot *slots_;
+
+  // Slots are handed out round robin and never given back, so threads
+  // that run at once may share one, e.g. after AddAll started more than
+  // kMaxSlots threads in total. Each slot is on a cache line of its own, so
+  // the atomic add is rarely contended.
+  static inline void Bump(std::atomic<uint64_t> &counter,
+                          const uint64_t n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  static inline uint64_t Load(const std::atomic<uint64_t> &counter) {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  static size_t ThreadSlot() {
+    static std::atomic<size_t> num_threads(0);
+    thread_local size_t slot = num_threads.fetch_add(1) % kMaxSlots;
+    return slot;
+  }
+
+  inline Slot &Local() const { return slots_[ThreadSlot()]; }
+
+  static inline size_t KickBin(size_t kicks) {
+    size_t bin = 0;
+    for (; kicks > 0 && bin + 1 < kKickHistogramSize; kicks >>= 1) {
+      bin++;
+    }
+    return bin;
+  }
+
+ public:
+  static const bool kEnabled = true;
+
+  ThreadStats() {
+    if (posix_memalign(reinterpret_cast<void **>(&slots_), alignof(Slot),
+                       kMaxSlots * sizeof(Slot)) != 0) {
+      throw std::bad_alloc();
+    }
+    for (size_t i = 0; i < kMaxSlots; i++) {
+      new (&slots_[i]) Slot();
+    }
+    Reset();
+  }
+
+  ThreadStats(ThreadStats &&other) noexcept : slots_(other.slots_) {
+    other.slots_ = nullptr;
+  }
+
+  ThreadStats &operator=(ThreadStats &&other) noexcept {
+    std::swap(slots_, other.slots_);
+    return *this;
+  }
+
+  ThreadStats(const ThreadStats &) = delete;
+  ThreadStats &operator=(const ThreadStats &) = delete;
+
+  ~ThreadStats() { free(slots_); }
+
+  void OnAdd(const size_t kicks) {
+    Slot &slot = Local();
+    Bump(slot.adds);
+    Bump(slot.kicks, kicks);
+    Bump(slot.kick_histogram[KickBin(kicks)]);
+  }
+
+  void OnFailedAdd() { Bump(Local().failed_adds); }
+
+  void OnVictimStore() { Bump(Local().victim_stores); }
+
+  void OnLookup(const LookupResult result) {
+    Slot &slot = Local();
+    Bump(slot.lookups);
+    Bump(slot.hits[result]);
+  }
+
+  void OnDelete(const bool found) {
+    Slot &slot = Local();
+    Bump(slot.deletes);
+    if (!found) {
+      Bump(slot.delete_misses);
+    }
+  }
+
+  // Sum of the counters of all threads. Counts of operations running
+  // meanwhile may or may not be included.
+  FilterCounters Snapshot() const {
+    FilterCounters result;
+    for (size_t i = 0; i < kMaxSlots; i++) {
+      const Slot &slot = slots_[i];
+      result.adds += Load(slot.adds);
+      result.failed_adds += Load(slot.failed_adds);
+      result.kicks += Load(slot.kicks);
+      for (size_t b = 0; b < kKickHistogramSize; b++) {
+        result.kick_histogram[b] += Load(slot.kick_histogram[b]);
+      }
+      result.victim_stores += Load(slot.victim_stores);
+      result.lookups += Load(slot.lookups);
+      result.first_bucket_hits += Load(slot.hits[kFirstBucketHit]);
+      result.second_bucket_hits += Load(slot.hits[kSecondBucketHit]);
+      result.victim_hits += Load(slot.hits[kVictimHit]);
+      result.deletes += Load(slot.deletes);
+      result.delete_misses += Load(slot.delete_misses);
+    }
+    return result;
+  }
+
+  void Reset() {
+    for (size_t i = 0; i < kMaxSlots; i++) {
+      Slot &slot = slots_[i];
+      slot.adds = 0;
+      slot.failed_adds = 0;
+      slot.kicks = 0;
+      for (size_t b = 0; b < kKickHistogramSize; b++) {
+        slot.kick_histogram[b] = 0;
+      }
+      slot.victim_stores = 0;
+      slot.lookups = 0;
+      for (size_t h = 0; h < 4; h++) {
+        slot.hits[h] = 0;
+      }
+      slot.deletes = 0;
+      slot.delete_misses = 0;
+    }
+  }
+};
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_FILTER_STATS_H_
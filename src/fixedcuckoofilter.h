@@ -0,0 +1,271 @@
+#ifndef CUCKOO_FILTER_FIXED_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_FIXED_CUCKOO_FILTER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+
+#include "cuckoofilter.h"
+
+namespace cuckoofilter {
+
+// smallest power of two no less than x, for sizes known at compile time
+constexpr size_t FixedUpperPower2(const size_t x, const size_t p = 1) {
+  return p >= x ? p : FixedUpperPower2(x, p << 1);
+}
+
+// number of buckets of assoc tags for max_num_keys at up to 96% load, the
+// same as CuckooFilter(max_num_keys) has
+constexpr size_t FixedNumBuckets(const size_t max_num_keys,
+                                 const size_t assoc,
+                                 const size_t num_buckets) {
+  return (max_num_keys * 100 > 96 * assoc * num_buckets) ? 2 * num_buckets
+                                                          : num_buckets;
+}
+
+constexpr size_t FixedNumBuckets(const size_t max_num_keys,
+                                 const size_t assoc) {
+  return FixedNumBuckets(
+      max_num_keys, assoc,
+      FixedUpperPower2(max_num_keys / assoc > 0 ? max_num_keys / assoc : 1));
+}
+
+// A cuckoo filter for up to capacity items, meant for many small filters,
+// such as one per document. All sizes are compile-time constants, the
+// buckets are an array inside the object, and all filters share one hasher
+// of HashFamily, seeded once per process. Constructing a filter allocates
+// nothing and only zeroes its buckets, so filters can live on the stack or
+// inside other objects, and be copied with memcpy.
+//
+// Buckets hold four bits_per_item tags, packed without padding, and are
+// sized like those of CuckooFilter(capacity). Lookups find the same items,
+// with the same false positive rate, as CuckooFilter<ItemType,
+// bits_per_item> over the same hash family.
+template <size_t capacity, size_t bits_per_item, typename ItemType = uint64_t,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type>
+class FixedCuckooFilter {
+  static_assert(capacity > 0, "capacity must be positive");
+  static_assert(bits_per_item >= 2 && bits_per_item <= 32,
+                "tags must have 2 to 32 bits");
+
+ public:
+  static const size_t kTagsPerBucket = 4;
+
+  // a power of two
+  static const size_t kNumBuckets = FixedNumBuckets(capacity, kTagsPerBucket);
+
+ private:
+  static const size_t kNumSlots = kNumBuckets * kTagsPerBucket;
+  static const uint32_t kTagMask = (1ULL << bits_per_item) - 1;
+  static const size_t kBucketBits = bits_per_item * kTagsPerBucket;
+  // Tags and buckets are read as the 8 bytes from the byte they start in, so
+  // one more word keeps the reads of the last ones inside words_.
+  static const size_t kNumWords = (kNumSlots * bits_per_item + 63) / 64 + 1;
+  // whether a whole bucket fits in such a read, after the shift to its
+  // first bit, which is 0 or 4 as kBucketBits is a multiple of 4
+  static const bool kSwarBuckets = kBucketBits + kBucketBits % 8 <= 64;
+  static const uint64_t kBucketMask =
+      kBucketBits >= 64 ? ~0ULL : (1ULL << (kBucketBits % 64)) - 1;
+  // the lowest and the highest bit of each tag of a bucket
+  static const uint64_t kLowBits =
+      1ULL | (1ULL << (bits_per_item % 64)) |
+      (1ULL << ((2 * bits_per_item) % 64)) |
+      (1ULL << ((3 * bits_per_item) % 64));
+  static const uint64_t kHighBits = kLowBits << (bits_per_item - 1);
+
+  std::array<uint64_t, kNumWords> words_;
+  uint32_t num_items_;
+
+  struct {
+    uint32_t index;
+    uint32_t tag;
+    bool used;
+  } victim_;
+
+  static const HashFamily &Hasher() {
+    static const HashFamily hasher;
+    return hasher;
+  }
+
+  // Filters share the generator of their thread, which keeps them small
+  // and threads from contending for libc rand().
+  static WyRand &Random() {
+    thread_local WyRand random;
+    return random;
+  }
+
+  // the 64 bits from bit on, of which at least 57 are valid
+  inline uint64_t ReadBits(const size_t bit) const {
+    uint64_t v;
+    memcpy(&v, reinterpret_cast<const char *>(words_.data()) + bit / 8,
+           sizeof(v));
+    return v >> (bit % 8);
+  }
+
+  inline uint32_t ReadTag(const size_t slot) const {
+    return ReadBits(slot * bits_per_item) & kTagMask;
+  }
+
+  inline void WriteTag(const size_t slot, const uint32_t tag) {
+    const size_t bit = slot * bits_per_item;
+    char *p = reinterpret_cast<char *>(words_.data()) + bit / 8;
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    v = (v & ~(static_cast<uint64_t>(kTagMask) << (bit % 8))) |
+        (static_cast<uint64_t>(tag) << (bit % 8));
+    memcpy(p, &v, sizeof(v));
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
+    if (kSwarBuckets) {
+      // a tag equal to tag becomes zero, which sets its high bit here
+      const uint64_t v =
+          (ReadBits(i * kBucketBits) & kBucketMask) ^ (tag * kLowBits);
+      return ((v - kLowBits) & ~v & kHighBits) != 0;
+    }
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i * kTagsPerBucket + j) == tag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i * kTagsPerBucket + j) == tag) {
+        WriteTag(i * kTagsPerBucket + j, 0);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
+                                const bool kickout, uint32_t &oldtag) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i * kTagsPerBucket + j) == 0) {
+        WriteTag(i * kTagsPerBucket + j, tag);
+        return true;
+      }
+    }
+    if (kickout) {
+      const size_t r = i * kTagsPerBucket + Random().Below(kTagsPerBucket);
+      oldtag = ReadTag(r);
+      WriteTag(r, tag);
+    }
+    return false;
+  }
+
+  // same index, tag and alternate bucket as CuckooFilter
+  static inline void IndexTagFromHash(const uint64_t hash, size_t *index,
+                                      uint32_t *tag) {
+    *index = (hash >> 32) & (kNumBuckets - 1);
+    *tag = hash & kTagMask;
+    *tag += (*tag == 0);
+  }
+
+  static inline size_t AltIndex(const size_t index, const uint32_t tag) {
+    return XorAltIndex()(index, tag, kNumBuckets);
+  }
+
+  // the kick chain of CuckooFilter::AddImpl
+  void AddImpl(size_t curindex, uint32_t curtag) {
+    for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
+      const bool kickout = count > 0;
+      uint32_t oldtag = 0;
+      if (InsertTagToBucket(curindex, curtag, kickout, oldtag)) {
+        num_items_++;
+        return;
+      }
+      if (kickout) {
+        curtag = oldtag;
+      }
+      curindex = AltIndex(curindex, curtag);
+    }
+    victim_.index = curindex;
+    victim_.tag = curtag;
+    victim_.used = true;
+  }
+
+ public:
+  FixedCuckooFilter() : num_items_(0) {
+    words_.fill(0);
+    victim_.used = false;
+  }
+
+  // Add an item to the filter.
+  Status Add(const ItemType &item) { return AddHash(Hasher()(item)); }
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const {
+    return ContainHash(Hasher()(item));
+  }
+
+  // Delete an key from the filter
+  Status Delete(const ItemType &item) { return DeleteHash(Hasher()(item)); }
+
+  // Add, Contain and Delete of a uniform 64-bit hash, see CuckooFilter
+  Status AddHash(const uint64_t hash) {
+    if (victim_.used) {
+      return NotEnoughSpace;
+    }
+    size_t i;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i, &tag);
+    AddImpl(i, tag);
+    return Ok;
+  }
+
+  Status ContainHash(const uint64_t hash) const {
+    size_t i1;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = AltIndex(i1, tag);
+    const bool found = victim_.used && (tag == victim_.tag) &&
+                       (i1 == victim_.index || i2 == victim_.index);
+    if (found || FindTagInBucket(i1, tag) || FindTagInBucket(i2, tag)) {
+      return Ok;
+    }
+    return NotFound;
+  }
+
+  Status DeleteHash(const uint64_t hash) {
+    size_t i1;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = AltIndex(i1, tag);
+    if (DeleteTagFromBucket(i1, tag) || DeleteTagFromBucket(i2, tag)) {
+      num_items_--;
+      if (victim_.used) {
+        // a slot was freed, so try to put the victim back
+        victim_.used = false;
+        AddImpl(victim_.index, victim_.tag);
+      }
+      return Ok;
+    }
+    if (victim_.used && tag == victim_.tag &&
+        (i1 == victim_.index || i2 == victim_.index)) {
+      victim_.used = false;
+      return Ok;
+    }
+    return NotFound;
+  }
+
+  // empty the filter
+  void Clear() {
+    words_.fill(0);
+    num_items_ = 0;
+    victim_.used = false;
+  }
+
+  /* methods for providing stats  */
+  // number of current inserted items
+  size_t Size() const { return num_items_; }
+
+  // size of the buckets in bytes
+  size_t SizeInBytes() const { return sizeof(words_); }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_FIXED_CUCKOO_FILTER_H_
@@ -3,13 +3,23 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <type_traits>
 
 #include <openssl/evp.h>
 #include <random>
 
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+#include <immintrin.h>
+#endif
+
 namespace cuckoofilter {
 
 class HashUtil {
@@ -64,6 +74,53 @@ class TwoIndependentMultiplyShift {
   uint64_t operator()(uint64_t key) const {
     return (add_ + multiply_ * static_cast<decltype(multiply_)>(key)) >> 64;
   }
+
+  // Same as hashes[i] = (*this)(keys[i]) for i in [0, n). With AVX-512, the
+  // products are put together from vector multiplies, 8 keys at a time:
+  //   hash = hi(key * m0) + lo(key * m1) + a1 + carry(lo(key * m0) + a0)
+  // where m1:m0 = multiply_, a1:a0 = add_, and hi(key * m0) comes from four
+  // 32x32-bit products. AVX2 lacks the 64-bit multiply, and emulating it is
+  // slower than scalar mulx, so other targets hash one key at a time.
+  void HashMany(const uint64_t *keys, const size_t n, uint64_t *hashes) const {
+    size_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+    {
+      const __m512i low32 = _mm512_set1_epi64(0xffffffffULL);
+      const __m512i m0 = _mm512_set1_epi64(static_cast<uint64_t>(multiply_));
+      const __m512i m0_high = _mm512_srli_epi64(m0, 32);
+      const __m512i m1 =
+          _mm512_set1_epi64(static_cast<uint64_t>(multiply_ >> 64));
+      const __m512i a0 = _mm512_set1_epi64(static_cast<uint64_t>(add_));
+      const __m512i a1 = _mm512_set1_epi64(static_cast<uint64_t>(add_ >> 64));
+      const __m512i one = _mm512_set1_epi64(1);
+      for (; i + 8 <= n; i += 8) {
+        const __m512i key = _mm512_loadu_si512(keys + i);
+        const __m512i key_high = _mm512_srli_epi64(key, 32);
+        const __m512i ll = _mm512_mul_epu32(key, m0);
+        const __m512i lh = _mm512_mul_epu32(key, m0_high);
+        const __m512i hl = _mm512_mul_epu32(key_high, m0);
+        const __m512i hh = _mm512_mul_epu32(key_high, m0_high);
+        const __m512i mid = _mm512_add_epi64(
+            _mm512_add_epi64(_mm512_srli_epi64(ll, 32),
+                             _mm512_and_si512(lh, low32)),
+            _mm512_and_si512(hl, low32));
+        const __m512i lo = _mm512_add_epi64(_mm512_mullo_epi64(key, m0), a0);
+        __m512i hash = _mm512_add_epi64(
+            _mm512_add_epi64(hh, _mm512_srli_epi64(mid, 32)),
+            _mm512_add_epi64(_mm512_srli_epi64(lh, 32),
+                             _mm512_srli_epi64(hl, 32)));
+        hash = _mm512_add_epi64(
+            hash, _mm512_add_epi64(_mm512_mullo_epi64(key, m1), a1));
+        hash = _mm512_mask_add_epi64(hash, _mm512_cmplt_epu64_mask(lo, a0),
+                                     hash, one);
+        _mm512_storeu_si512(hashes + i, hash);
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      hashes[i] = (*this)(keys[i]);
+    }
+  }
 };
 
 // See Patrascu and Thorup's "The Power of Simple Tabulation Hashing"
@@ -87,6 +144,293 @@ class SimpleTabulation {
     }
     return result;
   }
+
+  // Same as hashes[i] = (*this)(keys[i]) for i in [0, n). The tables fit in
+  // L1, and AVX2 or AVX-512 gathers of them are no faster than scalar loads.
+  void HashMany(const uint64_t *keys, const size_t n, uint64_t *hashes) const {
+    for (size_t i = 0; i < n; i++) {
+      hashes[i] = (*this)(keys[i]);
+    }
+  }
+};
+
+// The bytes a key is hashed from by byte-string hash families such as
+// WyHash. Keys of trivially copyable types are hashed from their object
+// representation, so types with padding need their own specialization.
+template <typename T>
+struct ItemBytes {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "specialize ItemBytes for this key type");
+  static const void *Data(const T &item) { return &item; }
+  static size_t Size(const T &) { return sizeof(T); }
+};
+
+template <>
+struct ItemBytes<std::string> {
+  static const void *Data(const std::string &item) { return item.data(); }
+  static size_t Size(const std::string &item) { return item.size(); }
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct ItemBytes<std::string_view> {
+  static const void *Data(const std::string_view &item) {
+    return item.data();
+  }
+  static size_t Size(const std::string_view &item) { return item.size(); }
+};
+#endif
+
+// For keys that are already uniform hashes, such as 64-bit hashes computed
+// upstream or digests from HashUtil::SHA1Hash: a key is its own hash, and
+// keys of more than 8 bytes are cut to their first 8 bytes.
+class IdentityHash {
+ public:
+  uint64_t operator()(const uint64_t key) const { return key; }
+
+  template <typename ItemType>
+  uint64_t operator()(const ItemType &item) const {
+    uint64_t hash = 0;
+    memcpy(&hash, ItemBytes<ItemType>::Data(item),
+           std::min(sizeof(hash), ItemBytes<ItemType>::Size(item)));
+    return hash;
+  }
+
+  void HashMany(const uint64_t *keys, const size_t n, uint64_t *hashes) const {
+    memcpy(hashes, keys, n * sizeof(uint64_t));
+  }
+};
+
+// A seeded 64-bit hash of byte strings after Wang Yi's wyhash (final
+// version 4). Keys of up to 16 bytes take a single 128-bit multiplication
+// in the final mix, and longer keys one more per 16 bytes.
+class WyHash {
+  static const uint64_t kSecret0 = 0x2d358dccaa6c78a5ULL;
+  static const uint64_t kSecret1 = 0x8bb84b93962eacc9ULL;
+  static const uint64_t kSecret2 = 0x4b33a62ed433d4a3ULL;
+  static const uint64_t kSecret3 = 0x4d5a2da51de1aa47ULL;
+
+  uint64_t seed_;
+
+  static inline void Multiply(uint64_t *a, uint64_t *b) {
+    const unsigned __int128 r = static_cast<unsigned __int128>(*a) * *b;
+    *a = static_cast<uint64_t>(r);
+    *b = static_cast<uint64_t>(r >> 64);
+  }
+
+  static inline uint64_t Mix(uint64_t a, uint64_t b) {
+    Multiply(&a, &b);
+    return a ^ b;
+  }
+
+  static inline uint64_t Read8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline uint64_t Read4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+ public:
+  WyHash() {
+    ::std::random_device random;
+    seed_ = random() | (static_cast<uint64_t>(random()) << 32);
+    seed_ ^= Mix(seed_ ^ kSecret0, kSecret1);
+  }
+
+  // a fixed seed, for hashes that must agree between processes, such as
+  // checksums in files
+  explicit WyHash(const uint64_t seed)
+      : seed_(seed ^ Mix(seed ^ kSecret0, kSecret1)) {}
+
+  uint64_t operator()(const void *buf, size_t length) const {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    uint64_t seed = seed_;
+    uint64_t a, b;
+    if (length <= 16) {
+      if (length >= 4) {
+        a = (Read4(p) << 32) | Read4(p + ((length >> 3) << 2));
+        b = (Read4(p + length - 4) << 32) |
+            Read4(p + length - 4 - ((length >> 3) << 2));
+      } else if (length > 0) {
+        a = (static_cast<uint64_t>(p[0]) << 16) |
+            (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+        b = 0;
+      } else {
+        a = b = 0;
+      }
+    } else {
+      size_t i = length;
+      if (i >= 48) {
+        uint64_t seed1 = seed, seed2 = seed;
+        do {
+          seed = Mix(Read8(p) ^ kSecret1, Read8(p + 8) ^ seed);
+          seed1 = Mix(Read8(p + 16) ^ kSecret2, Read8(p + 24) ^ seed1);
+          seed2 = Mix(Read8(p + 32) ^ kSecret3, Read8(p + 40) ^ seed2);
+          p += 48;
+          i -= 48;
+        } while (i >= 48);
+        seed ^= seed1 ^ seed2;
+      }
+      while (i > 16) {
+        seed = Mix(Read8(p) ^ kSecret1, Read8(p + 8) ^ seed);
+        p += 16;
+        i -= 16;
+      }
+      a = Read8(p + i - 16);
+      b = Read8(p + i - 8);
+    }
+    a ^= kSecret1;
+    b ^= seed;
+    Multiply(&a, &b);
+    return Mix(a ^ kSecret0 ^ length, b ^ kSecret1);
+  }
+
+  template <typename ItemType>
+  uint64_t operator()(const ItemType &item) const {
+    return (*this)(ItemBytes<ItemType>::Data(item),
+                   ItemBytes<ItemType>::Size(item));
+  }
+};
+
+// Hashes items[0, n) into hashes[0, n), with HashFamily::HashMany where the
+// family has one for the item type.
+template <typename HashFamily, typename ItemType>
+inline void HashItems(const HashFamily &hasher, const ItemType *items,
+                      const size_t n, uint64_t *hashes) {
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = hasher(items[i]);
+  }
+}
+
+inline void HashItems(const TwoIndependentMultiplyShift &hasher,
+                      const uint64_t *items, const size_t n,
+                      uint64_t *hashes) {
+  hasher.HashMany(items, n, hashes);
+}
+
+inline void HashItems(const SimpleTabulation &hasher, const uint64_t *items,
+                      const size_t n, uint64_t *hashes) {
+  hasher.HashMany(items, n, hashes);
+}
+
+inline void HashItems(const IdentityHash &hasher, const uint64_t *items,
+                      const size_t n, uint64_t *hashes) {
+  hasher.HashMany(items, n, hashes);
+}
+
+// SipHash by Aumasson and Bernstein, a pseudorandom function keyed with a
+// random 128-bit secret: unlike multiply-shift, its outputs do not give the
+// secret away, so keys that collide in a filter cannot be crafted without
+// it. c and d are the numbers of compression and finalization rounds.
+template <int c, int d>
+class SipHash {
+  uint64_t k0_, k1_;
+
+  static inline uint64_t Rotate(const uint64_t x, const int b) {
+    return (x << b) | (x >> (64 - b));
+  }
+
+  static inline void Round(uint64_t *v) {
+    v[0] += v[1];
+    v[1] = Rotate(v[1], 13);
+    v[1] ^= v[0];
+    v[0] = Rotate(v[0], 32);
+    v[2] += v[3];
+    v[3] = Rotate(v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = Rotate(v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = Rotate(v[1], 17);
+    v[1] ^= v[2];
+    v[2] = Rotate(v[2], 32);
+  }
+
+  inline void Init(uint64_t *v) const {
+    v[0] = k0_ ^ 0x736f6d6570736575ULL;
+    v[1] = k1_ ^ 0x646f72616e646f6dULL;
+    v[2] = k0_ ^ 0x6c7967656e657261ULL;
+    v[3] = k1_ ^ 0x7465646279746573ULL;
+  }
+
+  static inline void Compress(uint64_t *v, const uint64_t m) {
+    v[3] ^= m;
+    for (int i = 0; i < c; i++) {
+      Round(v);
+    }
+    v[0] ^= m;
+  }
+
+  static inline uint64_t Finalize(uint64_t *v) {
+    v[2] ^= 0xff;
+    for (int i = 0; i < d; i++) {
+      Round(v);
+    }
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+  }
+
+ public:
+  SipHash() {
+    ::std::random_device random;
+    k0_ = random() | (static_cast<uint64_t>(random()) << 32);
+    k1_ = random() | (static_cast<uint64_t>(random()) << 32);
+  }
+
+  SipHash(const uint64_t k0, const uint64_t k1) : k0_(k0), k1_(k1) {}
+
+  uint64_t operator()(const void *buf, const size_t length) const {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    uint64_t v[4];
+    Init(v);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      uint64_t m;
+      memcpy(&m, p + i, sizeof(m));
+      Compress(v, m);
+    }
+    uint64_t last = static_cast<uint64_t>(length) << 56;
+    for (size_t j = 0; i + j < length; j++) {
+      last |= static_cast<uint64_t>(p[i + j]) << (8 * j);
+    }
+    Compress(v, last);
+    return Finalize(v);
+  }
+
+  // same as hashing the 8 bytes of key
+  uint64_t operator()(const uint64_t key) const {
+    uint64_t v[4];
+    Init(v);
+    Compress(v, key);
+    Compress(v, 8ULL << 56);
+    return Finalize(v);
+  }
+
+  template <typename ItemType>
+  uint64_t operator()(const ItemType &item) const {
+    return (*this)(ItemBytes<ItemType>::Data(item),
+                   ItemBytes<ItemType>::Size(item));
+  }
+};
+
+// The fast variant recommended for hash tables
+typedef SipHash<1, 3> SipHash13;
+
+// The hash family filters use unless told otherwise: multiply-shift for
+// integer keys, and WyHash over the bytes of any other key.
+template <typename ItemType, bool = std::is_integral<ItemType>::value>
+struct DefaultHashFamily {
+  typedef TwoIndependentMultiplyShift type;
+};
+
+template <typename ItemType>
+struct DefaultHashFamily<ItemType, false> {
+  typedef WyHash type;
 };
 }
 
@@ -0,0 +1,173 @@
+#ifndef CUCKOO_FILTER_INTERLEAVE_H_
+#define CUCKOO_FILTER_INTERLEAVE_H_
+
+// Coroutines to interleave lookups, in the style of asynchronous memory
+// access chaining: a lookup prefetches its buckets and suspends, and a
+// scheduler runs other lookups while the cache lines arrive. Only available
+// when compiled as C++20, where CUCKOO_FILTER_COROUTINES is defined.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && \
+    defined(__has_include)
+#if __has_include(<coroutine>)
+#define CUCKOO_FILTER_COROUTINES 1
+#endif
+#endif
+
+#ifdef CUCKOO_FILTER_COROUTINES
+
+#include <stddef.h>
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+
+namespace cuckoofilter {
+
+// Recycles coroutine frames of one thread, as a task that is spawned per
+// lookup would otherwise spend more time in malloc and free than probing.
+// Frames are kept per size, which is the same for all tasks of a coroutine.
+class FramePool {
+  struct FreeFrame {
+    FreeFrame *next;
+  };
+
+  // size classes of 16 bytes, up to kMaxPooledBytes
+  static const size_t kMaxPooledBytes = 1024;
+
+  static FreeFrame *&FreeList(const size_t size) {
+    thread_local FreeFrame *free_lists[kMaxPooledBytes / 16 + 1] = {};
+    return free_lists[(size + 15) / 16];
+  }
+
+ public:
+  static void *Allocate(const size_t size) {
+    if (size <= kMaxPooledBytes) {
+      FreeFrame *&head = FreeList(size);
+      if (head != nullptr) {
+        FreeFrame *frame = head;
+        head = frame->next;
+        return frame;
+      }
+      return ::operator new((size + 15) / 16 * 16);
+    }
+    return ::operator new(size);
+  }
+
+  static void Free(void *p, const size_t size) {
+    if (size <= kMaxPooledBytes) {
+      FreeFrame *frame = static_cast<FreeFrame *>(p);
+      FreeFrame *&head = FreeList(size);
+      frame->next = head;
+      head = frame;
+      return;
+    }
+    ::operator delete(p);
+  }
+};
+
+// A coroutine that does one piece of work, such as handling a request, and
+// may co_await CuckooFilter::ContainAsync. It does not start before a
+// RoundRobinScheduler runs it.
+class LookupTask {
+ public:
+  struct promise_type {
+    LookupTask get_return_object() {
+      return LookupTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(const size_t size) {
+      return FramePool::Allocate(size);
+    }
+    static void operator delete(void *p, const size_t size) {
+      FramePool::Free(p, size);
+    }
+  };
+
+  LookupTask(LookupTask &&other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  LookupTask(const LookupTask &) = delete;
+  LookupTask &operator=(const LookupTask &) = delete;
+
+  ~LookupTask() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  // hand the coroutine over to the caller, who must destroy it
+  std::coroutine_handle<> Release() { return std::exchange(handle_, nullptr); }
+
+ private:
+  explicit LookupTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Runs up to width tasks at a time, resuming them in turn: each resume runs
+// a task up to its next co_await, by which time the buckets it prefetched
+// before its previous one have had width - 1 resumes to arrive.
+class RoundRobinScheduler {
+  size_t width_;
+  std::vector<std::coroutine_handle<>> in_flight_;
+  size_t next_;
+
+ public:
+  explicit RoundRobinScheduler(const size_t width)
+      : width_(width > 0 ? width : 1), next_(0) {
+    in_flight_.reserve(width_);
+  }
+
+  RoundRobinScheduler(const RoundRobinScheduler &) = delete;
+  RoundRobinScheduler &operator=(const RoundRobinScheduler &) = delete;
+
+  ~RoundRobinScheduler() { Drain(); }
+
+  // Add a task, first running the others until fewer than width are left.
+  void Spawn(LookupTask task) {
+    while (in_flight_.size() >= width_) {
+      Step();
+    }
+    in_flight_.push_back(task.Release());
+  }
+
+  // Resume the next task, and retire it if it is done.
+  void Step() {
+    if (in_flight_.empty()) {
+      return;
+    }
+    std::coroutine_handle<> handle = in_flight_[next_];
+    handle.resume();
+    if (handle.done()) {
+      handle.destroy();
+      in_flight_[next_] = in_flight_.back();
+      in_flight_.pop_back();
+    } else {
+      next_++;
+    }
+    if (next_ >= in_flight_.size()) {
+      next_ = 0;
+    }
+  }
+
+  // Run all tasks to completion.
+  void Drain() {
+    while (!in_flight_.empty()) {
+      Step();
+    }
+  }
+
+  size_t NumInFlight() const { return in_flight_.size(); }
+};
+
+}  // namespace cuckoofilter
+
+#endif  // CUCKOO_FILTER_COROUTINES
+#endif  // CUCKOO_FILTER_INTERLEAVE_H_
@@ -0,0 +1,255 @@
+#ifndef CUCKOO_FILTER_IO_RING_H_
+#define CUCKOO_FILTER_IO_RING_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <system_error>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define CUCKOO_FILTER_IO_URING 1
+#endif
+#endif
+
+namespace cuckoofilter {
+
+// a block of a file to read into buffer, or write from it
+struct IoRequest {
+  char *buffer;
+  size_t size;
+  uint64_t offset;
+};
+
+// Reads and writes many blocks of a file with up to depth of them in flight
+// at once, so that an SSD, which serves random reads in parallel, has its
+// queue full. On Linux this is an io_uring, driven through the system calls
+// without liburing; where io_uring is missing or not permitted, the blocks
+// are transferred one at a time with pread and pwrite. Not thread-safe.
+class IoRing {
+  unsigned depth_;
+  // -1 if pread and pwrite are used
+  int ring_fd_;
+#ifdef CUCKOO_FILTER_IO_URING
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  io_uring_sqe *sqes_;
+  size_t sqes_size_;
+  unsigned *sq_head_, *sq_tail_, *sq_mask_, *sq_array_;
+  unsigned *cq_head_, *cq_tail_, *cq_mask_;
+  io_uring_cqe *cqes_;
+
+  // map the rings of ring_fd_, or return false
+  bool MapRings(const io_uring_params &params) {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+      sq_ring_size_ = cq_ring_size_ =
+          sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      return false;
+    }
+    cq_ring_ = single ? sq_ring_
+                      : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring_fd_,
+                             IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+      return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      if (!single) {
+        munmap(cq_ring_, cq_ring_size_);
+      }
+      munmap(sq_ring_, sq_ring_size_);
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+    char *sq = static_cast<char *>(sq_ring_);
+    char *cq = static_cast<char *>(cq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+#endif
+
+  [[noreturn]] static void ThrowError(const int error, const char *what) {
+    throw std::system_error(error, std::generic_category(), what);
+  }
+
+ public:
+  explicit IoRing(const unsigned depth) : depth_(depth), ring_fd_(-1) {
+#ifdef CUCKOO_FILTER_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, depth, &params);
+    if (fd < 0) {
+      return;
+    }
+    ring_fd_ = fd;
+    if (!MapRings(params)) {
+      close(ring_fd_);
+      ring_fd_ = -1;
+    }
+#endif
+  }
+
+  IoRing(const IoRing &) = delete;
+  IoRing &operator=(const IoRing &) = delete;
+
+  ~IoRing() {
+#ifdef CUCKOO_FILTER_IO_URING
+    if (ring_fd_ >= 0) {
+      munmap(sqes_, sqes_size_);
+      if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+      }
+      munmap(sq_ring_, sq_ring_size_);
+      close(ring_fd_);
+    }
+#endif
+  }
+
+  // whether blocks go through an io_uring, rather than pread and pwrite
+  bool Uring() const { return ring_fd_ >= 0; }
+
+  unsigned Depth() const { return Uring() ? depth_ : 1; }
+
+  // Read or write all of request from or to fd, blocking. Throws
+  // std::system_error on failure; reading past the end of the file gives
+  // zeros.
+  static void Transfer(const int fd, const bool write,
+                       const IoRequest &request) {
+    size_t done = 0;
+    while (done < request.size) {
+      const ssize_t n =
+          write ? pwrite(fd, request.buffer + done, request.size - done,
+                         request.offset + done)
+                : pread(fd, request.buffer + done, request.size - done,
+                        request.offset + done);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ThrowError(errno, write ? "pwrite" : "pread");
+      }
+      if (n == 0) {
+        if (write) {
+          ThrowError(EIO, "pwrite");
+        }
+        memset(request.buffer + done, 0, request.size - done);
+        break;
+      }
+      done += n;
+    }
+  }
+
+  // Read (or write) requests[0, n) from (or to) fd, and call done(k) once
+  // request k is complete, in any order, before returning. Throws
+  // std::system_error on failure, after all requests in flight are done.
+  template <typename Done>
+  void Run(const int fd, const bool write, const IoRequest *requests,
+           const size_t n, Done done) {
+#ifdef CUCKOO_FILTER_IO_URING
+    if (ring_fd_ >= 0) {
+      RunUring(fd, write, requests, n, done);
+      return;
+    }
+#endif
+    for (size_t k = 0; k < n; k++) {
+      Transfer(fd, write, requests[k]);
+      done(k);
+    }
+  }
+
+ private:
+#ifdef CUCKOO_FILTER_IO_URING
+  template <typename Done>
+  void RunUring(const int fd, const bool write, const IoRequest *requests,
+                const size_t n, Done &done) {
+    size_t submitted = 0, in_flight = 0;
+    int error = 0;
+    while (in_flight > 0 || (submitted < n && error == 0)) {
+      // only this thread moves the tail
+      unsigned tail = *sq_tail_;
+      while (submitted < n && in_flight < depth_ && error == 0) {
+        const unsigned index = tail & *sq_mask_;
+        const IoRequest &request = requests[submitted];
+        io_uring_sqe *sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+        sqe->len = request.size;
+        sqe->off = request.offset;
+        sqe->user_data = submitted;
+        sq_array_[index] = index;
+        tail++;
+        submitted++;
+        in_flight++;
+      }
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      // submit what the kernel has not taken yet, and wait for one to finish
+      const unsigned to_submit = tail - __atomic_load_n(sq_head_,
+                                                       __ATOMIC_ACQUIRE);
+      if (syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1,
+                  IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+          errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        ThrowError(errno, "io_uring_enter");
+      }
+      unsigned head = *cq_head_;
+      while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+        const size_t k = cqe.user_data;
+        const int result = cqe.res;
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        in_flight--;
+        if (result < 0) {
+          error = (error == 0) ? -result : error;
+        } else if (error == 0) {
+          if (static_cast<size_t>(result) < requests[k].size) {
+            // finish a short transfer the slow way
+            const IoRequest rest = {requests[k].buffer + result,
+                                    requests[k].size - result,
+                                    requests[k].offset + result};
+            try {
+              Transfer(fd, write, rest);
+            } catch (const std::system_error &e) {
+              error = e.code().value();
+              continue;
+            }
+          }
+          done(k);
+        }
+      }
+    }
+    if (error != 0) {
+      ThrowError(error, write ? "io_uring write" : "io_uring read");
+    }
+  }
+#endif
+};
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_IO_RING_H_
@@ -0,0 +1,368 @@
+#ifndef CUCKOO_FILTER_MORTON_TABLE_H_
+#define CUCKOO_FILTER_MORTON_TABLE_H_
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <utility>
+
+#include "debug.h"
+#include "printutil.h"
+#include "randutil.h"
+
+namespace cuckoofilter {
+
+// A compressed table in the style of Morton filters (Breslow and Jayasena,
+// "Morton Filters: Faster, Space-Efficient Cuckoo Filters via Biasing,
+// Compression, and Decoupled Logical Sparsity"). Buckets are grouped into
+// cache-line-sized blocks. Each block stores, from bit 0 upward:
+//
+//   FCA: one 2-bit fullness counter per bucket (0..3 tags)
+//   OTA: kOtaBits overflow bits
+//   FSA: kSlotsPerBlock tags, packed in bucket order with no gaps
+//
+// A bucket holds at most three tags, but a block only has about one slot per
+// bucket, so sparse buckets lend their space to crowded ones. An OTA bit is
+// set whenever an insertion into one of its buckets fails or kicks a tag out,
+// i.e. whenever some tag may have gone to its alternate bucket instead. If
+// the bit for the first bucket is clear, a negative lookup ends after reading
+// a single block.
+template <size_t bits_per_tag>
+class MortonTable {
+ public:
+  // Logical buckets have about one slot each on average, which is what
+  // CuckooFilter needs to size the table.
+  static const size_t kTagsPerBucket = 1;
+
+ private:
+  static_assert(bits_per_tag >= 2 && bits_per_tag <= 32,
+                "bits_per_tag must be in [2, 32]");
+
+  static const size_t kBlockBytes = 64;
+  static const size_t kBlockBits = kBlockBytes * 8;
+  static const size_t kMinOtaBits = 16;
+  static const size_t kMaxTagsInBucket = 3;
+  // About 17 slots for every 16 buckets, so that the table can reach the
+  // 96% load CuckooFilter sizes for.
+  static const size_t kBucketsPerBlock =
+      (kBlockBits - kMinOtaBits) * 16 / (17 * bits_per_tag + 32);
+  static const size_t kFcaBits = 2 * kBucketsPerBlock;
+  static const size_t kSlotsPerBlock =
+      (kBlockBits - kMinOtaBits - kFcaBits) / bits_per_tag;
+  static const size_t kFsaBits = kSlotsPerBlock * bits_per_tag;
+  static const size_t kOtaBits = kBlockBits - kFsaBits - kFcaBits;
+  static const size_t kFcaOffset = 0;
+  static const size_t kOtaOffset = kFcaBits;
+  static const size_t kFsaOffset = kFcaBits + kOtaBits;
+  static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+
+  char *blocks_;
+  size_t num_buckets_;
+  size_t num_blocks_;
+
+  inline char *Block(const size_t i) const {
+    return blocks_ + (i / kBucketsPerBlock) * kBlockBytes;
+  }
+
+  // Byte from which to read the uint64 holding bit `offset'. Reads never
+  // cross into the next cache line, so that a lookup touches one line only.
+  static inline size_t WordByte(const size_t offset) {
+    return std::min<size_t>(offset >> 3, kBlockBytes - 8);
+  }
+
+  // NOTE: at least min(57, kBlockBits - offset) bits starting from offset
+  // are valid
+  static inline uint64_t ReadBits64(const char *block, const size_t offset) {
+    const size_t byte = WordByte(offset);
+    /* following code only works for little-endian */
+    return *((const uint64_t *)(block + byte)) >> (offset - 8 * byte);
+  }
+
+  static inline uint32_t ReadBits(const char *block, const size_t offset,
+                                  const size_t width) {
+    return ReadBits64(block, offset) & ((1ULL << width) - 1);
+  }
+
+  static inline void WriteBits(char *block, const size_t offset,
+                               const size_t width, const uint32_t value) {
+    const size_t byte = WordByte(offset);
+    uint64_t *p = (uint64_t *)(block + byte);
+    const uint64_t mask = ((1ULL << width) - 1) << (offset - 8 * byte);
+    *p = (*p & ~mask) | (((uint64_t)value << (offset - 8 * byte)) & mask);
+  }
+
+  static inline uint32_t ReadTag(const char *block, const size_t k) {
+    return ReadBits(block, kFsaOffset + k * bits_per_tag, bits_per_tag);
+  }
+
+  static inline void WriteTag(char *block, const size_t k, const uint32_t t) {
+    WriteBits(block, kFsaOffset + k * bits_per_tag, bits_per_tag,
+              t & kTagMask);
+  }
+
+  static inline size_t Counter(const char *block, const size_t local) {
+    return ReadBits(block, kFcaOffset + 2 * local, 2);
+  }
+
+  static inline void SetCounter(char *block, const size_t local,
+                                const size_t count) {
+    WriteBits(block, kFcaOffset + 2 * local, 2, count);
+  }
+
+  // Sum of 2-bit counters packed in x
+  static inline size_t SumCounters(const uint64_t x) {
+    return __builtin_popcountll(x & 0x5555555555555555ULL) +
+           2 * __builtin_popcountll(x & 0xaaaaaaaaaaaaaaaaULL);
+  }
+
+  // Sum of the fullness counters of the first `local' buckets of a block,
+  // i.e. the FSA position of bucket `local'. Adds up to 28 counters at a
+  // time with popcounts, without branches for blocks of up to 56 buckets.
+  static inline size_t CountBefore(const char *block, const size_t local) {
+    if (kBucketsPerBlock <= 56) {
+      const size_t low = std::min<size_t>(local, 28);
+      const uint64_t x0 = ReadBits64(block, kFcaOffset);
+      const uint64_t x1 = ReadBits64(block, kFcaOffset + 56);
+      return SumCounters(x0 & ((1ULL << (2 * low)) - 1)) +
+             SumCounters(x1 & ((1ULL << (2 * (local - low))) - 1));
+    }
+    size_t sum = 0;
+    size_t l = 0;
+    for (; l + 28 <= local; l += 28) {
+      sum += SumCounters(ReadBits64(block, kFcaOffset + 2 * l) &
+                         ((1ULL << 56) - 1));
+    }
+    if (l < local) {
+      sum += SumCounters(ReadBits64(block, kFcaOffset + 2 * l) &
+                         ((1ULL << (2 * (local - l))) - 1));
+    }
+    return sum;
+  }
+
+  static inline bool Overflowed(const char *block, const size_t local) {
+    return ReadBits(block, kOtaOffset + local % kOtaBits, 1);
+  }
+
+  static inline void SetOverflowed(char *block, const size_t local) {
+    WriteBits(block, kOtaOffset + local % kOtaBits, 1, 1);
+  }
+
+ public:
+  explicit MortonTable(const size_t num) : num_buckets_(num) {
+    num_blocks_ = (num_buckets_ + kBucketsPerBlock - 1) / kBucketsPerBlock;
+    const size_t len = kBlockBytes * num_blocks_;
+    if (posix_memalign(reinterpret_cast<void **>(&blocks_), kBlockBytes,
+                       len)) {
+      throw ::std::bad_alloc();
+    }
+    memset(blocks_, 0, len);
+  }
+
+  MortonTable(MortonTable &&other) noexcept
+      : blocks_(other.blocks_),
+        num_buckets_(other.num_buckets_),
+        num_blocks_(other.num_blocks_) {
+    other.blocks_ = nullptr;
+    other.num_buckets_ = 0;
+    other.num_blocks_ = 0;
+  }
+
+  MortonTable &operator=(MortonTable &&other) noexcept {
+    std::swap(blocks_, other.blocks_);
+    std::swap(num_buckets_, other.num_buckets_);
+    std::swap(num_blocks_, other.num_blocks_);
+    return *this;
+  }
+
+  MortonTable(const MortonTable &) = delete;
+  MortonTable &operator=(const MortonTable &) = delete;
+
+  ~MortonTable() {
+    free(blocks_);
+  }
+
+  // empty all blocks, keeping the memory
+  void Clear() { memset(blocks_, 0, kBlockBytes * num_blocks_); }
+
+  size_t NumBuckets() const {
+    return num_buckets_;
+  }
+
+  size_t SizeInBytes() const {
+    return kBlockBytes * num_blocks_;
+  }
+
+  size_t SizeInTags() const {
+    return kSlotsPerBlock * num_blocks_;
+  }
+
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "MortonHashtable with tag size: " << bits_per_tag << " bits \n";
+    ss << "\t\tBuckets per block: " << kBucketsPerBlock
+       << ", slots per block: " << kSlotsPerBlock
+       << ", overflow bits per block: " << kOtaBits << "\n";
+    ss << "\t\tTotal # of rows: " << num_buckets_ << "\n";
+    ss << "\t\tTotal # of blocks: " << num_blocks_ << "\n";
+    ss << "\t\tTotal # slots: " << SizeInTags() << "\n";
+    return ss.str();
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
+    const char *block = Block(i);
+    const size_t local = i % kBucketsPerBlock;
+    const size_t offset = CountBefore(block, local);
+    const size_t count = Counter(block, local);
+    if (kMaxTagsInBucket * bits_per_tag <= 57) {
+      // compare all three tag positions at once and keep the valid ones
+      const uint64_t v =
+          ReadBits64(block, kFsaOffset + offset * bits_per_tag);
+      const bool hit0 = (v & kTagMask) == tag;
+      const bool hit1 = ((v >> bits_per_tag) & kTagMask) == tag;
+      const bool hit2 = ((v >> (2 * bits_per_tag)) & kTagMask) == tag;
+      return (hit0 & (count > 0)) | (hit1 & (count > 1)) |
+             (hit2 & (count > 2));
+    }
+    for (size_t k = offset; k < offset + count; k++) {
+      if (ReadTag(block, k) == tag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // hint that bucket i is about to be read
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(Block(i));
+  }
+
+  // i1 must be the bucket the item was first offered to, which is the
+  // case for CuckooFilter::Contain().
+  inline bool FindTagInBuckets(const size_t i1, const size_t i2,
+                               const uint32_t tag) const {
+    if (FindTagInBucket(i1, tag)) {
+      return true;
+    }
+    if (!Overflowed(Block(i1), i1 % kBucketsPerBlock)) {
+      return false;
+    }
+    return FindTagInBucket(i2, tag);
+  }
+
+  inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    char *block = Block(i);
+    const size_t local = i % kBucketsPerBlock;
+    const size_t offset = CountBefore(block, local);
+    const size_t count = Counter(block, local);
+    for (size_t k = offset; k < offset + count; k++) {
+      if (ReadTag(block, k) == tag) {
+        const size_t used = CountBefore(block, kBucketsPerBlock);
+        for (; k + 1 < used; k++) {
+          WriteTag(block, k, ReadTag(block, k + 1));
+        }
+        WriteTag(block, used - 1, 0);
+        SetCounter(block, local, count - 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // When the bucket or its block is full, marks the bucket as overflowed
+  // and, if kickout is set, swaps tag with a random tag of the bucket. If
+  // only the block is full, tag takes a free slot of bucket i by kicking out
+  // a random tag of the block instead, which may come from another bucket:
+  // i is then updated to the bucket oldtag was kicked from, so that the
+  // caller computes its alternate bucket from the right place.
+  inline bool InsertTagToBucket(size_t &i, const uint32_t tag,
+                                const bool kickout, uint32_t &oldtag,
+                                WyRand &random) {
+    char *block = Block(i);
+    const size_t local = i % kBucketsPerBlock;
+    const size_t offset = CountBefore(block, local);
+    const size_t count = Counter(block, local);
+    const size_t used = CountBefore(block, kBucketsPerBlock);
+    if (count < kMaxTagsInBucket && used < kSlotsPerBlock) {
+      for (size_t k = used; k > offset + count; k--) {
+        WriteTag(block, k, ReadTag(block, k - 1));
+      }
+      WriteTag(block, offset + count, tag);
+      SetCounter(block, local, count + 1);
+      return true;
+    }
+    if (!kickout) {
+      SetOverflowed(block, local);
+      return false;
+    }
+    if (count == kMaxTagsInBucket) {
+      SetOverflowed(block, local);
+      size_t r = offset + random.Below(count);
+      oldtag = ReadTag(block, r);
+      WriteTag(block, r, tag);
+      return false;
+    }
+    // find the bucket holding the random victim slot r
+    size_t r = random.Below(used);
+    size_t victim = 0;
+    size_t victim_offset = 0;
+    while (victim_offset + Counter(block, victim) <= r) {
+      victim_offset += Counter(block, victim);
+      victim++;
+    }
+    SetOverflowed(block, victim);
+    oldtag = ReadTag(block, r);
+    if (victim == local) {
+      WriteTag(block, r, tag);
+      return false;
+    }
+    // remove the victim tag, then append tag to bucket i
+    for (size_t k = r; k + 1 < used; k++) {
+      WriteTag(block, k, ReadTag(block, k + 1));
+    }
+    SetCounter(block, victim, Counter(block, victim) - 1);
+    const size_t insert_at = offset + count - (victim < local ? 1 : 0);
+    for (size_t k = used - 1; k > insert_at; k--) {
+      WriteTag(block, k, ReadTag(block, k - 1));
+    }
+    WriteTag(block, insert_at, tag);
+    SetCounter(block, local, count + 1);
+    i = i - local + victim;
+    return false;
+  }
+
+  // Add to counts[n] the number of buckets holding n tags, n in [0, 3].
+  // Reads the fullness counters of 28 buckets at a time and counts each
+  // value with popcounts.
+  void OccupancyHistogram(uint64_t *counts) const {
+    for (size_t b = 0; b < num_blocks_; b++) {
+      const char *block = blocks_ + b * kBlockBytes;
+      const size_t num_local =
+          std::min(kBucketsPerBlock, num_buckets_ - b * kBucketsPerBlock);
+      for (size_t l = 0; l < num_local; l += 28) {
+        const size_t n = std::min<size_t>(28, num_local - l);
+        const uint64_t x = ReadBits64(block, kFcaOffset + 2 * l);
+        // the low bit of each of the n counters
+        const uint64_t mask = 0x5555555555555555ULL & ((1ULL << 2 * n) - 1);
+        const uint64_t ones = x & mask;
+        const uint64_t twos = (x >> 1) & mask;
+        const size_t n3 = __builtin_popcountll(ones & twos);
+        const size_t n2 = __builtin_popcountll(twos) - n3;
+        const size_t n1 = __builtin_popcountll(ones) - n3;
+        counts[0] += n - n1 - n2 - n3;
+        counts[1] += n1;
+        counts[2] += n2;
+        counts[3] += n3;
+      }
+    }
+  }
+
+  inline size_t NumTagsInBucket(const size_t i) const {
+    return Counter(Block(i), i % kBucketsPerBlock);
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_MORTON_TABLE_H_
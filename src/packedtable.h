@@ -3,16 +3,24 @@
 
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include "debug.h"
+#include "dirtybitmap.h"
+#include "filterarena.h"
 #include "permencoding.h"
 #include "printutil.h"
+#include "randutil.h"
 
 namespace cuckoofilter {
 
 // Using Permutation encoding to save 1 bit per tag
 template <size_t bits_per_tag>
 class PackedTable {
+ public:
+  static const size_t kTagsPerBucket = 4;
+
+ private:
   static const size_t kDirBitsPerTag = bits_per_tag - 4;
   static const size_t kBitsPerBucket = (3 + kDirBitsPerTag) * 4;
   static const size_t kBytesPerBucket = (kBitsPerBucket + 7) >> 3;
@@ -22,21 +30,93 @@ class PackedTable {
   size_t len_;
   size_t num_buckets_;
   char *buckets_;
-  PermEncoding perm_;
+  // the tables of PermEncoding::Shared()
+  const PermEncoding *perm_;
+  // whether buckets_ was given to the table, by a FilterArena or Adopt,
+  // and is freed by its owner
+  bool adopted_;
+  // regions written since the last TakeDirty, if tracked
+  DirtyBitmap dirty_;
+
+  PackedTable(const size_t num, void *storage, const bool adopted)
+      : len_(StorageSize(num)),
+        num_buckets_(num),
+        buckets_(static_cast<char *>(storage)),
+        perm_(&PermEncoding::Shared()),
+        adopted_(adopted) {}
 
  public:
-  explicit PackedTable(size_t num) : num_buckets_(num) {
+  explicit PackedTable(size_t num)
+      : PackedTable(num, new char[StorageSize(num)], false) {
+    Clear();
+  }
+
+  // The buckets are allocated from arena, and freed with it.
+  PackedTable(const size_t num, FilterArena *arena)
+      : PackedTable(num, arena->Allocate(StorageSize(num)), true) {
+    Clear();
+  }
+
+  // A table of num buckets over storage, StorageSize(num) bytes that the
+  // caller owns, such as shared memory. Tags already there are kept.
+  static PackedTable Adopt(const size_t num, void *storage) {
+    return PackedTable(num, storage, true);
+  }
+
+  static size_t StorageSize(const size_t num) {
     // NOTE(binfan): use 7 extra bytes to avoid overrun as we
     // always read a uint64
-    len_ = kBytesPerBucket * num_buckets_ + 7;
-    buckets_ = new char[len_];
-    memset(buckets_, 0, len_); 
+    return kBytesPerBucket * num + 7;
+  }
+
+  PackedTable(PackedTable &&other) noexcept
+      : len_(other.len_),
+        num_buckets_(other.num_buckets_),
+        buckets_(other.buckets_),
+        perm_(other.perm_),
+        adopted_(other.adopted_),
+        dirty_(std::move(other.dirty_)) {
+    other.len_ = 0;
+    other.num_buckets_ = 0;
+    other.buckets_ = nullptr;
   }
 
-  ~PackedTable() { 
-    delete[] buckets_; 
+  PackedTable &operator=(PackedTable &&other) noexcept {
+    std::swap(len_, other.len_);
+    std::swap(num_buckets_, other.num_buckets_);
+    std::swap(buckets_, other.buckets_);
+    std::swap(adopted_, other.adopted_);
+    std::swap(dirty_, other.dirty_);
+    return *this;
+  }
+
+  PackedTable(const PackedTable &) = delete;
+  PackedTable &operator=(const PackedTable &) = delete;
+
+  ~PackedTable() {
+    if (!adopted_) {
+      delete[] buckets_;
+    }
   }
 
+  // empty all buckets, keeping the memory
+  void Clear() {
+    memset(buckets_, 0, len_);
+    dirty_.MarkAll(len_);
+  }
+
+  // Track the regions of the storage that writes change, starting with all
+  // of them dirty, for incremental checkpoints.
+  void TrackDirty() { dirty_.Enable(len_); }
+
+  // Append the regions written since the last call, or since TrackDirty, to
+  // regions, and mark them clean.
+  void TakeDirty(std::vector<size_t> *regions) { dirty_.Take(len_, regions); }
+
+  // the StorageSize(NumBuckets()) bytes of the table, for checkpoints
+  const char *Storage() const { return buckets_; }
+  char *Storage() { return buckets_; }
+
   size_t NumBuckets() const {
     return num_buckets_;
   }
@@ -82,7 +162,7 @@ class PackedTable {
       lowbits[j] = tags[j] & 0x0f;
       dirbits[j] = (tags[j] & kDirBitsMask) >> 4;
     }
-    uint16_t codeword = perm_.encode(lowbits);
+    uint16_t codeword = perm_->encode(lowbits);
     std::cout << "\tcodeword  ="
               << PrintUtil::bytes_to_hex((char *)&codeword, 2) << std::endl;
     for (size_t j = 0; j < 4; j++) {
@@ -189,7 +269,7 @@ class PackedTable {
     }
 
     /* codeword is the lowest 12 bits in the bucket */
-    uint16_t v = perm_.dec_table[codeword];
+    uint16_t v = perm_->dec_table[codeword];
     lowbits[0] = (v & 0x000f);
     lowbits[2] = ((v >> 4) & 0x000f);
     lowbits[1] = ((v >> 8) & 0x000f);
@@ -237,12 +317,14 @@ class PackedTable {
 
     // note that :  tags[j] = lowbits[j] | highbits[j]
 
-    uint16_t codeword = perm_.encode(lowbits);
+    uint16_t codeword = perm_->encode(lowbits);
     DPRINTF(DEBUG_TABLE, "codeword=%s\n",
             PrintUtil::bytes_to_hex((char *)&codeword, 2).c_str());
 
     /* write out the bucketbits to its place*/
     const char *p = buckets_ + ((kBitsPerBucket * i) >> 3);
+    dirty_.Mark((kBitsPerBucket * i) >> 3,
+                (kBitsPerBucket * (i + 1) - 1) >> 3);
     DPRINTF(DEBUG_TABLE, "original bucketbits=%s\n",
             PrintUtil::bytes_to_hex((char *)p, 8).c_str());
 
@@ -307,6 +389,29 @@ class PackedTable {
     DPRINTF(DEBUG_TABLE, "PackedTable::WriteBucket done\n");
   }
 
+  // Write bucket i from its encoded parts, for a caller that already has
+  // its tags sorted by their low 4 bits: codeword, the PermEncoding code of
+  // those bits, and the direct bits of each tag in the same order, packed
+  // one after another in dirbits.
+  inline void WriteBucketBits(const size_t i, const uint16_t codeword,
+                              const uint64_t dirbits) {
+    const size_t bit = kBitsPerBucket * i;
+    char *p = buckets_ + (bit >> 3);
+    const uint64_t mask =
+        (kBitsPerBucket >= 64 ? ~0ULL
+                              : (1ULL << (kBitsPerBucket & 63)) - 1)
+        << (bit & 7);
+    const uint64_t bits = codeword | (dirbits << 12);
+    dirty_.Mark(bit >> 3, (bit + kBitsPerBucket - 1) >> 3);
+    *((uint64_t *)p) =
+        (*((uint64_t *)p) & ~mask) | ((bits << (bit & 7)) & mask);
+  }
+
+  // hint that bucket i is about to be read
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_ + kBitsPerBucket * i / 8);
+  }
+
   bool FindTagInBuckets(const size_t i1, const size_t i2,
                         const uint32_t tag) const {
     //            DPRINTF(DEBUG_TABLE, "PackedTable::FindTagInBucket %zu\n", i);
@@ -328,7 +433,7 @@ class PackedTable {
     tags1[1] = (bucketbits1 >> 17) & kDirBitsMask;
     tags1[2] = (bucketbits1 >> 26) & kDirBitsMask;
     tags1[3] = (bucketbits1 >> 35) & kDirBitsMask;
-    v = perm_.dec_table[(bucketbits1)&0x0fff];
+    v = perm_->dec_table[(bucketbits1)&0x0fff];
     // the order 0 2 1 3 is not a bug
     tags1[0] |= (v & 0x000f);
     tags1[2] |= ((v >> 4) & 0x000f);
@@ -339,7 +444,7 @@ class PackedTable {
     tags2[1] = (bucketbits2 >> 17) & kDirBitsMask;
     tags2[2] = (bucketbits2 >> 26) & kDirBitsMask;
     tags2[3] = (bucketbits2 >> 35) & kDirBitsMask;
-    v = perm_.dec_table[(bucketbits2)&0x0fff];
+    v = perm_->dec_table[(bucketbits2)&0x0fff];
     tags2[0] |= (v & 0x000f);
     tags2[2] |= ((v >> 4) & 0x000f);
     tags2[1] |= ((v >> 8) & 0x000f);
@@ -381,7 +486,7 @@ class PackedTable {
   }  // DeleteTagFromBucket
 
   bool InsertTagToBucket(const size_t i, const uint32_t tag, const bool kickout,
-                         uint32_t &oldtag) {
+                         uint32_t &oldtag, WyRand &random) {
     DPRINTF(DEBUG_TABLE, "PackedTable::InsertTagToBucket %zu \n", i);
 
     uint32_t tags[4];
@@ -408,7 +513,7 @@ class PackedTable {
       }
     }
     if (kickout) {
-      size_t r = rand() & 3;
+      size_t r = random.Below(4);
       DPRINTF(
           DEBUG_TABLE,
           "PackedTable::InsertTagToBucket, let's kick out a random slot %zu \n",
@@ -426,6 +531,17 @@ class PackedTable {
     return false;
   }
 
+  // Add to counts[n] the number of buckets holding n tags, n in [0, 4].
+  // Each bucket is decoded once and its empty tags counted without branches.
+  void OccupancyHistogram(uint64_t *counts) const {
+    uint32_t tags[4];
+    for (size_t i = 0; i < num_buckets_; i++) {
+      ReadBucket(i, tags);
+      counts[(tags[0] != 0) + (tags[1] != 0) + (tags[2] != 0) +
+             (tags[3] != 0)]++;
+    }
+  }
+
   // inline size_t NumTagsInBucket(const size_t i) {
   //     size_t num = 0;
   //     for (size_t j = 0; j < tags_per_bucket; j++ ){
@@ -44,6 +44,13 @@ class PermEncoding {
 
   ~PermEncoding() {}
 
+  // The tables are the same for everyone, and take 139 KB, so all packed
+  // tables share one copy, built on first use.
+  static const PermEncoding &Shared() {
+    static const PermEncoding perm;
+    return perm;
+  }
+
   static const size_t N_ENTS = 3876;
 
   uint16_t dec_table[N_ENTS];
@@ -0,0 +1,364 @@
+#ifndef CUCKOO_FILTER_PREFIX_FILTER_H_
+#define CUCKOO_FILTER_PREFIX_FILTER_H_
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+
+#include <emmintrin.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "cuckoofilter.h"
+
+namespace cuckoofilter {
+
+// A two-level filter in the style of prefix filters (Even, Even and Morrison,
+// "Prefix Filter: Practically and Theoretically Better Than Bloom"). Every
+// key hashes to one cache-line bin and to a fingerprint (quotient,
+// remainder) within that bin. A bin stores up to kBinCapacity fingerprints:
+//
+//   header:     128 bits; for each quotient in turn, a one bit per stored
+//               fingerprint with that quotient followed by a zero bit, plus
+//               the overflow flag in the top bit
+//   remainders: kBinCapacity bytes, sorted by (quotient, remainder)
+//
+// When a bin is full, its largest fingerprint moves to the spare, a small
+// CuckooFilter, and the bin is marked as overflowed. As a bin only ever
+// evicts its maximum, every spilled fingerprint is larger than anything left
+// in the bin, so a lookup reads the spare only if the bin overflowed and the
+// fingerprint is larger than the bin maximum. Insertions never kick, and with
+// bins sized for kBinLoad most lookups read a single cache line.
+//
+// Deletion is not supported.
+template <typename ItemType,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type>
+class PrefixFilter {
+  static const size_t kBinBytes = 64;
+  static const size_t kHeaderBytes = 16;
+  static const size_t kBinCapacity = kBinBytes - kHeaderBytes;
+  static const size_t kQuotients = 50;
+  static const size_t kRemainders = 256;
+  static_assert(kQuotients + kBinCapacity < 128,
+                "header must leave room for the overflow flag");
+
+  typedef unsigned __int128 Header;
+  static constexpr Header kOverflowFlag = ((Header)1) << 127;
+
+  // Expected fraction of kBinCapacity used once max_num_keys are added
+  static constexpr double kBinLoad = 0.95;
+
+  struct Bin {
+    Header header;
+    uint8_t remainders[kBinCapacity];
+  };
+  static_assert(sizeof(Bin) == kBinBytes, "Bin must fill one cache line");
+
+  typedef CuckooFilter<uint64_t, 12> Spare;
+
+  Bin *bins_;
+  size_t num_bins_;
+  Spare *spare_;
+
+  // Number of items stored in bins_
+  size_t num_items_;
+
+  HashFamily hasher_;
+
+  inline void GenerateBinFingerprint(const ItemType &item, size_t *bin,
+                                     uint32_t *quotient,
+                                     uint32_t *remainder) const {
+    const uint64_t hash = hasher_(item);
+    // num_bins_ need not be a power of two: map the high half into
+    // [0, num_bins_) with a multiply-shift, and likewise the low half into
+    // [0, kQuotients * kRemainders).
+    *bin = ((hash >> 32) * num_bins_) >> 32;
+    const uint32_t fp = ((hash & 0xffffffffULL) * kQuotients * kRemainders) >> 32;
+    *quotient = fp / kRemainders;
+    *remainder = fp % kRemainders;
+  }
+
+  static inline uint64_t SpareKey(const size_t bin, const uint32_t quotient,
+                                  const uint32_t remainder) {
+    return ((uint64_t)bin << 16) | (quotient << 8) | remainder;
+  }
+
+  static inline size_t BinSize(const Header header) {
+    const Header body = header & ~kOverflowFlag;
+    return __builtin_popcountll((uint64_t)body) +
+           __builtin_popcountll((uint64_t)(body >> 64));
+  }
+
+  // Position of the k-th (from 0) zero bit of word, which must exist
+  static inline size_t SelectZero64(const uint64_t word, size_t k) {
+#ifdef __BMI2__
+    return __builtin_ctzll(_pdep_u64(1ULL << k, ~word));
+#else
+    uint64_t zeros = ~word;
+    for (; k > 0; k--) {
+      zeros &= zeros - 1;
+    }
+    return __builtin_ctzll(zeros);
+#endif
+  }
+
+  // Position of the k-th (from 0) zero bit of the header, k < kQuotients
+  static inline size_t SelectZero(const Header header, const size_t k) {
+    const uint64_t lo = (uint64_t)header;
+    const uint64_t hi = (uint64_t)(header >> 64);
+    const size_t lo_zeros = 64 - __builtin_popcountll(lo);
+    // Which half holds the zero is data dependent and mispredicts half of
+    // the time, so pick the half with masks rather than a branch.
+    const uint64_t in_hi = -(uint64_t)(k >= lo_zeros);
+    const uint64_t word = (lo & ~in_hi) | (hi & in_hi);
+    return (64 & in_hi) + SelectZero64(word, k - (lo_zeros & in_hi));
+  }
+
+  // Range [*begin, *end) of the remainders stored with quotient
+  static inline void QuotientRange(const Header header, const uint32_t quotient,
+                                   size_t *begin, size_t *end) {
+    // The ones of quotient q start right after the (q-1)-th zero; shifting
+    // in a zero at the bottom makes that the q-th zero, also for q = 0.
+    const size_t first = SelectZero(header << 1, quotient);
+    *begin = first - quotient;
+    // followed by a run of at most kBinCapacity ones
+    *end = *begin + __builtin_ctzll(~(uint64_t)(header >> first));
+  }
+
+  // Bit i is set iff remainders[i] == remainder
+  static inline uint64_t MatchMask(const Bin &bin, const uint32_t remainder) {
+    const __m128i r = _mm_set1_epi8((char)remainder);
+    const __m128i *v = (const __m128i *)bin.remainders;
+    const uint64_t m0 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(v), r));
+    const uint64_t m1 =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(v + 1), r));
+    const uint64_t m2 =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(v + 2), r));
+    return m0 | (m1 << 16) | (m2 << 32);
+  }
+
+  // Bit i is set iff remainders[i] < remainder
+  static inline uint64_t LessMask(const Bin &bin, const uint32_t remainder) {
+    const __m128i r = _mm_set1_epi8((char)remainder);
+    const __m128i *v = (const __m128i *)bin.remainders;
+    uint64_t ge = 0;
+    for (int k = 0; k < 3; k++) {
+      const __m128i x = _mm_load_si128(v + k);
+      ge |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, r), x))
+            << (16 * k);
+    }
+    return ~ge;
+  }
+
+  static inline uint64_t RangeMask(const size_t begin, const size_t end) {
+    return ((1ULL << end) - 1) & ~((1ULL << begin) - 1);
+  }
+
+  // The largest fingerprint of a non-empty bin
+  static inline void MaxFingerprint(const Bin &bin, uint32_t *quotient,
+                                    uint32_t *remainder) {
+    const Header body = bin.header & ~kOverflowFlag;
+    const uint64_t hi = (uint64_t)(body >> 64);
+    const size_t last_one =
+        hi ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll((uint64_t)body);
+    const size_t n = BinSize(bin.header);
+    *quotient = last_one - (n - 1);
+    *remainder = bin.remainders[n - 1];
+  }
+
+  static inline bool Less(const uint32_t q1, const uint32_t r1,
+                          const uint32_t q2, const uint32_t r2) {
+    return q1 < q2 || (q1 == q2 && r1 < r2);
+  }
+
+  static void InsertToBin(Bin &bin, const uint32_t quotient,
+                          const uint32_t remainder);
+
+  static void RemoveMaxFromBin(Bin &bin);
+
+ public:
+  explicit PrefixFilter(const size_t max_num_keys);
+
+  PrefixFilter(PrefixFilter &&that)
+      : bins_(that.bins_),
+        num_bins_(that.num_bins_),
+        spare_(that.spare_),
+        num_items_(that.num_items_),
+        hasher_(that.hasher_) {
+    that.bins_ = nullptr;
+    that.spare_ = nullptr;
+  }
+
+  ~PrefixFilter() {
+    free(bins_);
+    delete spare_;
+  }
+
+  // Add an item to the filter.
+  Status Add(const ItemType &item);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return num_items_ + spare_->Size(); }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const {
+    return num_bins_ * kBinBytes + spare_->SizeInBytes();
+  }
+
+ private:
+  PrefixFilter(const PrefixFilter &) = delete;
+  void operator=(const PrefixFilter &) = delete;
+};
+
+template <typename ItemType, typename HashFamily>
+PrefixFilter<ItemType, HashFamily>::PrefixFilter(const size_t max_num_keys)
+    : bins_(nullptr), num_bins_(0), spare_(nullptr), num_items_(0),
+      hasher_() {
+  num_bins_ = std::max<size_t>(
+      1, (size_t)(max_num_keys / (kBinCapacity * kBinLoad)) + 1);
+  if (posix_memalign(reinterpret_cast<void **>(&bins_), kBinBytes,
+                     num_bins_ * kBinBytes) != 0) {
+    throw std::bad_alloc();
+  }
+  memset(bins_, 0, num_bins_ * kBinBytes);
+  // Bins at kBinLoad spill a few percent of the keys; leave ample room so
+  // that the spare never runs out of space.
+  spare_ = new Spare(std::max<size_t>(64, max_num_keys / 16));
+}
+
+template <typename ItemType, typename HashFamily>
+void PrefixFilter<ItemType, HashFamily>::InsertToBin(Bin &bin,
+                                                     const uint32_t quotient,
+                                                     const uint32_t remainder) {
+  assert(BinSize(bin.header) < kBinCapacity);
+  size_t begin, end;
+  QuotientRange(bin.header, quotient, &begin, &end);
+  const size_t pos =
+      begin +
+      __builtin_popcountll(LessMask(bin, remainder) & RangeMask(begin, end));
+
+  // Move remainders[pos..n) up by one with vector blends rather than a
+  // memmove, whose length-dependent branches stall on the bin's cache miss.
+  __m128i *v = (__m128i *)bin.remainders;
+  const __m128i old[3] = {_mm_load_si128(v), _mm_load_si128(v + 1),
+                          _mm_load_si128(v + 2)};
+  const __m128i up[3] = {
+      _mm_slli_si128(old[0], 1),
+      _mm_or_si128(_mm_slli_si128(old[1], 1), _mm_srli_si128(old[0], 15)),
+      _mm_or_si128(_mm_slli_si128(old[2], 1), _mm_srli_si128(old[1], 15))};
+  const __m128i p = _mm_set1_epi8((char)pos);
+  const __m128i r = _mm_set1_epi8((char)remainder);
+  __m128i index =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  for (int k = 0; k < 3; k++) {
+    const __m128i below = _mm_cmplt_epi8(index, p);
+    const __m128i at = _mm_cmpeq_epi8(index, p);
+    __m128i x = _mm_or_si128(_mm_and_si128(below, old[k]),
+                             _mm_andnot_si128(below, up[k]));
+    x = _mm_or_si128(_mm_and_si128(at, r), _mm_andnot_si128(at, x));
+    _mm_store_si128(v + k, x);
+    index = _mm_add_epi8(index, _mm_set1_epi8(16));
+  }
+
+  // The new one bit goes to header position pos + quotient, i.e. after pos
+  // ones and quotient zeros; higher bits move up by one.
+  const size_t bit = pos + quotient;
+  const Header low = (((Header)1) << bit) - 1;
+  const Header body = bin.header & ~kOverflowFlag;
+  bin.header = (body & low) | ((body & ~low) << 1) | (((Header)1) << bit) |
+               (bin.header & kOverflowFlag);
+}
+
+template <typename ItemType, typename HashFamily>
+void PrefixFilter<ItemType, HashFamily>::RemoveMaxFromBin(Bin &bin) {
+  const Header body = bin.header & ~kOverflowFlag;
+  const uint64_t hi = (uint64_t)(body >> 64);
+  const size_t last_one =
+      hi ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll((uint64_t)body);
+  // The remainder needs no clearing as only the header defines the size.
+  bin.header &= ~(((Header)1) << last_one);
+}
+
+template <typename ItemType, typename HashFamily>
+Status PrefixFilter<ItemType, HashFamily>::Add(const ItemType &item) {
+  size_t b;
+  uint32_t quotient, remainder;
+  GenerateBinFingerprint(item, &b, &quotient, &remainder);
+  Bin &bin = bins_[b];
+
+  if (BinSize(bin.header) < kBinCapacity) {
+    InsertToBin(bin, quotient, remainder);
+    num_items_++;
+    return Ok;
+  }
+
+  // The bin is full: whichever of the new and the largest fingerprint is
+  // larger goes to the spare.
+  uint32_t max_quotient, max_remainder;
+  MaxFingerprint(bin, &max_quotient, &max_remainder);
+  bin.header |= kOverflowFlag;
+  if (!Less(quotient, remainder, max_quotient, max_remainder)) {
+    return spare_->Add(SpareKey(b, quotient, remainder));
+  }
+  const Status s = spare_->Add(SpareKey(b, max_quotient, max_remainder));
+  if (s != Ok) {
+    return s;
+  }
+  RemoveMaxFromBin(bin);
+  InsertToBin(bin, quotient, remainder);
+  return Ok;
+}
+
+template <typename ItemType, typename HashFamily>
+Status PrefixFilter<ItemType, HashFamily>::Contain(const ItemType &key) const {
+  size_t b;
+  uint32_t quotient, remainder;
+  GenerateBinFingerprint(key, &b, &quotient, &remainder);
+  const Bin &bin = bins_[b];
+
+  size_t begin, end;
+  QuotientRange(bin.header, quotient, &begin, &end);
+  if (MatchMask(bin, remainder) & RangeMask(begin, end)) {
+    return Ok;
+  }
+  // Overflowed bins stay full, and a fingerprint larger than their maximum
+  // would be placed after all of their fingerprints. Testing for that first
+  // keeps the overflow flag off the common path.
+  if (end == kBinCapacity && (bin.header & kOverflowFlag) &&
+      (begin == end || remainder > bin.remainders[kBinCapacity - 1])) {
+    return spare_->Contain(SpareKey(b, quotient, remainder));
+  }
+  return NotFound;
+}
+
+template <typename ItemType, typename HashFamily>
+std::string PrefixFilter<ItemType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "PrefixFilter Status:\n"
+     << "\t\tBins: " << num_bins_ << " of " << kBinCapacity << " x 8 bits\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tKeys in spare: " << spare_->Size() << "\n"
+     << "\t\tBin load factor: "
+     << 1.0 * num_items_ / (num_bins_ * kBinCapacity) << "\n"
+     << "\t\tHashtable size: " << (SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << 8.0 * SizeInBytes() / Size() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_PREFIX_FILTER_H_
@@ -0,0 +1,40 @@
+#ifndef CUCKOO_FILTER_RAND_UTIL_H_
+#define CUCKOO_FILTER_RAND_UTIL_H_
+
+#include <stdint.h>
+
+#include <random>
+
+namespace cuckoofilter {
+
+// Wang Yi's wyrand: a 64-bit state advanced by a constant and one 128-bit
+// multiplication per number. Filters keep one each to pick the tags they
+// kick out, instead of libc rand(), which takes a global lock in glibc.
+class WyRand {
+  uint64_t state_;
+
+ public:
+  // seeded from std::random_device
+  WyRand() {
+    ::std::random_device random;
+    state_ = random() | (static_cast<uint64_t>(random()) << 32);
+  }
+
+  // the same seed gives the same numbers, for reproducible builds
+  explicit WyRand(const uint64_t seed) : state_(seed) {}
+
+  inline uint64_t operator()() {
+    state_ += 0xa0761d6478bd642fULL;
+    const unsigned __int128 r = static_cast<unsigned __int128>(state_) *
+                                (state_ ^ 0xe7037ed1a0b428dbULL);
+    return static_cast<uint64_t>(r >> 64) ^ static_cast<uint64_t>(r);
+  }
+
+  // uniform in [0, n), from the high bits, without a division
+  inline uint32_t Below(const uint32_t n) {
+    return ((*this)() >> 32) * n >> 32;
+  }
+};
+
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_RAND_UTIL_H_
@@ -0,0 +1,589 @@
+#ifndef CUCKOO_FILTER_SHARED_CUCKOO_FILTER_H_
+#define CUCKOO_FILTER_SHARED_CUCKOO_FILTER_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cuckoofilter.h"
+
+namespace cuckoofilter {
+
+// number of buckets guarded by one sequence counter of a SharedCuckooFilter
+const size_t kSharedStripeBuckets = 1 << 10;
+
+// A cuckoo filter in shared memory, for processes on one host that all need
+// the same filter: one process creates it in a named POSIX shared memory
+// object (or a memfd) and the others attach to it, so the host holds one
+// copy of the table instead of one per process.
+//
+// The region holds a header, the hash functions, the alternate index policy,
+// one sequence counter per kSharedStripeBuckets buckets and the table, each
+// found by its offset from the start of the region, so processes may map it
+// at different addresses. HashFamily and AltIndexPolicy must therefore be
+// trivially copyable, and all processes must use the same template
+// arguments; Attach checks what the header records. Buckets, tags and kick
+// chains are those of CuckooFilter with the same arguments.
+//
+// One process at a time attaches writable, which an exclusive flock on the
+// region enforces, and may Add and Delete; any number of processes and
+// threads may look up concurrently. An Add or Delete makes the counters of
+// all stripes it writes odd until it is done, so a kick chain is published
+// at once: a lookup that saw a counter odd or changed reads its buckets
+// again, and never misses an item that was in the filter before the write.
+// A counter in the header is odd during any write, so that lookups only
+// read the stripe counters while the writer is busy.
+// If the writer dies in the middle of a write, lookups in the stripes it was
+// writing retry until another process attaches writable, which ends the
+// write; the tag its kick chain was moving, if any, is lost.
+// Only SingleTable and PackedTable can be shared, as tables that adopt
+// memory (see SingleTable::Adopt).
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTable,
+          typename HashFamily = typename DefaultHashFamily<ItemType>::type,
+          typename AltIndexPolicy = XorAltIndex>
+class SharedCuckooFilter {
+  static_assert(std::is_trivially_copyable<HashFamily>::value,
+                "the hash functions are shared as bytes");
+  static_assert(std::is_trivially_copyable<AltIndexPolicy>::value,
+                "the alternate index policy is shared as bytes");
+
+  typedef TableType<bits_per_item> Table;
+
+  static const uint64_t kMagic = 0x6375636b6f6f666cULL;  // "cuckoofl"
+  static const uint32_t kVersion = 2;
+
+  // the start of the region; all sizes are in bytes
+  struct Header {
+    // stored last by Create, so that a region is only attached once ready
+    std::atomic<uint64_t> magic;
+    uint32_t version;
+    uint32_t bits_per_tag;
+    uint64_t tags_per_bucket;
+    uint64_t num_buckets;
+    uint64_t hasher_offset;
+    uint64_t hasher_size;
+    uint64_t alt_index_offset;
+    uint64_t alt_index_size;
+    uint64_t stripes_offset;
+    uint64_t num_stripes;
+    uint64_t table_offset;
+    uint64_t table_size;
+    std::atomic<uint64_t> num_items;
+    // odd while an Add or Delete runs, for lookups to skip the stripes
+    std::atomic<uint32_t> write_sequence;
+    // guards the victim like a stripe counter guards its buckets
+    std::atomic<uint32_t> victim_sequence;
+    uint32_t victim_used;
+    uint32_t victim_tag;
+    uint64_t victim_index;
+  };
+
+  // only lock-free atomics work across processes
+  static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+                "the counters must be lock-free atomics");
+
+  int fd_;
+  char *base_;
+  size_t size_;
+  bool writable_;
+  Header *header_;
+  const HashFamily *hasher_;
+  const AltIndexPolicy *alt_index_;
+  std::atomic<uint32_t> *stripes_;
+  Table table_;
+
+  // writer state, private to the process
+  WyRand random_;
+  // stripes whose counters the current Add or Delete made odd
+  std::vector<size_t> open_stripes_;
+  bool victim_open_;
+
+  static size_t AlignUp(const size_t x) { return (x + 63) & ~size_t(63); }
+
+  // number of buckets, a power of two, for max_num_keys at up to 96% load,
+  // the same as CuckooFilter(max_num_keys) has
+  static size_t NumBucketsFor(const size_t max_num_keys) {
+    const size_t assoc = Table::kTagsPerBucket;
+    size_t num_buckets =
+        upperpower2(std::max<uint64_t>(1, max_num_keys / assoc));
+    if ((double)max_num_keys / num_buckets / assoc > 0.96) {
+      num_buckets <<= 1;
+    }
+    return num_buckets;
+  }
+
+  [[noreturn]] static void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+
+  // Map size bytes of fd, which the filter owns from now on, and take the
+  // writer lock if writable. Closes fd on failure.
+  static char *Map(const int fd, const size_t size, const bool writable) {
+    if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowErrno("another process has the shared filter open for writing");
+    }
+    void *p = mmap(nullptr, size, PROT_READ | (writable ? PROT_WRITE : 0),
+                   MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowErrno("mmap");
+    }
+    return static_cast<char *>(p);
+  }
+
+  SharedCuckooFilter(const int fd, char *base, const size_t size,
+                     const bool writable)
+      : fd_(fd),
+        base_(base),
+        size_(size),
+        writable_(writable),
+        header_(reinterpret_cast<Header *>(base)),
+        hasher_(reinterpret_cast<const HashFamily *>(
+            base + header_->hasher_offset)),
+        alt_index_(reinterpret_cast<const AltIndexPolicy *>(
+            base + header_->alt_index_offset)),
+        stripes_(reinterpret_cast<std::atomic<uint32_t> *>(
+            base + header_->stripes_offset)),
+        table_(Table::Adopt(header_->num_buckets,
+                            base + header_->table_offset)),
+        random_(),
+        victim_open_(false) {
+    open_stripes_.reserve(kMaxCuckooCount + 2);
+  }
+
+  // lay out a new filter for max_num_keys in fd, whose size is 0
+  static std::unique_ptr<SharedCuckooFilter> CreateIn(
+      const int fd, const size_t max_num_keys) {
+    const size_t num_buckets = NumBucketsFor(max_num_keys);
+    const size_t num_stripes =
+        (num_buckets + kSharedStripeBuckets - 1) / kSharedStripeBuckets;
+    const size_t hasher_offset = AlignUp(sizeof(Header));
+    const size_t alt_index_offset =
+        AlignUp(hasher_offset + sizeof(HashFamily));
+    const size_t stripes_offset =
+        AlignUp(alt_index_offset + sizeof(AltIndexPolicy));
+    const size_t table_offset =
+        AlignUp(stripes_offset + num_stripes * sizeof(uint32_t));
+    const size_t table_size = Table::StorageSize(num_buckets);
+    const size_t size = table_offset + table_size;
+    // the new pages read as zeros: all stripes even and the table empty
+    if (ftruncate(fd, size) != 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowErrno("ftruncate");
+    }
+    char *base = Map(fd, size, true);
+    Header *header = new (base) Header();
+    header->version = kVersion;
+    header->bits_per_tag = bits_per_item;
+    header->tags_per_bucket = Table::kTagsPerBucket;
+    header->num_buckets = num_buckets;
+    header->hasher_offset = hasher_offset;
+    header->hasher_size = sizeof(HashFamily);
+    header->alt_index_offset = alt_index_offset;
+    header->alt_index_size = sizeof(AltIndexPolicy);
+    header->stripes_offset = stripes_offset;
+    header->num_stripes = num_stripes;
+    header->table_offset = table_offset;
+    header->table_size = table_size;
+    header->num_items.store(0, std::memory_order_relaxed);
+    header->write_sequence.store(0, std::memory_order_relaxed);
+    header->victim_sequence.store(0, std::memory_order_relaxed);
+    header->victim_used = 0;
+    new (base + hasher_offset) HashFamily();
+    new (base + alt_index_offset) AltIndexPolicy();
+    header->magic.store(kMagic, std::memory_order_release);
+    return std::unique_ptr<SharedCuckooFilter>(
+        new SharedCuckooFilter(fd, base, size, true));
+  }
+
+  // map the filter in fd after checking that its header matches this type
+  static std::unique_ptr<SharedCuckooFilter> AttachTo(const int fd,
+                                                      const bool writable) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      ThrowErrno("fstat");
+    }
+    const size_t size = st.st_size;
+    if (size < sizeof(Header)) {
+      close(fd);
+      throw std::runtime_error("not a shared cuckoo filter");
+    }
+    char *base = Map(fd, size, writable);
+    const Header *header = reinterpret_cast<const Header *>(base);
+    const char *mismatch = nullptr;
+    if (header->magic.load(std::memory_order_acquire) != kMagic) {
+      mismatch = "not a shared cuckoo filter, or not created yet";
+    } else if (header->version != kVersion) {
+      mismatch = "layout version";
+    } else if (header->bits_per_tag != bits_per_item ||
+               header->tags_per_bucket != Table::kTagsPerBucket) {
+      mismatch = "tag size";
+    } else if (header->hasher_size != sizeof(HashFamily) ||
+               header->hasher_offset + header->hasher_size > size) {
+      mismatch = "hash family";
+    } else if (header->alt_index_size != sizeof(AltIndexPolicy) ||
+               header->alt_index_offset + header->alt_index_size > size) {
+      mismatch = "alternate index policy";
+    } else if (header->num_buckets == 0 ||
+               (header->num_buckets & (header->num_buckets - 1)) != 0 ||
+               header->table_size != Table::StorageSize(header->num_buckets) ||
+               header->table_offset + header->table_size > size ||
+               header->stripes_offset +
+                       header->num_stripes * sizeof(uint32_t) >
+                   header->table_offset ||
+               header->num_stripes * kSharedStripeBuckets <
+                   header->num_buckets) {
+      mismatch = "table layout";
+    }
+    if (mismatch != nullptr) {
+      munmap(base, size);
+      close(fd);
+      throw std::runtime_error(std::string("shared cuckoo filter: ") +
+                               mismatch);
+    }
+    std::unique_ptr<SharedCuckooFilter> filter(
+        new SharedCuckooFilter(fd, base, size, writable));
+    if (writable) {
+      filter->CloseAbandonedWrite();
+    }
+    return filter;
+  }
+
+  // A writer that died between BeginWrite and EndWrite left counters odd,
+  // which would keep lookups retrying and make the next writer's counters
+  // odd when they should be even. Holding the writer lock, round them all
+  // up to the next even value, the write counter last.
+  void CloseAbandonedWrite() {
+    for (size_t stripe = 0; stripe < header_->num_stripes; stripe++) {
+      RoundUpToEven(&stripes_[stripe]);
+    }
+    RoundUpToEven(&header_->victim_sequence);
+    RoundUpToEven(&header_->write_sequence);
+  }
+
+  static void RoundUpToEven(std::atomic<uint32_t> *sequence) {
+    const uint32_t s = sequence->load(std::memory_order_relaxed);
+    if ((s & 1) != 0) {
+      sequence->store(s + 1, std::memory_order_release);
+    }
+  }
+
+  static inline size_t StripeOf(const size_t i) {
+    return i / kSharedStripeBuckets;
+  }
+
+  // make the write counter odd before an Add or Delete writes anything
+  void BeginWrite() {
+    std::atomic<uint32_t> &sequence = header_->write_sequence;
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  // Make the counter of the stripe of bucket i odd before the first write to
+  // it in this Add or Delete. Only the writer makes counters odd, so an odd
+  // one is already open.
+  void OpenStripe(const size_t i) {
+    std::atomic<uint32_t> &sequence = stripes_[StripeOf(i)];
+    const uint32_t s = sequence.load(std::memory_order_relaxed);
+    if ((s & 1) == 0) {
+      sequence.store(s + 1, std::memory_order_relaxed);
+      // readers see the counter odd before any of the writes that follow
+      std::atomic_thread_fence(std::memory_order_release);
+      open_stripes_.push_back(StripeOf(i));
+    }
+  }
+
+  void OpenVictim() {
+    if (!victim_open_) {
+      std::atomic<uint32_t> &sequence = header_->victim_sequence;
+      sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      victim_open_ = true;
+    }
+  }
+
+  // publish all writes of this Add or Delete
+  void EndWrite() {
+    for (const size_t stripe : open_stripes_) {
+      std::atomic<uint32_t> &sequence = stripes_[stripe];
+      sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+    }
+    open_stripes_.clear();
+    if (victim_open_) {
+      std::atomic<uint32_t> &sequence = header_->victim_sequence;
+      sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+      victim_open_ = false;
+    }
+    std::atomic<uint32_t> &sequence = header_->write_sequence;
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
+
+  bool Probe(const size_t i1, const size_t i2, const uint32_t tag) const {
+    return (header_->victim_used && tag == header_->victim_tag &&
+            (i1 == header_->victim_index || i2 == header_->victim_index)) ||
+           table_.FindTagInBuckets(i1, i2, tag);
+  }
+
+  // ContainHash while the writer is busy: only writes to the stripes of i1
+  // and i2, or to the victim, make the lookup read again
+  bool ProbeStripes(const size_t i1, const size_t i2,
+                    const uint32_t tag) const {
+    const std::atomic<uint32_t> &sequence1 = stripes_[StripeOf(i1)];
+    const std::atomic<uint32_t> &sequence2 = stripes_[StripeOf(i2)];
+    const std::atomic<uint32_t> &victim = header_->victim_sequence;
+    for (;;) {
+      const uint32_t s1 = sequence1.load(std::memory_order_acquire);
+      const uint32_t s2 = sequence2.load(std::memory_order_acquire);
+      const uint32_t v = victim.load(std::memory_order_acquire);
+      if (((s1 | s2 | v) & 1) == 0) {
+        const bool found = Probe(i1, i2, tag);
+        // the reads above happen before the counters are read again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence1.load(std::memory_order_relaxed) == s1 &&
+            sequence2.load(std::memory_order_relaxed) == s2 &&
+            victim.load(std::memory_order_relaxed) == v) {
+          return found;
+        }
+      }
+      // the writer may be waiting for this core
+      std::this_thread::yield();
+    }
+  }
+
+  inline void IndexTagFromHash(const uint64_t hash, size_t *index,
+                               uint32_t *tag) const {
+    IndexTagOfHash<bits_per_item>(hash, table_.NumBuckets(), index, tag);
+  }
+
+  inline size_t AltIndex(const size_t index, const uint32_t tag) const {
+    return (*alt_index_)(index, tag, table_.NumBuckets());
+  }
+
+  // the kick chain of CuckooFilter::AddImpl, opening each stripe it writes
+  void AddImpl(size_t curindex, uint32_t curtag) {
+    size_t kicks = 0;
+    if (RunKickChain(&table_, &curindex, &curtag, &kicks, &random_,
+                     [this](const size_t index, const uint32_t tag) {
+                       return AltIndex(index, tag);
+                     },
+                     [this](const size_t index) { OpenStripe(index); })) {
+      header_->num_items.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    OpenVictim();
+    header_->victim_index = curindex;
+    header_->victim_tag = curtag;
+    header_->victim_used = 1;
+  }
+
+ public:
+  // Create a filter for up to max_num_keys items in the new POSIX shared
+  // memory object name (see shm_open), and attach to it for writing. Throws
+  // std::system_error if name exists or cannot be created.
+  static std::unique_ptr<SharedCuckooFilter> Create(
+      const std::string &name, const size_t max_num_keys) {
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+      ThrowErrno("shm_open " + name);
+    }
+    try {
+      return CreateIn(fd, max_num_keys);
+    } catch (...) {
+      shm_unlink(name.c_str());
+      throw;
+    }
+  }
+
+  // Create in an empty file open for reading and writing, such as one from
+  // memfd_create, which other processes attach to by inheriting or being
+  // sent the descriptor. The filter keeps a duplicate of fd.
+  static std::unique_ptr<SharedCuckooFilter> Create(
+      const int fd, const size_t max_num_keys) {
+    const int own = dup(fd);
+    if (own < 0) {
+      ThrowErrno("dup");
+    }
+    return CreateIn(own, max_num_keys);
+  }
+
+  // Attach to the filter in the shared memory object name, read-only by
+  // default. Throws std::system_error if it cannot be opened, or if another
+  // process holds it writable and writable is set, and std::runtime_error
+  // if it is not a filter of this type.
+  static std::unique_ptr<SharedCuckooFilter> Attach(
+      const std::string &name, const bool writable = false) {
+    const int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0) {
+      ThrowErrno("shm_open " + name);
+    }
+    return AttachTo(fd, writable);
+  }
+
+  // Attach to the filter in fd, as above. The filter keeps a duplicate of
+  // fd; duplicates share their flock, so processes that inherit fd are not
+  // kept from attaching writable at the same time.
+  static std::unique_ptr<SharedCuckooFilter> Attach(
+      const int fd, const bool writable = false) {
+    const int own = dup(fd);
+    if (own < 0) {
+      ThrowErrno("dup");
+    }
+    return AttachTo(own, writable);
+  }
+
+  // Remove the name of a shared memory object; processes attached to it
+  // keep their mapping until they detach.
+  static bool Remove(const std::string &name) {
+    return shm_unlink(name.c_str()) == 0;
+  }
+
+  SharedCuckooFilter(const SharedCuckooFilter &) = delete;
+  SharedCuckooFilter &operator=(const SharedCuckooFilter &) = delete;
+
+  // detaches; the filter stays in shared memory
+  ~SharedCuckooFilter() {
+    munmap(base_, size_);
+    close(fd_);
+  }
+
+  // Add an item to the filter. NotSupported if attached read-only.
+  Status Add(const ItemType &item) { return AddHash((*hasher_)(item)); }
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const {
+    return ContainHash((*hasher_)(item));
+  }
+
+  // Delete an key from the filter. NotSupported if attached read-only.
+  Status Delete(const ItemType &item) { return DeleteHash((*hasher_)(item)); }
+
+  // Add, Contain and Delete of a uniform 64-bit hash, see CuckooFilter
+  Status AddHash(const uint64_t hash) {
+    if (!writable_) {
+      return NotSupported;
+    }
+    if (header_->victim_used) {
+      return NotEnoughSpace;
+    }
+    size_t i;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i, &tag);
+    BeginWrite();
+    AddImpl(i, tag);
+    EndWrite();
+    return Ok;
+  }
+
+  Status ContainHash(const uint64_t hash) const {
+    size_t i1;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = AltIndex(i1, tag);
+    // While nothing is written, one counter in the header covers it all; the
+    // stripe counters cost about as much as the probe itself.
+    const std::atomic<uint32_t> &write = header_->write_sequence;
+    const uint32_t w = write.load(std::memory_order_acquire);
+    if ((w & 1) == 0) {
+      const bool found = Probe(i1, i2, tag);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (write.load(std::memory_order_relaxed) == w) {
+        return found ? Ok : NotFound;
+      }
+    }
+    return ProbeStripes(i1, i2, tag) ? Ok : NotFound;
+  }
+
+  Status DeleteHash(const uint64_t hash) {
+    if (!writable_) {
+      return NotSupported;
+    }
+    size_t i1;
+    uint32_t tag;
+    IndexTagFromHash(hash, &i1, &tag);
+    const size_t i2 = AltIndex(i1, tag);
+    Status result = NotFound;
+    BeginWrite();
+    OpenStripe(i1);
+    bool deleted = table_.DeleteTagFromBucket(i1, tag);
+    if (!deleted) {
+      OpenStripe(i2);
+      deleted = table_.DeleteTagFromBucket(i2, tag);
+    }
+    if (deleted) {
+      header_->num_items.fetch_sub(1, std::memory_order_relaxed);
+      if (header_->victim_used) {
+        // a slot was freed, so try to put the victim back
+        OpenVictim();
+        header_->victim_used = 0;
+        AddImpl(header_->victim_index, header_->victim_tag);
+      }
+      result = Ok;
+    } else if (header_->victim_used && tag == header_->victim_tag &&
+               (i1 == header_->victim_index || i2 == header_->victim_index)) {
+      OpenVictim();
+      header_->victim_used = 0;
+      result = Ok;
+    }
+    EndWrite();
+    return result;
+  }
+
+  /* methods for providing stats  */
+  // number of current inserted items, as of the last Add or Delete
+  size_t Size() const {
+    return header_->num_items.load(std::memory_order_relaxed);
+  }
+
+  // size of the table in bytes
+  size_t SizeInBytes() const { return table_.SizeInBytes(); }
+
+  // size of the whole shared region in bytes
+  size_t SizeInRegion() const { return size_; }
+
+  bool Writable() const { return writable_; }
+
+  // summary infomation
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "SharedCuckooFilter Status:\n"
+       << "\t\t" << table_.Info() << "\n"
+       << "\t\tKeys stored: " << Size() << "\n"
+       << "\t\tShared region: " << size_ << " bytes, "
+       << header_->num_stripes << " stripes\n"
+       << "\t\tAttached " << (writable_ ? "writable" : "read-only") << "\n";
+    return ss.str();
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_SHARED_CUCKOO_FILTER_H_
@@ -58,8 +58,12 @@ class SimdBlockFilter {
       directory_(that.directory_),
       hasher_(that.hasher_) {}
   ~SimdBlockFilter() noexcept;
-  void Add(const uint64_t key) noexcept;
-  bool Find(const uint64_t key) const noexcept;
+  void Add(const uint64_t key) noexcept { AddHash(hasher_(key)); }
+  bool Find(const uint64_t key) const noexcept { return FindHash(hasher_(key)); }
+  // Add and Find for callers that already hold a uniform 64-bit hash of each key, which
+  // is used in place of HashFamily's:
+  void AddHash(const uint64_t hash) noexcept;
+  bool FindHash(const uint64_t hash) const noexcept;
   uint64_t SizeInBytes() const { return sizeof(Bucket) * (1ull << log_num_buckets_); }
 
  private:
@@ -118,8 +122,7 @@ SimdBlockFilter<HashFamily>::MakeMask(const uint32_t hash) noexcept {
 
 template <typename HashFamily>
 [[gnu::always_inline]] inline void
-SimdBlockFilter<HashFamily>::Add(const uint64_t key) noexcept {
-  const auto hash = hasher_(key);
+SimdBlockFilter<HashFamily>::AddHash(const uint64_t hash) noexcept {
   const uint32_t bucket_idx = hash & directory_mask_;
   const __m256i mask = MakeMask(hash >> log_num_buckets_);
   __m256i* const bucket = &reinterpret_cast<__m256i*>(directory_)[bucket_idx];
@@ -128,8 +131,7 @@ SimdBlockFilter<HashFamily>::Add(const uint64_t key) noexcept {
 
 template <typename HashFamily>
 [[gnu::always_inline]] inline bool
-SimdBlockFilter<HashFamily>::Find(const uint64_t key) const noexcept {
-  const auto hash = hasher_(key);
+SimdBlockFilter<HashFamily>::FindHash(const uint64_t hash) const noexcept {
   const uint32_t bucket_idx = hash & directory_mask_;
   const __m256i mask = MakeMask(hash >> log_num_buckets_);
   const __m256i bucket = reinterpret_cast<__m256i*>(directory_)[bucket_idx];
@@ -2,19 +2,28 @@
 #define CUCKOO_FILTER_SINGLE_TABLE_H_
 
 #include <assert.h>
+#include <string.h>
 
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "bitsutil.h"
 #include "debug.h"
+#include "dirtybitmap.h"
+#include "filterarena.h"
 #include "printutil.h"
+#include "randutil.h"
 
 namespace cuckoofilter {
 
 // the most naive table implementation: one huge bit array
 template <size_t bits_per_tag>
 class SingleTable {
+ public:
   static const size_t kTagsPerBucket = 4;
+
+ private:
   static const size_t kBytesPerBucket =
       (bits_per_tag * kTagsPerBucket + 7) >> 3;
   static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
@@ -23,6 +32,20 @@ class SingleTable {
   static const size_t kPaddingBuckets =
     ((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
 
+  // Buckets of four tags of 4, 8, 12 or 16 bits are read as one uint64 and
+  // searched with SWAR operations, one lane per tag; the constants below
+  // are their masks.
+  static const bool kSwarBuckets = kTagsPerBucket == 4 &&
+                                   bits_per_tag % 4 == 0 && bits_per_tag <= 16;
+  static const size_t kBucketBits = bits_per_tag * kTagsPerBucket;
+  static const uint64_t kBucketMask =
+      (kBucketBits >= 64) ? ~0ULL : (1ULL << (kBucketBits % 64)) - 1;
+  // the lowest bit of each lane
+  static const uint64_t kLaneOnes = kBucketMask / kTagMask;
+  // the top bit of each lane, and the bits below it
+  static const uint64_t kLaneHigh = kLaneOnes << (bits_per_tag - 1);
+  static const uint64_t kLaneLow = kBucketMask & ~kLaneHigh;
+
   struct Bucket {
     char bits_[kBytesPerBucket];
   } __attribute__((__packed__));
@@ -30,17 +53,95 @@ class SingleTable {
   // using a pointer adds one more indirection
   Bucket *buckets_;
   size_t num_buckets_;
+  // whether buckets_ was given to the table, by a FilterArena or Adopt,
+  // and is freed by its owner
+  bool adopted_;
+  // regions written since the last TakeDirty, if tracked
+  DirtyBitmap dirty_;
+
+  SingleTable(const size_t num, void *storage)
+      : buckets_(static_cast<Bucket *>(storage)),
+        num_buckets_(num),
+        adopted_(true) {}
+
+  inline void MarkDirty(const size_t i) {
+    dirty_.Mark(i * kBytesPerBucket, (i + 1) * kBytesPerBucket - 1);
+  }
 
  public:
-  explicit SingleTable(const size_t num) : num_buckets_(num) {
-    buckets_ = new Bucket[num_buckets_ + kPaddingBuckets];
-    memset(buckets_, 0, kBytesPerBucket * (num_buckets_ + kPaddingBuckets));
+  explicit SingleTable(const size_t num)
+      : buckets_(new Bucket[num + kPaddingBuckets]),
+        num_buckets_(num),
+        adopted_(false) {
+    Clear();
+  }
+
+  // The buckets are allocated from arena, and freed with it.
+  SingleTable(const size_t num, FilterArena *arena)
+      : SingleTable(num, arena->Allocate(StorageSize(num))) {
+    Clear();
+  }
+
+  // A table of num buckets over storage, StorageSize(num) bytes that the
+  // caller owns, such as shared memory. Tags already there are kept.
+  static SingleTable Adopt(const size_t num, void *storage) {
+    return SingleTable(num, storage);
+  }
+
+  // bytes of storage for a table of num buckets, more than SizeInBytes as
+  // buckets are read as a uint64
+  static size_t StorageSize(const size_t num) {
+    return kBytesPerBucket * (num + kPaddingBuckets);
+  }
+
+  SingleTable(SingleTable &&other) noexcept
+      : buckets_(other.buckets_),
+        num_buckets_(other.num_buckets_),
+        adopted_(other.adopted_),
+        dirty_(std::move(other.dirty_)) {
+    other.buckets_ = nullptr;
+    other.num_buckets_ = 0;
   }
 
-  ~SingleTable() { 
-    delete[] buckets_;
+  SingleTable &operator=(SingleTable &&other) noexcept {
+    std::swap(buckets_, other.buckets_);
+    std::swap(num_buckets_, other.num_buckets_);
+    std::swap(adopted_, other.adopted_);
+    std::swap(dirty_, other.dirty_);
+    return *this;
   }
 
+  SingleTable(const SingleTable &) = delete;
+  SingleTable &operator=(const SingleTable &) = delete;
+
+  ~SingleTable() {
+    if (!adopted_) {
+      delete[] buckets_;
+    }
+  }
+
+  // empty all buckets, keeping the memory
+  void Clear() {
+    memset(buckets_, 0, StorageSize(num_buckets_));
+    dirty_.MarkAll(StorageSize(num_buckets_));
+  }
+
+  // Track the regions of the storage that writes change, starting with all
+  // of them dirty, for incremental checkpoints.
+  void TrackDirty() { dirty_.Enable(StorageSize(num_buckets_)); }
+
+  // Append the regions written since the last call, or since TrackDirty, to
+  // regions, and mark them clean.
+  void TakeDirty(std::vector<size_t> *regions) {
+    dirty_.Take(StorageSize(num_buckets_), regions);
+  }
+
+  // the StorageSize(NumBuckets()) bytes of the table, for checkpoints
+  const char *Storage() const {
+    return reinterpret_cast<const char *>(buckets_);
+  }
+  char *Storage() { return reinterpret_cast<char *>(buckets_); }
+
   size_t NumBuckets() const {
     return num_buckets_;
   }
@@ -91,29 +192,21 @@ class SingleTable {
   inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
     char *p = buckets_[i].bits_;
     uint32_t tag = t & kTagMask;
+    MarkDirty(i);
     /* following code only works for little-endian */
     if (bits_per_tag == 2) {
       *((uint8_t *)p) |= tag << (2 * j);
     } else if (bits_per_tag == 4) {
       p += (j >> 1);
-      if ((j & 1) == 0) {
-        *((uint8_t *)p) &= 0xf0;
-        *((uint8_t *)p) |= tag;
-      } else {
-        *((uint8_t *)p) &= 0x0f;
-        *((uint8_t *)p) |= (tag << 4);
-      }
+      const size_t shift = (j & 1) << 2;
+      *((uint8_t *)p) = (*((uint8_t *)p) & ~(0xf << shift)) | (tag << shift);
     } else if (bits_per_tag == 8) {
       ((uint8_t *)p)[j] = tag;
     } else if (bits_per_tag == 12) {
       p += (j + (j >> 1));
-      if ((j & 1) == 0) {
-        ((uint16_t *)p)[0] &= 0xf000;
-        ((uint16_t *)p)[0] |= tag;
-      } else {
-        ((uint16_t *)p)[0] &= 0x000f;
-        ((uint16_t *)p)[0] |= (tag << 4);
-      }
+      const size_t shift = (j & 1) << 2;
+      ((uint16_t *)p)[0] =
+          (((uint16_t *)p)[0] & ~(0xfff << shift)) | (tag << shift);
     } else if (bits_per_tag == 16) {
       ((uint16_t *)p)[j] = tag;
     } else if (bits_per_tag == 32) {
@@ -121,6 +214,11 @@ class SingleTable {
     }
   }
 
+  // hint that bucket i is about to be read
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(&buckets_[i]);
+  }
+
   inline bool FindTagInBuckets(const size_t i1, const size_t i2,
                                const uint32_t tag) const {
     const char *p1 = buckets_[i1].bits_;
@@ -176,7 +274,51 @@ class SingleTable {
     }
   }
 
+  // Write the tags of bucket i at once, replacing what it held, if
+  // kSwarBuckets: tag j is lane j of bits, as ReadBucket returns them. For
+  // building a table bucket by bucket, where writing tags one by one would
+  // read back each store.
+  inline void WriteBucket(const size_t i, const uint64_t bits) {
+    MarkDirty(i);
+    memcpy(buckets_[i].bits_, &bits, kBytesPerBucket);
+  }
+
+  // the tags of bucket i, if kSwarBuckets
+  inline uint64_t ReadBucket(const size_t i) const {
+    // caution: unaligned access & assuming little endian
+    return *((uint64_t *)buckets_[i].bits_) & kBucketMask;
+  }
+
+  // the top bit of each lane of v that is zero: the top bit of a lane is
+  // set iff the lane is not zero, and the sum carries into it iff some
+  // lower bit is set
+  static inline uint64_t ZeroLanes(const uint64_t v) {
+    return ~(((v & kLaneLow) + kLaneLow) | v) & kLaneHigh;
+  }
+
+  // xor t into the lane of bucket i whose top bit is bit high, if
+  // kSwarBuckets; this writes a tag to an empty slot, or erases it from its
+  // slot, without turning the bit into a slot number
+  inline void XorLane(const size_t i, const size_t high, const uint32_t t) {
+    char *p = buckets_[i].bits_;
+    const size_t bit = high - (bits_per_tag - 1);
+    MarkDirty(i);
+    if (bits_per_tag <= 8) {
+      ((uint8_t *)p)[bit / 8] ^= t << (bit % 8);
+    } else {
+      *((uint16_t *)(p + bit / 8)) ^= t << (bit % 8);
+    }
+  }
+
   inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    if (kSwarBuckets) {
+      const uint64_t match = ZeroLanes(ReadBucket(i) ^ (tag * kLaneOnes));
+      if (match == 0) {
+        return false;
+      }
+      XorLane(i, __builtin_ctzll(match), tag);
+      return true;
+    }
     for (size_t j = 0; j < kTagsPerBucket; j++) {
       if (ReadTag(i, j) == tag) {
         assert(FindTagInBucket(i, tag) == true);
@@ -187,22 +329,51 @@ class SingleTable {
     return false;
   }
 
+  // Put tag into the first free slot of bucket i. If there is none and
+  // kickout is set, tag replaces a slot picked with random, whose tag is
+  // returned in oldtag.
   inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
-                                const bool kickout, uint32_t &oldtag) {
-    for (size_t j = 0; j < kTagsPerBucket; j++) {
-      if (ReadTag(i, j) == 0) {
-        WriteTag(i, j, tag);
+                                const bool kickout, uint32_t &oldtag,
+                                WyRand &random) {
+    if (kSwarBuckets) {
+      const uint64_t empty = ZeroLanes(ReadBucket(i));
+      if (empty != 0) {
+        XorLane(i, __builtin_ctzll(empty), tag & kTagMask);
         return true;
       }
+    } else {
+      for (size_t j = 0; j < kTagsPerBucket; j++) {
+        if (ReadTag(i, j) == 0) {
+          WriteTag(i, j, tag);
+          return true;
+        }
+      }
     }
     if (kickout) {
-      size_t r = rand() % kTagsPerBucket;
+      size_t r = random.Below(kTagsPerBucket);
       oldtag = ReadTag(i, r);
       WriteTag(i, r, tag);
     }
     return false;
   }
 
+  // Add to counts[n] the number of buckets holding n tags, n in [0, 4]. For
+  // tags of up to 16 bits a bucket is one 64-bit word, and its non-empty
+  // slots are found with a few SWAR operations instead of kTagsPerBucket
+  // ReadTag calls.
+  void OccupancyHistogram(uint64_t *counts) const {
+    if (kSwarBuckets) {
+      for (size_t i = 0; i < num_buckets_; i++) {
+        const uint64_t zero = ZeroLanes(ReadBucket(i));
+        counts[kTagsPerBucket - __builtin_popcountll(zero)]++;
+      }
+    } else {
+      for (size_t i = 0; i < num_buckets_; i++) {
+        counts[NumTagsInBucket(i)]++;
+      }
+    }
+  }
+
   inline size_t NumTagsInBucket(const size_t i) const {
     size_t num = 0;
     for (size_t j = 0; j < kTagsPerBucket; j++) {
@@ -0,0 +1,218 @@
+#ifndef CUCKOO_FILTER_SPLIT_TABLE_H_
+#define CUCKOO_FILTER_SPLIT_TABLE_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <utility>
+
+#include "debug.h"
+#include "printutil.h"
+#include "randutil.h"
+
+namespace cuckoofilter {
+
+// A table of 12-bit tags, four per bucket, stored as two planes in arrays
+// of their own: the high 8 bits of each tag in one byte, and the low 4 bits
+// in one nibble, so nothing is padded and no bucket straddles a cache line.
+// A lookup compares the bytes of both its buckets at once, one byte lane per
+// tag, and reads the nibble plane only for the bytes that match: a lookup of
+// a missing item in a full table does so about once in 32.
+template <size_t bits_per_tag>
+class SplitTable {
+  static_assert(bits_per_tag == 12, "SplitTable stores 12-bit tags");
+
+ public:
+  static const size_t kTagsPerBucket = 4;
+
+ private:
+  static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+  static const uint64_t kLowBytes = 0x0101010101010101ULL;
+  static const uint64_t kHighBits = 0x8080808080808080ULL;
+
+  // bytes_[i] holds the high bytes of the tags of bucket i, tag j in byte j
+  uint32_t *bytes_;
+  // nibbles_[i] holds their low nibbles, tag j in bits [4j, 4j + 4)
+  uint16_t *nibbles_;
+  size_t num_buckets_;
+
+  template <typename T>
+  static T *AllocatePlane(const size_t num) {
+    void *p;
+    if (posix_memalign(&p, 64, std::max<size_t>(1, num) * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(p);
+  }
+
+  // the high bit of each byte of v that is zero
+  static inline uint64_t ZeroBytes(const uint64_t v) {
+    return ~(((v & ~kHighBits) + ~kHighBits) | v) & kHighBits;
+  }
+
+  // the nibbles of n, 4j to 4j + 4, in the low halves of bytes j of the result
+  static inline uint32_t Spread(const uint32_t n) {
+#ifdef __BMI2__
+    return _pdep_u32(n, 0x0f0f0f0fU);
+#else
+    return (n & 0xf) | ((n & 0xf0) << 4) | ((n & 0xf00) << 8) |
+           ((n & 0xf000) << 12);
+#endif
+  }
+
+ public:
+  explicit SplitTable(const size_t num)
+      : bytes_(AllocatePlane<uint32_t>(num)),
+        nibbles_(AllocatePlane<uint16_t>(num)),
+        num_buckets_(num) {
+    Clear();
+  }
+
+  SplitTable(SplitTable &&other) noexcept
+      : bytes_(other.bytes_),
+        nibbles_(other.nibbles_),
+        num_buckets_(other.num_buckets_) {
+    other.bytes_ = nullptr;
+    other.nibbles_ = nullptr;
+    other.num_buckets_ = 0;
+  }
+
+  SplitTable &operator=(SplitTable &&other) noexcept {
+    std::swap(bytes_, other.bytes_);
+    std::swap(nibbles_, other.nibbles_);
+    std::swap(num_buckets_, other.num_buckets_);
+    return *this;
+  }
+
+  SplitTable(const SplitTable &) = delete;
+  SplitTable &operator=(const SplitTable &) = delete;
+
+  ~SplitTable() {
+    free(bytes_);
+    free(nibbles_);
+  }
+
+  // empty all buckets, keeping the memory
+  void Clear() {
+    memset(bytes_, 0, num_buckets_ * sizeof(uint32_t));
+    memset(nibbles_, 0, num_buckets_ * sizeof(uint16_t));
+  }
+
+  size_t NumBuckets() const { return num_buckets_; }
+
+  size_t SizeInBytes() const {
+    return (bits_per_tag * kTagsPerBucket / 8) * num_buckets_;
+  }
+
+  size_t SizeInTags() const { return kTagsPerBucket * num_buckets_; }
+
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "SplitHashtable with tag size: " << bits_per_tag << " bits \n";
+    ss << "\t\tAssociativity: " << kTagsPerBucket << "\n";
+    ss << "\t\tTotal # of rows: " << num_buckets_ << "\n";
+    ss << "\t\tTotal # slots: " << SizeInTags() << "\n";
+    return ss.str();
+  }
+
+  // read tag from pos(i,j)
+  inline uint32_t ReadTag(const size_t i, const size_t j) const {
+    return (((bytes_[i] >> (8 * j)) & 0xff) << 4) |
+           ((nibbles_[i] >> (4 * j)) & 0xf);
+  }
+
+  // write tag to pos(i,j)
+  inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
+    const uint32_t tag = t & kTagMask;
+    uint32_t &bytes = bytes_[i];
+    uint16_t &nibbles = nibbles_[i];
+    bytes = (bytes & ~(0xffU << (8 * j))) | ((tag >> 4) << (8 * j));
+    nibbles = (nibbles & ~(0xfU << (4 * j))) | ((tag & 0xf) << (4 * j));
+  }
+
+  // hint that bucket i is about to be read; both planes are fetched, as a
+  // lookup that finds its tag reads the nibbles too
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(&bytes_[i]);
+    __builtin_prefetch(&nibbles_[i]);
+  }
+
+  inline bool FindTagInBuckets(const size_t i1, const size_t i2,
+                               const uint32_t tag) const {
+    // the tags of bucket i1 in the low four byte lanes, those of i2 in the
+    // high ones
+    const uint64_t bytes =
+        bytes_[i1] | (static_cast<uint64_t>(bytes_[i2]) << 32);
+    const uint64_t v = bytes ^ ((tag >> 4) * kLowBytes);
+    if (ZeroBytes(v) == 0) {
+      return false;
+    }
+    const uint64_t nibbles =
+        Spread(nibbles_[i1]) | (static_cast<uint64_t>(Spread(nibbles_[i2])) << 32);
+    return ZeroBytes(v | (nibbles ^ ((tag & 0xf) * kLowBytes))) != 0;
+  }
+
+  // the high bit of byte j of the result is set iff tag j of bucket i is tag
+  inline uint32_t MatchingSlots(const size_t i, const uint32_t tag) const {
+    const uint32_t v = (bytes_[i] ^ ((tag >> 4) * 0x01010101U)) |
+                       (Spread(nibbles_[i]) ^ ((tag & 0xf) * 0x01010101U));
+    return ZeroBytes(v) & 0x80808080U;
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
+    return MatchingSlots(i, tag) != 0;
+  }
+
+  inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    const uint32_t match = MatchingSlots(i, tag);
+    if (match == 0) {
+      return false;
+    }
+    WriteTag(i, __builtin_ctz(match) / 8, 0);
+    return true;
+  }
+
+  inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
+                                const bool kickout, uint32_t &oldtag,
+                                WyRand &random) {
+    const uint32_t empty = ~NonEmptySlots(i) & 0x80808080U;
+    if (empty != 0) {
+      WriteTag(i, __builtin_ctz(empty) / 8, tag);
+      return true;
+    }
+    if (kickout) {
+      size_t r = random.Below(kTagsPerBucket);
+      oldtag = ReadTag(i, r);
+      WriteTag(i, r, tag);
+    }
+    return false;
+  }
+
+  // the high bit of byte j of the result is set iff tag j of bucket i is
+  // not zero
+  inline uint32_t NonEmptySlots(const size_t i) const {
+    return ~static_cast<uint32_t>(ZeroBytes(bytes_[i] | Spread(nibbles_[i]))) &
+           0x80808080U;
+  }
+
+  // Add to counts[n] the number of buckets holding n tags, n in [0, 4].
+  void OccupancyHistogram(uint64_t *counts) const {
+    for (size_t i = 0; i < num_buckets_; i++) {
+      counts[__builtin_popcount(NonEmptySlots(i))]++;
+    }
+  }
+
+  inline size_t NumTagsInBucket(const size_t i) const {
+    return __builtin_popcount(NonEmptySlots(i));
+  }
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_SPLIT_TABLE_H_
@@ -0,0 +1,265 @@
+#ifndef CUCKOO_FILTER_VALUE_TABLE_H_
+#define CUCKOO_FILTER_VALUE_TABLE_H_
+
+#include <assert.h>
+#include <string.h>
+
+#include <sstream>
+#include <utility>
+
+#include "debug.h"
+#include "printutil.h"
+#include "randutil.h"
+
+namespace cuckoofilter {
+
+// A table like SingleTable where each slot also carries a small value next to
+// its tag. A slot is (bits_per_tag + bits_per_value) bits wide, with the tag
+// in the low bits and the value in the high bits, and four slots are packed
+// back to back in each bucket.
+//
+// As a TableType of CuckooFilter (see ValueTableOf), the tags the filter
+// moves around are whole slots, TagWithValue(tag, value), so that values
+// travel with their tags during kicks, while lookups and deletes match the
+// tag bits only.
+template <size_t bits_per_tag, size_t bits_per_value>
+class ValueTable {
+  static_assert(bits_per_tag >= 2 && bits_per_tag <= 32,
+                "bits_per_tag must be in [2, 32]");
+  static_assert(bits_per_value >= 1 && bits_per_value <= 8,
+                "bits_per_value must be in [1, 8]");
+
+ public:
+  static const size_t kTagsPerBucket = 4;
+
+ private:
+  static const size_t kBitsPerSlot = bits_per_tag + bits_per_value;
+  static const size_t kBytesPerBucket =
+      (kBitsPerSlot * kTagsPerBucket + 7) >> 3;
+  static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
+  static const uint32_t kValueMask = (1ULL << bits_per_value) - 1;
+  static const uint64_t kSlotMask = (1ULL << kBitsPerSlot) - 1;
+
+  // using a pointer adds one more indirection
+  char *buckets_;
+  size_t num_buckets_;
+
+  // NOTE: a slot is read as a uint64 starting at the byte holding its first
+  // bit, so the last bucket needs 7 bytes of padding to avoid overrun
+  inline uint64_t ReadSlot(const size_t i, const size_t j) const {
+    const size_t bit = kBitsPerSlot * j;
+    const char *p = buckets_ + kBytesPerBucket * i + (bit >> 3);
+    /* following code only works for little-endian */
+    return (*((uint64_t *)p) >> (bit & 7)) & kSlotMask;
+  }
+
+  inline void WriteSlot(const size_t i, const size_t j, const uint64_t slot) {
+    const size_t bit = kBitsPerSlot * j;
+    char *p = buckets_ + kBytesPerBucket * i + (bit >> 3);
+    uint64_t v = *((uint64_t *)p);
+    v &= ~(kSlotMask << (bit & 7));
+    v |= (slot & kSlotMask) << (bit & 7);
+    *((uint64_t *)p) = v;
+  }
+
+ public:
+  explicit ValueTable(const size_t num) : num_buckets_(num) {
+    buckets_ = new char[kBytesPerBucket * num_buckets_ + 7];
+    memset(buckets_, 0, kBytesPerBucket * num_buckets_ + 7);
+  }
+
+  ValueTable(ValueTable &&other) noexcept
+      : buckets_(other.buckets_), num_buckets_(other.num_buckets_) {
+    other.buckets_ = nullptr;
+    other.num_buckets_ = 0;
+  }
+
+  ValueTable &operator=(ValueTable &&other) noexcept {
+    std::swap(buckets_, other.buckets_);
+    std::swap(num_buckets_, other.num_buckets_);
+    return *this;
+  }
+
+  ValueTable(const ValueTable &) = delete;
+  ValueTable &operator=(const ValueTable &) = delete;
+
+  ~ValueTable() {
+    delete[] buckets_;
+  }
+
+  // empty all buckets, keeping the memory
+  void Clear() { memset(buckets_, 0, kBytesPerBucket * num_buckets_ + 7); }
+
+  size_t NumBuckets() const {
+    return num_buckets_;
+  }
+
+  size_t SizeInBytes() const {
+    return kBytesPerBucket * num_buckets_;
+  }
+
+  size_t SizeInTags() const {
+    return kTagsPerBucket * num_buckets_;
+  }
+
+  std::string Info() const {
+    std::stringstream ss;
+    ss << "ValueHashtable with tag size: " << bits_per_tag << " bits, "
+       << "value size: " << bits_per_value << " bits\n";
+    ss << "\t\tAssociativity: " << kTagsPerBucket << "\n";
+    ss << "\t\tTotal # of rows: " << num_buckets_ << "\n";
+    ss << "\t\tTotal # slots: " << SizeInTags() << "\n";
+    return ss.str();
+  }
+
+  // read tag from pos(i,j)
+  inline uint32_t ReadTag(const size_t i, const size_t j) const {
+    return ReadSlot(i, j) & kTagMask;
+  }
+
+  // read value from pos(i,j)
+  inline uint32_t ReadValue(const size_t i, const size_t j) const {
+    return (ReadSlot(i, j) >> bits_per_tag) & kValueMask;
+  }
+
+  // write tag and value to pos(i,j)
+  inline void WriteTag(const size_t i, const size_t j, const uint32_t tag,
+                       const uint32_t value) {
+    WriteSlot(i, j, (tag & kTagMask) |
+                        ((uint64_t)(value & kValueMask) << bits_per_tag));
+  }
+
+  // the slot CuckooFilter carries for tag and value
+  static inline uint32_t TagWithValue(const uint32_t tag,
+                                      const uint32_t value) {
+    static_assert(kBitsPerSlot <= 32, "a slot must fit in a uint32_t");
+    return (tag & kTagMask) | ((value & kValueMask) << bits_per_tag);
+  }
+
+  // hint that bucket i is about to be read
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_ + kBytesPerBucket * i);
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) == tag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline bool FindTagInBuckets(const size_t i1, const size_t i2,
+                               const uint32_t tag) const {
+    return FindTagInBucket(i1, tag) || FindTagInBucket(i2, tag);
+  }
+
+  inline bool FindTagInBucket(const size_t i, const uint32_t tag,
+                              uint32_t *value) const {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      const uint64_t slot = ReadSlot(i, j);
+      if ((slot & kTagMask) == tag) {
+        *value = (slot >> bits_per_tag) & kValueMask;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Same probe as SingleTable::FindTagInBuckets, but also returns the value
+  // stored with the first matching tag.
+  inline bool FindTagInBuckets(const size_t i1, const size_t i2,
+                               const uint32_t tag, uint32_t *value) const {
+    return FindTagInBucket(i1, tag, value) || FindTagInBucket(i2, tag, value);
+  }
+
+  inline bool UpdateTagInBucket(const size_t i, const uint32_t tag,
+                                const uint32_t value) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) == tag) {
+        WriteTag(i, j, tag, value);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) == tag) {
+        WriteSlot(i, j, 0);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Like SingleTable::InsertTagToBucket; a kicked-out tag hands its value
+  // back in oldvalue so that it can travel with the tag.
+  inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
+                                const uint32_t value, const bool kickout,
+                                uint32_t &oldtag, uint32_t &oldvalue,
+                                WyRand &random) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) == 0) {
+        WriteTag(i, j, tag, value);
+        return true;
+      }
+    }
+    if (kickout) {
+      size_t r = random.Below(kTagsPerBucket);
+      oldtag = ReadTag(i, r);
+      oldvalue = ReadValue(i, r);
+      WriteTag(i, r, tag, value);
+    }
+    return false;
+  }
+
+  // InsertTagToBucket of CuckooFilter, for tag and oldtag made by
+  // TagWithValue
+  inline bool InsertTagToBucket(const size_t i, const uint32_t tag,
+                                const bool kickout, uint32_t &oldtag,
+                                WyRand &random) {
+    static_assert(kBitsPerSlot <= 32, "a slot must fit in a uint32_t");
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) == 0) {
+        WriteSlot(i, j, tag);
+        return true;
+      }
+    }
+    if (kickout) {
+      size_t r = random.Below(kTagsPerBucket);
+      oldtag = ReadSlot(i, r);
+      WriteSlot(i, r, tag);
+    }
+    return false;
+  }
+
+  // add to counts[n] the number of buckets holding n tags, n in [0, 4]
+  void OccupancyHistogram(uint64_t *counts) const {
+    for (size_t i = 0; i < num_buckets_; i++) {
+      counts[NumTagsInBucket(i)]++;
+    }
+  }
+
+  inline size_t NumTagsInBucket(const size_t i) const {
+    size_t num = 0;
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (ReadTag(i, j) != 0) {
+        num++;
+      }
+    }
+    return num;
+  }
+};
+
+// ValueTable with bits_per_value bits of value per slot as a TableType of
+// CuckooFilter, e.g. CuckooFilter<uint64_t, 12, ValueTableOf<4>::Table>
+template <size_t bits_per_value>
+struct ValueTableOf {
+  template <size_t bits_per_tag>
+  using Table = ValueTable<bits_per_tag, bits_per_value>;
+};
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_VALUE_TABLE_H_